@@ -0,0 +1,146 @@
+//
+// Micro-benchmark of the kernels behind Widen::PlainBytes, which copy the
+// plain runs of a source file into the input buffer. Each kernel widens
+// the files named on the command line (or a synthetic Java-like text, if
+// none are) the way LexStream::ProcessInput does: a run at a time, with a
+// byte that ends a run copied as it is. The buffers every kernel produces
+// are compared with the scalar one; the exit status is 1 if they differ.
+//
+//     cmake --build build --target bench-widen
+//     build/bench-widen [-n repetitions] [file.java ...]
+//
+
+#include "widen.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace Jopa;
+
+
+typedef size_t (*Kernel)(const char*, size_t, SourceChar*);
+
+
+static void Run(Kernel kernel, const std::string& text, SourceChar* target)
+{
+    const char* source = text.data();
+    size_t length = text.size();
+    size_t i = 0;
+    while (i < length)
+    {
+        i += kernel(source + i, length - i, target + i);
+        if (i < length)
+        {
+            target[i] = (u1) source[i];
+            i++;
+        }
+    }
+}
+
+
+static std::string SyntheticText()
+{
+    static const char* const lines[] = {
+        "    /**\n",
+        "     * Returns the number of elements in this list.\n",
+        "     */\n",
+        "    public int size() {\n",
+        "        return this.size;\n",
+        "    }\n",
+        "\n",
+        "    String escape(char c) { return c == '\\\\' ? \"\\\\\\\\\" : \"\"; }\r\n",
+        "    private static final long serialVersionUID = 8683452581122892189L;\n",
+        "        for (int i = 0; i < elementData.length; i++)\n",
+        "            if (o.equals(elementData[i])) // \\u00e9t\\u00e9\n",
+    };
+    std::string text;
+    while (text.size() < (4 << 20))
+        for (unsigned k = 0; k < sizeof(lines) / sizeof(lines[0]); k++)
+            text += lines[k];
+    return text;
+}
+
+
+static bool ReadFile(const char* name, std::string& text)
+{
+    FILE* file = fopen(name, "rb");
+    if (! file)
+        return false;
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, n);
+    fclose(file);
+    return true;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int repetitions = 20;
+    std::string text;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            repetitions = atoi(argv[++i]);
+        else if (! ReadFile(argv[i], text))
+        {
+            fprintf(stderr, "bench-widen: cannot read %s\n", argv[i]);
+            return 2;
+        }
+    }
+    if (text.empty())
+        text = SyntheticText();
+
+    struct
+    {
+        const char* name;
+        Kernel kernel;
+    } kernels[] = {
+        { "scalar", Widen::PlainBytesScalar },
+#ifdef JOPA_WIDEN_SIMD
+        { "sse2", Widen::PlainBytesSse2 },
+        { "avx2", Widen::HaveAvx2() ? Widen::PlainBytesAvx2 : NULL },
+#endif
+    };
+
+    size_t length = text.size();
+    std::vector<SourceChar> expected(length), target(length);
+    Run(Widen::PlainBytesScalar, text, expected.data());
+
+    printf("%lu bytes, %d repetitions\n", (unsigned long) length,
+           repetitions);
+    int status = 0;
+    for (unsigned k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        if (! kernels[k].kernel)
+        {
+            printf("%-8s not supported by this host\n", kernels[k].name);
+            continue;
+        }
+
+        double best = 0;
+        for (int r = 0; r < repetitions; r++)
+        {
+            memset(target.data(), 0, length * sizeof(SourceChar));
+            auto start = std::chrono::steady_clock::now();
+            Run(kernels[k].kernel, text, target.data());
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            if (r == 0 || elapsed.count() < best)
+                best = elapsed.count();
+        }
+
+        bool same = memcmp(target.data(), expected.data(),
+                           length * sizeof(SourceChar)) == 0;
+        printf("%-8s %8.1f MB/s%s\n", kernels[k].name,
+               length / best / 1e6, same ? "" : "  MISMATCH");
+        if (! same)
+            status = 1;
+    }
+    return status;
+}
@@ -19,7 +19,7 @@
           cmake
           gnumake
           pkg-config
-          libzip
+          zlib
           cpptrace
         ];
 
@@ -59,7 +59,7 @@
           ];
 
           buildInputs = with pkgs; [
-            libzip
+            zlib
             cpptrace
           ];
 
@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+"""Macro-benchmark of jopa over the vendored bootstrap corpora.
+
+Each corpus is unpacked from vendor/ (once, into the work directory) and
+compiled from scratch with fixed flags, N times. For every run we record the
+wall time, the user time and the peak RSS of the compiler process, and the
+number of class files it wrote; the medians (the maximum, for RSS) and the
+source lines compiled per second go into a JSON results file.
+
+With --baseline, the results are compared against a stored results file and
+the exit status is 1 if any corpus got slower or bigger by more than
+--threshold percent. Nothing is downloaded: a corpus whose archive is not in
+vendor/ is skipped.
+
+GNU Classpath is compiled against itself; the other corpora need a class
+library, which is the Classpath just compiled by the benchmark, or
+--bootclasspath (for example the glibj.zip of a DevJopaK build).
+"""
+import os
+import sys
+import re
+import json
+import shutil
+import argparse
+import platform
+import statistics
+import subprocess
+import tarfile
+import time
+import zipfile
+
+# Imports of libraries we do not vendor; sources using them are left out.
+FOREIGN_IMPORTS = re.compile(
+    rb"^import\s+(?:static\s+)?"
+    rb"(?:org\.apache\.(?:bcel|oro|log4j|commons|regexp|xalan|bsf|xml\.resolver|env)"
+    rb"|com\.|junit\.|netrexx|antlr|sun\.|jdepend"
+    rb"|javax\.(?:mail|media|activation)|org\.(?:jdom|mozilla|python)|ise\.)",
+    re.M)
+
+
+class Corpus:
+    def __init__(self, name, archive, top, roots, flags, excludes=(),
+                 self_hosted=False, filter_imports=False):
+        self.name = name
+        self.archive = archive          # file name in vendor/
+        self.top = top                  # directory the archive unpacks to
+        self.roots = roots              # source roots, relative to top
+        self.flags = flags
+        self.excludes = excludes        # path prefixes, relative to top
+        self.self_hosted = self_hosted  # compiled against its own sources
+        self.filter_imports = filter_imports
+
+
+# The flags and file sets follow the DevJopaK bootstrap build.
+CORPORA = [
+    Corpus("classpath-0.99", "classpath-0.99.tar.gz", "classpath-0.99",
+           ["java", "javax", "gnu", "org", "sun", "vm/reference",
+            "external/sax", "external/w3c_dom", "external/relaxngDatatype",
+            "external/jsr166"],
+           ["-source", "1.5", "-target", "1.5"],
+           excludes=("gnu/java/awt/peer/gtk", "gnu/java/awt/peer/qt",
+                     "gnu/java/awt/peer/x", "gnu/java/awt/dnd/peer/gtk",
+                     "gnu/java/util/prefs/gconf", "gnu/xml/libxmlj",
+                     "gnu/javax/sound/sampled/gstreamer"),
+           self_hosted=True),
+    Corpus("ecj-4.2.1", "ecjsrc-4.2.1.jar", "ecj-4.2.1", ["org"],
+           ["-source", "1.6", "-target", "1.6"],
+           excludes=("org/eclipse/jdt/internal/antadapter",
+                     "org/eclipse/jdt/core/JDTCompilerAdapter.java",
+                     "org/eclipse/jdt/internal/compiler/tool",
+                     "org/eclipse/jdt/internal/compiler/apt")),
+    Corpus("apache-ant-1.8.4", "apache-ant-1.8.4-src.tar.gz",
+           "apache-ant-1.8.4", ["src/main"],
+           ["-source", "1.5", "-target", "1.5"],
+           filter_imports=True),
+    Corpus("junit-3.8.2", "junit-3.8.2-sources.jar", "junit-3.8.2",
+           ["junit"],
+           ["-source", "1.6", "-target", "1.6"]),
+]
+
+COMMON_FLAGS = ["-nowarn"]
+
+# Compared against the baseline; higher is worse for all of them.
+METRICS = ["wall_s", "user_s", "peak_rss_kb"]
+
+
+def unpack(corpus, vendor_dir, work_dir):
+    """Unpack the corpus once; return its directory, or None if not vendored."""
+    archive = os.path.join(vendor_dir, corpus.archive)
+    if not os.path.exists(archive):
+        return None
+    top = os.path.join(work_dir, "src", corpus.top)
+    stamp = os.path.join(top, ".bench-unpacked")
+    if os.path.exists(stamp) and \
+            os.path.getmtime(stamp) >= os.path.getmtime(archive):
+        return top
+
+    print(f"Unpacking {corpus.archive}...")
+    shutil.rmtree(top, ignore_errors=True)
+    if archive.endswith(".jar"):
+        # Source jars have no top directory of their own.
+        os.makedirs(top)
+        with zipfile.ZipFile(archive) as jar:
+            jar.extractall(top)
+    else:
+        with tarfile.open(archive) as tar:
+            tar.extractall(os.path.join(work_dir, "src"))
+    if corpus.self_hosted:
+        configure_classpath(top)
+    with open(stamp, "w"):
+        pass
+    return top
+
+
+def configure_classpath(top):
+    """Generate the sources that Classpath's configure and make would."""
+    config_in = os.path.join(top, "gnu/classpath/Configuration.java.in")
+    if os.path.exists(config_in):
+        with open(config_in) as f:
+            text = f.read()
+        text = text.replace("@VERSION@", "0.99")
+        text = re.sub(r'"@\w+@"', '""', text)
+        text = re.sub(r"@\w+@", "false", text)
+        with open(config_in[:-3], "w") as f:
+            f.write(text)
+    locale_data = os.path.join(top, "gnu/java/locale/LocaleData.java")
+    script = os.path.join(top, "scripts/generate-locale-list.sh")
+    if not os.path.exists(locale_data) and os.path.exists(script):
+        with open(locale_data, "w") as f:
+            subprocess.run(["sh", script], cwd=os.path.join(top, "lib"),
+                           stdout=f, check=True)
+
+
+def collect_sources(corpus, top):
+    """Return the sorted source files of the corpus and their line count."""
+    excludes = tuple(os.path.join(top, e) for e in corpus.excludes)
+    sources = []
+    lines = 0
+    for root in corpus.roots:
+        for dirpath, dirnames, filenames in os.walk(os.path.join(top, root)):
+            dirnames.sort()
+            for name in sorted(filenames):
+                if not name.endswith(".java"):
+                    continue
+                path = os.path.join(dirpath, name)
+                if path.startswith(excludes):
+                    continue
+                with open(path, "rb") as f:
+                    data = f.read()
+                if corpus.filter_imports and FOREIGN_IMPORTS.search(data):
+                    continue
+                sources.append(path)
+                lines += data.count(b"\n")
+    return sources, lines
+
+
+def run_once(command, out_dir):
+    """Compile into an empty out_dir; return the measurements of the run."""
+    shutil.rmtree(out_dir, ignore_errors=True)
+    os.makedirs(out_dir)
+    start = time.monotonic()
+    process = subprocess.Popen(command, stdout=subprocess.DEVNULL,
+                               stderr=subprocess.PIPE)
+    # Read stderr before waiting, so that a chatty compiler cannot block.
+    errors = process.stderr.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    wall = time.monotonic() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    class_files = sum(1 for _, _, files in os.walk(out_dir)
+                      for name in files if name.endswith(".class"))
+    return {
+        "exit_code": process.returncode,
+        "wall_s": round(wall, 4),
+        "user_s": round(usage.ru_utime, 4),
+        "peak_rss_kb": usage.ru_maxrss,  # kilobytes on Linux
+        "class_files": class_files,
+    }, errors
+
+
+def bench_corpus(corpus, top, args, bootclasspath):
+    sources, lines = collect_sources(corpus, top)
+    corpus_dir = os.path.join(args.work_dir, "out", corpus.name)
+    os.makedirs(corpus_dir, exist_ok=True)
+    source_list = os.path.join(corpus_dir, "sources.list")
+    with open(source_list, "w") as f:
+        f.write("\n".join(sources) + "\n")
+    out_dir = os.path.join(corpus_dir, "classes")
+
+    command = [args.jopa] + COMMON_FLAGS + corpus.flags
+    if corpus.self_hosted:
+        command += ["-bootclasspath", "",
+                    "-classpath", os.pathsep.join(
+                        os.path.join(top, r) for r in corpus.roots)]
+    else:
+        command += ["-bootclasspath", bootclasspath]
+    command += ["-d", out_dir, "@" + source_list]
+
+    print(f"{corpus.name}: {len(sources)} files, {lines} lines, "
+          f"{args.repetitions} runs")
+    runs = []
+    for i in range(args.repetitions):
+        run, errors = run_once(command, out_dir)
+        runs.append(run)
+        print(f"  run {i + 1}: {run['wall_s']:.2f}s wall, "
+              f"{run['user_s']:.2f}s user, {run['peak_rss_kb']} KB, "
+              f"{run['class_files']} class files")
+        if run["exit_code"] != 0:
+            sys.stdout.write(errors.decode(errors="replace")[-4000:])
+            print(f"  {corpus.name} failed to compile "
+                  f"(exit code {run['exit_code']})")
+            break
+
+    wall = statistics.median(r["wall_s"] for r in runs)
+    return {
+        "files": len(sources),
+        "lines": lines,
+        "flags": command[1:-3],
+        "runs": runs,
+        "ok": all(r["exit_code"] == 0 for r in runs),
+        "wall_s": wall,
+        "user_s": statistics.median(r["user_s"] for r in runs),
+        "peak_rss_kb": max(r["peak_rss_kb"] for r in runs),
+        "class_files": runs[-1]["class_files"],
+        "lines_per_s": round(lines / wall) if wall else 0,
+    }, out_dir
+
+
+def compare(results, baseline, threshold):
+    """Print the changes against the baseline; return the regressions."""
+    regressions = []
+    print(f"\nAgainst the baseline (threshold {threshold:g}%):")
+    for name, result in results["corpora"].items():
+        base = baseline.get("corpora", {}).get(name)
+        if not base or not result["ok"] or not base.get("ok"):
+            continue
+        changes = []
+        for metric in METRICS:
+            old, new = base[metric], result[metric]
+            if not old:
+                continue
+            change = 100.0 * (new - old) / old
+            changes.append(f"{metric} {change:+.1f}%")
+            if change > threshold:
+                regressions.append(f"{name}: {metric} {old} -> {new} "
+                                   f"({change:+.1f}%)")
+        if base["class_files"] != result["class_files"]:
+            changes.append(f"class files {base['class_files']} -> "
+                           f"{result['class_files']}")
+        print(f"  {name}: " + ", ".join(changes))
+    return regressions
+
+
+def main():
+    root_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    parser = argparse.ArgumentParser(description="jopa macro-benchmark")
+    parser.add_argument('--jopa', required=True, help="Path to jopa")
+    parser.add_argument('--vendor-dir', default=os.path.join(root_dir, "vendor"),
+                        help="Directory of the corpus archives")
+    parser.add_argument('--work-dir', default="bench",
+                        help="Directory to unpack and compile into")
+    parser.add_argument('--repetitions', type=int, default=3,
+                        help="Runs per corpus (default 3)")
+    parser.add_argument('--corpus', action='append',
+                        help="Only run this corpus (can be used multiple times)")
+    parser.add_argument('--bootclasspath',
+                        help="Class library for the corpora other than "
+                             "Classpath (default: the one compiled here)")
+    parser.add_argument('--output', help="Results file (default WORK_DIR/results.json)")
+    parser.add_argument('--baseline', help="Results file to compare against")
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help="Regression threshold in percent (default 10)")
+    parser.add_argument('--save-baseline', action='store_true',
+                        help="Also write the results to --baseline")
+    args = parser.parse_args()
+
+    if args.repetitions < 1:
+        parser.error("--repetitions must be at least 1")
+    args.jopa = os.path.abspath(args.jopa)
+    args.work_dir = os.path.abspath(args.work_dir)
+    output = args.output or os.path.join(args.work_dir, "results.json")
+
+    results = {
+        "jopa": args.jopa,
+        "machine": platform.machine(),
+        "cpus": os.cpu_count(),
+        "repetitions": args.repetitions,
+        "corpora": {},
+    }
+    bootclasspath = args.bootclasspath
+    failed = False
+    for corpus in CORPORA:
+        if args.corpus and corpus.name not in args.corpus:
+            continue
+        top = unpack(corpus, args.vendor_dir, args.work_dir)
+        if top is None:
+            print(f"{corpus.name}: skipped, {corpus.archive} is not in "
+                  f"{args.vendor_dir}")
+            continue
+        if not corpus.self_hosted and not bootclasspath:
+            print(f"{corpus.name}: skipped, no class library "
+                  f"(use --bootclasspath)")
+            continue
+        result, out_dir = bench_corpus(corpus, top, args, bootclasspath)
+        results["corpora"][corpus.name] = result
+        if not result["ok"]:
+            failed = True
+        elif corpus.self_hosted and not bootclasspath:
+            bootclasspath = out_dir
+        print(f"  {result['lines_per_s']} lines/s")
+
+    os.makedirs(os.path.dirname(output), exist_ok=True)
+    with open(output, "w") as f:
+        json.dump(results, f, indent=2)
+        f.write("\n")
+    print(f"\nResults written to {output}")
+
+    regressions = []
+    if args.baseline and args.save_baseline:
+        shutil.copyfile(output, args.baseline)
+        print(f"Baseline written to {args.baseline}")
+    elif args.baseline and os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+        regressions = compare(results, baseline, args.threshold)
+        for regression in regressions:
+            print(f"REGRESSION {regression}")
+    elif args.baseline:
+        print(f"No baseline at {args.baseline}; "
+              f"build the bench-baseline target to make one")
+
+    if not results["corpora"]:
+        print("Error: no corpus was benchmarked")
+        sys.exit(1)
+    sys.exit(1 if failed or regressions else 0)
+
+
+if __name__ == "__main__":
+    main()
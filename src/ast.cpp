@@ -26,6 +26,7 @@ StoragePool::~StoragePool()
         for (unsigned i = 0; i <= base_index; i++)
             delete [] base[i];
     delete [] base;
+    MemoryAccount::Free(MemoryAccount::AST, allocated, file_symbol);
 }
 
 
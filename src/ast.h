@@ -2,6 +2,7 @@
 
 #include "platform.h"
 #include "depend.h"
+#include "memacct.h"
 #include <vector>
 
 
@@ -4456,6 +4457,9 @@ private:
     unsigned log_blksize; // log2(words per segment)
     unsigned base_increment; // number of segment slots to add when growing
 
+    FileSymbol* file_symbol; // whose AST this is, for MemoryAccount
+    size_t allocated; // bytes in base and the segments
+
     // BlockSymbol objects that need to be deleted when this pool is destroyed.
     // These are stored in AST nodes but AST destructors are never called.
     std::vector<BlockSymbol*> block_symbols_to_delete;
@@ -4463,6 +4467,17 @@ private:
     // ParameterizedType objects that need to be deleted when this pool is destroyed.
     std::vector<ParameterizedType*> parameterized_types_to_delete;
 
+    //
+    // Note bytes more (or less) in the pool.
+    //
+    void Account(long bytes)
+    {
+        allocated += bytes;
+        if (bytes < 0)
+            MemoryAccount::Free(MemoryAccount::AST, - bytes, file_symbol);
+        else MemoryAccount::Allocate(MemoryAccount::AST, bytes, file_symbol);
+    }
+
     //
     // Allocate another block of storage for the storage pool. block_size
     // allows the creation of larger than normal segments, which are rare,
@@ -4486,6 +4501,7 @@ private:
             Cell** old_base = base;
             base_size += base_increment;
             base = new Cell*[base_size];
+            Account(base_increment * sizeof(Cell*));
             if (old_base)
             {
                 memcpy(base, old_base, old_base_size * sizeof(Cell*));
@@ -4496,13 +4512,19 @@ private:
         if (block_size)
         {
             assert(block_size > Blksize());
-            delete [] base[base_index];
+            if (base[base_index])
+            {
+                delete [] base[base_index];
+                Account(- (long) (Blksize() * sizeof(Cell)));
+            }
             base[base_index] = new Cell[block_size];
+            Account(block_size * sizeof(Cell));
         }
         else if (! base[base_index])
         {
             block_size = Blksize();
             base[base_index] = new Cell[block_size];
+            Account(block_size * sizeof(Cell));
         }
         memset(base[base_index], 0, block_size * sizeof(Cell));
     }
@@ -4510,13 +4532,15 @@ private:
 public:
     //
     // Constructor of a storage pool. The parameter is the number of tokens
-    // which the AST tree will contain.
+    // which the AST tree will contain, and the file it is parsed from.
     //
-    StoragePool(unsigned num_tokens)
+    StoragePool(unsigned num_tokens, FileSymbol* file_symbol_ = NULL)
         : base(NULL)
         , base_size(0)
         , base_index(0)
         , offset(0)
+        , file_symbol(file_symbol_)
+        , allocated(0)
     {
         //
         // Make a guess on the size that will be required for the ast
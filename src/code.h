@@ -59,14 +59,16 @@ public:
         assert(IsHighSurrogate(hi) && IsLowSurrogate(lo));
         return (hi << 10) + lo + (0x10000 - (0xd800 << 10) - 0xdc00);
     }
-    static inline u4 Codepoint(const wchar_t* p)
+    template <typename Char>
+    static inline u4 Codepoint(const Char* p)
     {
         u4 result = (u4) *p;
         if (IsHighSurrogate(result) && IsLowSurrogate(p[1]))
             result = Codepoint(result, p[1]);
         return result;
     }
-    static inline int Codelength(const wchar_t* p)
+    template <typename Char>
+    static inline int Codelength(const Char* p)
     {
         return (IsHighSurrogate(*p) && IsLowSurrogate(p[1])) ? 2 : 1;
     }
@@ -129,34 +131,41 @@ public:
 //
 // The following methods recognize Unicode surrogate pairs, hence the need to
 // pass a pointer. Use Codelength() to determine if one or two characters
-// were used in the formation of a character.
+// were used in the formation of a character. The pointer is to wchar_t, as
+// in a name, or to SourceChar, as in the input buffer of the scanner.
 //
-    static inline bool IsWhitespace(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsWhitespace(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] == SPACE_CODE;
     }
-    static inline bool IsDigit(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsDigit(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] == DIGIT_CODE;
     }
-    static inline bool IsUpper(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsUpper(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] == UPPER_CODE;
     }
-    static inline bool IsLower(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsLower(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] == LOWER_CODE;
     }
-    static inline bool IsAlpha(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsAlpha(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] >= LOWER_CODE;
     }
-    static inline bool IsAlnum(const wchar_t* p)
+    template <typename Char>
+    static inline bool IsAlnum(const Char* p)
     {
         u4 c = Codepoint(p);
         return codes[(u2) (blocks[c >> SHIFT] + c)] >= DIGIT_CODE;
@@ -667,7 +667,8 @@ class ByteCode : public ClassFile, public StringConstant, public Operators
 
     bool string_overflow,
          library_method_not_found,
-         last_op_goto;        // set if last operation was GOTO or GOTO_W.
+         last_op_goto,        // set if last operation was GOTO or GOTO_W.
+         write_deferred;      // set if the class file awaits a ClassFileWriter.
     //
     // This variable is non-zero only in constructors of local classes; it
     // gives the offset where variable shadow parameters begin.
@@ -1457,6 +1458,7 @@ public:
     }
 
     void GenerateCode();
+    bool WriteDeferred() const { return write_deferred; }
 };
 
 
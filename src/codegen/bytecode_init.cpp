@@ -10,10 +10,55 @@
 #include "symbol.h"
 #include "table.h"
 #include "option.h"
+#include "profile.h"
 #include "typeparam.h"
 
+#include <string>
+
 namespace Jopa {
 
+//
+// The annotations on the declaration of type, as written, token by token,
+// for ClassFile::AbiFingerprint.
+//
+static std::string DeclaredAnnotations(TypeSymbol* type)
+{
+    std::string text;
+    AstModifiers* modifiers = type -> declaration -> owner
+        ? type -> declaration -> owner -> modifiers_opt : NULL;
+    if (! modifiers)
+        return text;
+
+    LexStream* lex_stream = type -> semantic_environment -> sem -> lex_stream;
+    for (unsigned i = 0; i < modifiers -> NumModifiers(); i++)
+    {
+        AstAnnotation* annotation = modifiers -> Modifier(i) -> AnnotationCast();
+        if (! annotation)
+            continue;
+        for (TokenIndex t = annotation -> LeftToken();
+             t <= annotation -> RightToken(); t++)
+        {
+            const wchar_t* name = lex_stream -> NameString(t);
+            unsigned length = lex_stream -> NameStringLength(t);
+            text += ' ';
+            for (unsigned k = 0; k < length; k++)
+            {
+                if (name[k] > 0 && name[k] < 0x80)
+                    text += (char) name[k];
+                else
+                {
+                    char escape[16];
+                    snprintf(escape, sizeof(escape), "\\u%04x",
+                             (unsigned) name[k]);
+                    text += escape;
+                }
+            }
+        }
+    }
+    return text;
+}
+
+
 void ByteCode::GenerateCode()
 {
     AstClassBody* class_body = unit_type -> declaration;
@@ -345,8 +390,28 @@ void ByteCode::GenerateCode()
                                 unit_type -> ExternalName());
     }
 
+    //
+    // With --incremental-db, record what the dependents of the type get to
+    // see of it; the class files of local and anonymous types do not count.
+    //
+    if (control.dependence_database && ! unit_type -> IsLocal() &&
+        ! unit_type -> Anonymous())
+    {
+        unit_type -> outermost_type -> abi_fingerprint +=
+            AbiFingerprint(DeclaredAnnotations(unit_type).c_str());
+    }
+    Account(sizeof(ByteCode));
+
+    //
+    // With a ClassFileWriter in place, serializing and writing the class
+    // file is left to it; see Control::ProcessBodies.
+    //
     if (semantic.NumErrors() == 0)
-        Write(unit_type);
+    {
+        if (control.class_file_writer)
+            write_deferred = true;
+        else Write(unit_type);
+    }
 #ifdef JOPA_DEBUG
     if (control.option.debug_dump_class)
         Print();
@@ -1222,6 +1287,7 @@ void ByteCode::EndMethod(int method_index, MethodSymbol* msym)
         //
         if (stack_map_generator)
         {
+            Profiler::Phase phase(control.profiler, Profiler::STACKMAP);
             StackMapTableAttribute* stack_map_attr =
                 stack_map_generator->GenerateAttribute(
                     RegisterUtf8(control.StackMapTable_literal));
@@ -1482,6 +1482,7 @@ ByteCode::ByteCode(TypeSymbol* type)
     , string_overflow(false)
     , library_method_not_found(false)
     , last_op_goto(false)
+    , write_deferred(false)
     , shadow_parameter_offset(0)
     , code_attribute(NULL)
     , line_number_table_attribute(NULL)
@@ -1500,11 +1501,6 @@ ByteCode::ByteCode(TypeSymbol* type)
     , fieldref_constant_pool_index(NULL)
     , methodref_constant_pool_index(NULL)
 {
-#ifdef JOPA_DEBUG
-    if (! control.option.nowrite)
-        control.class_files_written++;
-#endif // JOPA_DEBUG
-
     //
     // For compatibility reasons, protected classes are marked public, and
     // private classes are marked default; and no class may be static or
@@ -7,6 +7,12 @@
 #include "zipfile.h"
 #include "typeparam.h"
 #include "paramtype.h"
+#include "profile.h"
+#include "jar_writer.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -1182,6 +1188,7 @@ ClassFile::ClassFile(const char* buf, unsigned buf_size)
     , attr_visible_annotations(NULL)
     , attr_invisible_annotations(NULL)
     , attr_enclosing_method(NULL)
+    , footprint(0)
 {
     if (magic != MAGIC || major_version < 45)
         MarkInvalid("unknown class format");
@@ -1282,6 +1289,7 @@ ClassFile::ClassFile(const char* buf, unsigned buf_size)
             MarkInvalid("invalid method attribute");
         }
     }
+    Account(sizeof(ClassFile));
 }
 
 void ClassFile::Write(TypeSymbol* unit_type) const
@@ -1291,12 +1299,58 @@ void ClassFile::Write(TypeSymbol* unit_type) const
     OutputBuffer output_buffer;
 
     const char* class_file_name = unit_type -> ClassName();
-    if (control.option.verbose)
-        Coutput << "[write " << class_file_name << "]" << endl;
     assert (Valid());
     if (control.option.nowrite)
+    {
+        if (control.option.verbose)
+            Coutput << "[write " << class_file_name << "]" << endl;
         return;
+    }
+
+    Profiler::Phase phase(control.profiler, Profiler::WRITE, NULL,
+                          class_file_name);
+    Serialize(output_buffer);
+
+    if (control.option.skip_unchanged && ! control.jar_writer &&
+        output_buffer.SameAsFile(class_file_name))
+    {
+        if (control.option.verbose)
+            Coutput << "[unchanged " << class_file_name << "]" << endl;
+        control.class_files_unchanged++;
+        return;
+    }
+
+    if (control.option.verbose)
+        Coutput << "[write " << class_file_name << "]" << endl;
+
+    // Now output to file, or to the archive with -d out.jar
+    if (control.jar_writer
+        ? control.jar_writer -> Add(class_file_name, output_buffer)
+        : output_buffer.WriteToFile(class_file_name))
+    {
+        control.class_files_written++;
+    }
+    else
+    {
+        int length = strlen(class_file_name);
+        wchar_t* name = new wchar_t[length + 1];
+        for (int j = 0; j < length; j++)
+            name[j] = class_file_name[j];
+        name[length] = U_NULL;
+
+        sem -> ReportSemError(SemanticError::CANNOT_WRITE_FILE,
+                              unit_type -> declaration, name);
+        delete [] name;
+    }
+}
+
 
+//
+// Lay out the class file in output_buffer. This touches nothing but the
+// ClassFile itself, so it may run on a ClassFileWriter thread.
+//
+void ClassFile::Serialize(OutputBuffer& output_buffer) const
+{
     unsigned i;
     output_buffer.PutU4(MAGIC);
     output_buffer.PutU2(minor_version);
@@ -1326,20 +1380,232 @@ void ClassFile::Write(TypeSymbol* unit_type) const
     output_buffer.PutU2(attributes.Length());
     for (i = 0; i < attributes.Length(); i++)
         attributes[i] -> Put(output_buffer);
+}
 
-    // Now output to file
-    if (! output_buffer.WriteToFile(class_file_name))
+
+//
+// The estimate counts the entries of the constant pool, the fields and the
+// methods as objects of a typical size, and each attribute by its length in
+// the class file, which for Code includes the bytecode.
+//
+void ClassFile::Account(size_t object_size)
+{
+    size_t bytes = object_size;
+    unsigned i;
+    for (i = 1; i < constant_pool.Length(); i++)
     {
-        int length = strlen(class_file_name);
-        wchar_t* name = new wchar_t[length + 1];
-        for (int j = 0; j < length; j++)
-            name[j] = class_file_name[j];
-        name[length] = U_NULL;
+        bytes += sizeof(CPInfo*) + 4 * sizeof(void*);
+        if (constant_pool.Valid(i) &&
+            constant_pool[i] -> Tag() == CPInfo::CONSTANT_Utf8)
+        {
+            bytes += ((const CPUtf8Info*) constant_pool[i]) -> Length();
+        }
+    }
+    for (i = 0; i < fields.Length(); i++)
+    {
+        bytes += sizeof(FieldInfo*) + sizeof(FieldInfo);
+        for (unsigned k = 0; k < fields[i] -> AttributesCount(); k++)
+            bytes += sizeof(AttributeInfo) +
+                fields[i] -> Attribute(k) -> AttributeLength();
+    }
+    for (i = 0; i < methods.Length(); i++)
+    {
+        bytes += sizeof(MethodInfo*) + sizeof(MethodInfo);
+        for (unsigned k = 0; k < methods[i] -> AttributesCount(); k++)
+            bytes += sizeof(AttributeInfo) +
+                methods[i] -> Attribute(k) -> AttributeLength();
+    }
+    for (i = 0; i < attributes.Length(); i++)
+        bytes += sizeof(AttributeInfo) + attributes[i] -> AttributeLength();
 
-        sem -> ReportSemError(SemanticError::CANNOT_WRITE_FILE,
-                              unit_type -> declaration, name);
-        delete [] name;
+    if (bytes > footprint)
+        MemoryAccount::Allocate(MemoryAccount::CLASS_FILES, bytes - footprint);
+    else MemoryAccount::Free(MemoryAccount::CLASS_FILES, footprint - bytes);
+    footprint = bytes;
+}
+
+
+static void AppendUtf8(std::string& item, const CPUtf8Info* utf8)
+{
+    item += ' ';
+    item.append(utf8 -> Bytes(), utf8 -> Length());
+}
+
+
+static void AppendConstant(std::string& item, const CPInfo* constant,
+                           const ConstantPool& constant_pool)
+{
+    char value[32];
+    switch (constant -> Tag())
+    {
+    case CPInfo::CONSTANT_Integer:
+        snprintf(value, sizeof(value), " =I%d",
+                 (int) ((const CPIntegerInfo*) constant) -> Value());
+        break;
+    case CPInfo::CONSTANT_Float:
+        snprintf(value, sizeof(value), " =F%08x",
+                 (unsigned) ((const CPFloatInfo*) constant) -> Value().Word());
+        break;
+    case CPInfo::CONSTANT_Long:
+        {
+            const LongInt& long_value =
+                ((const CPLongInfo*) constant) -> Value();
+            snprintf(value, sizeof(value), " =J%08x%08x",
+                     (unsigned) long_value.HighWord(),
+                     (unsigned) long_value.LowWord());
+        }
+        break;
+    case CPInfo::CONSTANT_Double:
+        {
+            const IEEEdouble& double_value =
+                ((const CPDoubleInfo*) constant) -> Value();
+            snprintf(value, sizeof(value), " =D%08x%08x",
+                     (unsigned) double_value.HighWord(),
+                     (unsigned) double_value.LowWord());
+        }
+        break;
+    default:
+        {
+            assert(constant -> Tag() == CPInfo::CONSTANT_String);
+            const CPStringInfo* string = (const CPStringInfo*) constant;
+            snprintf(value, sizeof(value), " =S%u:",
+                     (unsigned) string -> Length(constant_pool));
+            item += value;
+            item.append(string -> Bytes(constant_pool),
+                        string -> Length(constant_pool));
+        }
+        return;
+    }
+    item += value;
+}
+
+
+//
+// Hash what other compilation units get to see of this class, for
+// --incremental-db: its name, modifiers, supertypes and generic signature,
+// its annotations, and the fields and methods that are not private, with
+// their modifiers, descriptors, generic signatures, exceptions and, as they
+// are inlined, constant values. Code, the annotations of members, private
+// and synthetic members (accessors, bridges) and the order of the members
+// do not count.
+//
+// The annotations are given as written (see ByteCode::GenerateCode), not
+// taken from the class file, which does not have all of their values; it
+// is the @Retention and @Target of an annotation type that decide how, and
+// where, it may be used.
+//
+u8 ClassFile::AbiFingerprint(const char* annotations) const
+{
+    unsigned i;
+    char flags[16];
+    std::vector<std::string> items;
+
+    std::string item("C");
+    snprintf(flags, sizeof(flags), " %04x",
+             (unsigned) (access_flags & ~ACCESS_SYNTHETIC));
+    item += flags;
+    const char* this_name = ((const CPClassInfo*) constant_pool[this_class]) ->
+        TypeName(constant_pool);
+    item += ' ';
+    item += this_name;
+    if (super_class)
+    {
+        item += ' ';
+        item += ((const CPClassInfo*) constant_pool[super_class]) ->
+            TypeName(constant_pool);
+    }
+    for (i = 0; i < interfaces.Length(); i++)
+    {
+        item += ' ';
+        item += ((const CPClassInfo*) constant_pool[interfaces[i]]) ->
+            TypeName(constant_pool);
+    }
+    if (attr_signature)
+        AppendUtf8(item, attr_signature -> Signature(constant_pool));
+    if (*annotations)
+    {
+        item += " @";
+        item += annotations;
+    }
+    items.push_back(item);
+
+    //
+    // The modifiers of a member type are only found in InnerClasses.
+    //
+    unsigned num_inner_classes =
+        attr_innerclasses ? attr_innerclasses -> InnerClassesLength() : 0;
+    for (i = 0; i < num_inner_classes; i++)
+    {
+        const CPClassInfo* outer = attr_innerclasses -> Outer(i, constant_pool);
+        const char* inner_name =
+            attr_innerclasses -> Inner(i, constant_pool) ->
+            TypeName(constant_pool);
+        if (! outer || strcmp(inner_name, this_name) != 0)
+            continue;
+        snprintf(flags, sizeof(flags), "I %04x ",
+                 (unsigned) attr_innerclasses -> Flags(i).Flags());
+        items.push_back(flags + std::string(outer -> TypeName(constant_pool)));
+    }
+
+    for (i = 0; i < fields.Length(); i++)
+    {
+        const FieldInfo* field = fields[i];
+        if (field -> ACC_PRIVATE() || field -> Synthetic())
+            continue;
+        snprintf(flags, sizeof(flags), "F %04x ", (unsigned) field -> Flags());
+        item = flags;
+        item.append(field -> Name(constant_pool),
+                    field -> NameLength(constant_pool));
+        AppendUtf8(item, field -> Descriptor(constant_pool));
+        if (field -> GenericSignature())
+            AppendUtf8(item, field -> GenericSignature() ->
+                       Signature(constant_pool));
+        if (field -> ConstantValue(constant_pool))
+            AppendConstant(item, field -> ConstantValue(constant_pool),
+                           constant_pool);
+        items.push_back(item);
+    }
+
+    for (i = 0; i < methods.Length(); i++)
+    {
+        const MethodInfo* method = methods[i];
+        if (method -> ACC_PRIVATE() || method -> Synthetic() ||
+            method -> Bridge() ||
+            strcmp(method -> Name(constant_pool), "<clinit>") == 0)
+        {
+            continue;
+        }
+        snprintf(flags, sizeof(flags), "M %04x ",
+                 (unsigned) (method -> Flags() &
+                             ~(ACCESS_SYNCHRONIZED | ACCESS_NATIVE |
+                               ACCESS_STRICTFP)));
+        item = flags;
+        item.append(method -> Name(constant_pool),
+                    method -> NameLength(constant_pool));
+        AppendUtf8(item, method -> Descriptor(constant_pool));
+        if (method -> GenericSignature())
+            AppendUtf8(item, method -> GenericSignature() ->
+                       Signature(constant_pool));
+        const ExceptionsAttribute* exceptions = method -> Exceptions();
+        unsigned num_exceptions =
+            exceptions ? exceptions -> NumberOfExceptions() : 0;
+        for (unsigned k = 0; k < num_exceptions; k++)
+        {
+            item += " throws ";
+            item += exceptions -> Exception(k, constant_pool) ->
+                TypeName(constant_pool);
+        }
+        items.push_back(item);
     }
+
+    std::sort(items.begin() + 1, items.end());
+    u8 hash = 14695981039346656037ULL; // FNV-1a
+    for (i = 0; i < items.size(); i++)
+    {
+        for (unsigned k = 0; k <= items[i].length(); k++) // with the '\0'
+            hash = (hash ^ (u1) items[i].c_str()[k]) * 1099511628211ULL;
+    }
+    return hash;
 }
 
 
@@ -1681,11 +1947,12 @@ TypeSymbol* Semantic::ReadTypeFromSignature(TypeSymbol* base_type,
 //
 void Semantic::ReadClassFile(TypeSymbol* type, TokenIndex tok)
 {
-#ifdef JOPA_DEBUG
-    control.class_files_read++;
-#endif // JOPA_DEBUG
-
     FileSymbol* file_symbol = type -> file_symbol;
+    Profiler::Phase phase(control.profiler, Profiler::READ_CLASS, NULL,
+                          type -> fully_qualified_name -> value);
+    control.class_files_read++;
+    if (file_symbol -> IsZip())
+        control.zip_class_files_read++;
 
     if (control.option.verbose)  {
         Coutput << "[read "
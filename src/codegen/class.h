@@ -5,6 +5,7 @@
 #include "tuple.h"
 #include "long.h"
 #include "double.h"
+#include "memacct.h"
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -3051,10 +3052,17 @@ public:
     }
 
     inline void SetDescriptorIndex(u2 index) { descriptor_index = index; }
+    const CPUtf8Info* Descriptor(const ConstantPool& constant_pool) const
+    {
+        assert(constant_pool[descriptor_index] -> Tag() ==
+               CPInfo::CONSTANT_Utf8);
+        return (const CPUtf8Info*) constant_pool[descriptor_index];
+    }
     const char* Signature(const ConstantPool&, const Control&) const;
     u2 SignatureLength(const ConstantPool&, const Control&) const;
 
     inline u2 AttributesCount() const { return attributes.Length(); }
+    const AttributeInfo* Attribute(u2 i) const { return attributes[i]; }
     inline void AddAttribute(AttributeInfo* attribute)
     {
         attributes.Next() = attribute;
@@ -3201,10 +3209,17 @@ public:
     }
 
     inline void SetDescriptorIndex(u2 index) { descriptor_index = index; }
+    const CPUtf8Info* Descriptor(const ConstantPool& constant_pool) const
+    {
+        assert(constant_pool[descriptor_index] -> Tag() ==
+               CPInfo::CONSTANT_Utf8);
+        return (const CPUtf8Info*) constant_pool[descriptor_index];
+    }
     const char* Signature(const ConstantPool&, const Control&) const;
     u2 SignatureLength(const ConstantPool&, const Control&) const;
 
     inline u2 AttributesCount() const { return attributes.Length(); }
+    const AttributeInfo* Attribute(u2 i) const { return attributes[i]; }
     inline void AddAttribute(AttributeInfo* attribute)
     {
         attributes.Next() = attribute;
@@ -3359,6 +3374,14 @@ protected:
     AnnotationsAttribute* attr_invisible_annotations;
     EnclosingMethodAttribute* attr_enclosing_method;
 
+    size_t footprint; // bytes noted with MemoryAccount
+
+    //
+    // Bring MemoryAccount up to date with an estimate of the bytes held by
+    // this class file, an object of size object_size.
+    //
+    void Account(size_t object_size);
+
 public:
     //
     // Construct a class file for output, given the finished type.
@@ -3381,6 +3404,7 @@ public:
         , attr_visible_annotations(NULL)
         , attr_invisible_annotations(NULL)
         , attr_enclosing_method(NULL)
+        , footprint(0)
     {}
 
     //
@@ -3401,6 +3425,7 @@ public:
             delete methods[i];
         for (i = 0; i < attributes.Length(); i++)
             delete attributes[i];
+        MemoryAccount::Free(MemoryAccount::CLASS_FILES, footprint);
     }
 
     u2 ConstantPoolCount() const { return constant_pool.Length(); }
@@ -3496,6 +3521,8 @@ public:
     const SignatureAttribute* Signature() const { return attr_signature; }
 
     void Write(TypeSymbol* unit_type) const;
+    void Serialize(OutputBuffer&) const;
+    u8 AbiFingerprint(const char* annotations) const;
 
     bool Valid() const { return (problem == NULL); }
     void MarkInvalid(const char* reason) { problem = reason; }
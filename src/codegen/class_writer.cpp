@@ -0,0 +1,203 @@
+#include "class_writer.h"
+#include "bytecode.h"
+#include "control.h"
+#include "option.h"
+#include "profile.h"
+#include "semantic.h"
+#include "stream.h"
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+ClassFileWriter::ClassFileWriter(Control& control_, unsigned num_threads)
+    : control(control_)
+    , max_in_flight(num_threads * 4)
+    , in_flight(0)
+    , shutting_down(false)
+{
+    for (unsigned i = 0; i < num_threads; i++)
+        workers.push_back(std::thread(&ClassFileWriter::Run, this));
+}
+
+
+ClassFileWriter::~ClassFileWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    work_available.notify_all();
+    for (unsigned i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    //
+    // Outcomes nobody asked for are dropped; the workers have already
+    // written (or failed to write) every queued class file.
+    //
+    for (unsigned k = 0; k < jobs.size(); k++)
+    {
+        delete [] jobs[k] -> class_file_name;
+        delete jobs[k];
+    }
+}
+
+
+void ClassFileWriter::Submit(ByteCode* code, TypeSymbol* type)
+{
+    const char* class_file_name = type -> ClassName();
+    assert(code -> Valid());
+
+    //
+    // Capture everything a diagnostic might need now: by the time the
+    // outcome is collected, the type's declaration has been released.
+    //
+    Job* job = new Job;
+    job -> code = code;
+    job -> sem = type -> semantic_environment -> sem;
+    job -> class_file_name = new char[strlen(class_file_name) + 1];
+    strcpy(job -> class_file_name, class_file_name);
+    job -> left_token = type -> declaration -> LeftToken();
+    job -> right_token = type -> declaration -> RightToken();
+    job -> done = false;
+    job -> success = false;
+    job -> unchanged = false;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        work_finished.wait(lock, [this] { return in_flight < max_in_flight; });
+        in_flight++;
+        queue.push_back(job);
+        jobs.push_back(job);
+    }
+    work_available.notify_one();
+}
+
+
+bool ClassFileWriter::Collect(Semantic* sem, bool wait)
+{
+    Tuple<Job*> finished(8);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            bool pending = false;
+            for (unsigned k = 0; k < jobs.size() && ! pending; k++)
+                pending = jobs[k] -> sem == sem && ! jobs[k] -> done;
+            if (! pending)
+                break;
+            if (! wait)
+                return false;
+            work_finished.wait(lock);
+        }
+
+        std::deque<Job*> remaining;
+        for (unsigned k = 0; k < jobs.size(); k++)
+        {
+            if (jobs[k] -> sem == sem)
+                finished.Next() = jobs[k];
+            else remaining.push_back(jobs[k]);
+        }
+        jobs.swap(remaining);
+    }
+
+    //
+    // A serial run stops writing a unit's class files at its first error,
+    // so only the first failed write of the unit is worth reporting. The
+    // -verbose lines are those of a serial run as well, in the same order.
+    //
+    bool failed = false;
+    for (unsigned i = 0; i < finished.Length(); i++)
+    {
+        if (finished[i] -> unchanged)
+        {
+            if (control.option.verbose)
+            {
+                Coutput << "[unchanged " << finished[i] -> class_file_name
+                        << "]" << endl;
+            }
+            control.class_files_unchanged++;
+        }
+        else
+        {
+            if (control.option.verbose)
+            {
+                Coutput << "[write " << finished[i] -> class_file_name
+                        << "]" << endl;
+            }
+            if (finished[i] -> success)
+                control.class_files_written++;
+        }
+        if (! finished[i] -> success && ! failed)
+        {
+            Report(finished[i]);
+            failed = true;
+        }
+        delete [] finished[i] -> class_file_name;
+        delete finished[i];
+    }
+    return true;
+}
+
+
+void ClassFileWriter::Run()
+{
+    for (;;)
+    {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this] {
+                return shutting_down || ! queue.empty();
+            });
+            if (queue.empty())
+                return;
+            job = queue.front();
+            queue.pop_front();
+        }
+
+        bool success;
+        {
+            Profiler::Phase phase(control.profiler, Profiler::WRITE,
+                                  job -> sem -> source_file_symbol,
+                                  job -> class_file_name);
+            OutputBuffer output_buffer;
+            job -> code -> Serialize(output_buffer);
+            job -> unchanged = control.option.skip_unchanged &&
+                output_buffer.SameAsFile(job -> class_file_name);
+            success = job -> unchanged ||
+                output_buffer.WriteToFile(job -> class_file_name);
+        }
+        delete job -> code;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job -> code = NULL;
+            job -> success = success;
+            job -> done = true;
+            in_flight--;
+        }
+        work_finished.notify_all();
+    }
+}
+
+
+//
+// Issue the diagnostic ClassFile::Write would have issued for a failed write.
+//
+void ClassFileWriter::Report(Job* job)
+{
+    int length = strlen(job -> class_file_name);
+    wchar_t* name = new wchar_t[length + 1];
+    for (int j = 0; j < length; j++)
+        name[j] = job -> class_file_name[j];
+    name[length] = U_NULL;
+
+    job -> sem -> ReportSemError(SemanticError::CANNOT_WRITE_FILE,
+                                 job -> left_token, job -> right_token, name);
+    delete [] name;
+}
+
+
+} // Close namespace Jopa block
+
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "platform.h"
+#include "tuple.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class ByteCode;
+class Control;
+class Semantic;
+class TypeSymbol;
+
+
+//
+// A pool of worker threads that serializes finished class files and writes
+// them out (option -j). Code generation itself stays on the main thread,
+// since it still interns names and literals into the tables shared through
+// Control; once GenerateCode returns, a ByteCode no longer refers to any
+// of that state, so the workers only ever touch objects they own.
+//
+// Diagnostics are never issued from a worker. Each write records its
+// outcome, and the main thread collects the outcomes of a compilation unit
+// (in submission order) before that unit's messages are printed.
+//
+class ClassFileWriter
+{
+public:
+    ClassFileWriter(Control&, unsigned num_threads);
+    ~ClassFileWriter();
+
+    //
+    // Queue the class file for type. The writer takes ownership of code.
+    // Blocks while too many class files are in flight.
+    //
+    void Submit(ByteCode* code, TypeSymbol* type);
+
+    //
+    // Report the outcome of all writes submitted on behalf of sem. If wait
+    // is false and some of them are still pending, nothing is reported and
+    // false is returned.
+    //
+    bool Collect(Semantic* sem, bool wait);
+
+private:
+    struct Job
+    {
+        ByteCode* code;
+        Semantic* sem;
+        char* class_file_name;
+        TokenIndex left_token;
+        TokenIndex right_token;
+        bool done;
+        bool success;
+        bool unchanged; // with --skip-unchanged, not rewritten
+    };
+
+    Control& control;
+    unsigned max_in_flight;
+    unsigned in_flight;
+    bool shutting_down;
+
+    std::deque<Job*> queue;    // jobs not yet picked up by a worker
+    std::deque<Job*> jobs;     // all uncollected jobs, in submission order
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+    std::vector<std::thread> workers;
+
+    void Run();
+    void Report(Job*);
+};
+
+
+} // Close namespace Jopa block
+
@@ -0,0 +1,407 @@
+#include "jar_writer.h"
+#include <cstring>
+#include <cstdio>
+#include <time.h>
+#include <zlib.h>
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+static const u2 VERSION_NEEDED = 20; // deflate
+static const u2 VERSION_NEEDED_ZIP64 = 45;
+static const u2 UTF8_NAMES = 0x0800; // general purpose flag bit 11
+static const u2 STORED = 0;
+static const u2 DEFLATED = 8;
+
+
+JarWriter::JarWriter(const char* file_name_, int level_,
+                     unsigned num_threads)
+    : file_name(file_name_)
+    , temporary_name(file_name + ".tmp")
+    , file(SystemFopen(temporary_name.c_str(), "wb"))
+    , level(level_)
+    , date_time(DosDateTime())
+    , offset(0)
+    , failed(false)
+    , entries(8, 4)
+    , max_in_flight(num_threads * 4)
+    , buffered(0)
+    , shutting_down(false)
+    , header_length(0)
+{
+    //
+    // A jar starts with its manifest, which has nothing to say but that it
+    // is one.
+    //
+    size_t length = file_name.length();
+    if (file && length > 4 &&
+        strcasecmp(&file_name[length - 4], ".jar") == 0)
+    {
+        static const char manifest[] =
+            "Manifest-Version: 1.0\r\n"
+            "Created-By: jopa " JOPA_VERSION_STRING "\r\n"
+            "\r\n";
+        OutputBuffer buffer;
+        buffer.PutN((const u1*) manifest, sizeof(manifest) - 1);
+        Add("META-INF/MANIFEST.MF", buffer);
+    }
+
+    if (file && num_threads > 1 && level > 0)
+    {
+        for (unsigned i = 0; i < num_threads; i++)
+            workers.push_back(std::thread(&JarWriter::Run, this));
+    }
+}
+
+
+JarWriter::~JarWriter()
+{
+    Abandon();
+    for (unsigned i = 0; i < entries.Length(); i++)
+        delete [] entries[i].name;
+}
+
+
+bool JarWriter::Add(const char* name, const OutputBuffer& buffer)
+{
+    if (! file)
+        return false;
+
+    Job* job = new Job;
+    job -> entry.name = new char[strlen(name) + 1];
+    strcpy(job -> entry.name, name);
+    job -> entry.size = buffer.Length();
+    job -> data = new u1[job -> entry.size];
+    buffer.CopyTo(job -> data);
+    job -> compressed = NULL;
+    job -> done = false;
+
+    if (workers.empty())
+    {
+        Deflate(job);
+        WriteEntry(job);
+        return ! failed;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_finished.wait(lock, [this, job] {
+        return pending.empty() ||
+            (pending.size() < max_in_flight &&
+             buffered + job -> entry.size <= MAX_BUFFERED);
+    });
+    buffered += job -> entry.size;
+    queue.push_back(job);
+    pending.push_back(job);
+    bool written = ! failed;
+    lock.unlock();
+    work_available.notify_one();
+    return written;
+}
+
+
+void JarWriter::Run()
+{
+    for (;;)
+    {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [this] {
+                return shutting_down || ! queue.empty();
+            });
+            if (queue.empty())
+                return;
+            job = queue.front();
+            queue.pop_front();
+        }
+
+        Deflate(job);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job -> done = true;
+            WriteFinished();
+        }
+        work_finished.notify_all();
+    }
+}
+
+
+//
+// Compute the CRC of the data of job, and deflate it, unless that does not
+// make it any smaller. This touches nothing but the job.
+//
+void JarWriter::Deflate(Job* job)
+{
+    Entry& entry = job -> entry;
+    entry.crc = crc32(crc32(0, Z_NULL, 0), job -> data, entry.size);
+    entry.method = STORED;
+    entry.compressed_size = entry.size;
+    if (level == 0)
+        return;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // Negative window bits: raw deflate data, without a zlib header.
+    if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return;
+    }
+    uLong bound = deflateBound(&stream, entry.size);
+    job -> compressed = new u1[bound];
+    stream.next_in = job -> data;
+    stream.avail_in = entry.size;
+    stream.next_out = job -> compressed;
+    stream.avail_out = bound;
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END &&
+        stream.total_out < entry.size)
+    {
+        entry.method = DEFLATED;
+        entry.compressed_size = stream.total_out;
+    }
+    else
+    {
+        delete [] job -> compressed;
+        job -> compressed = NULL;
+    }
+    deflateEnd(&stream);
+}
+
+
+//
+// Append the deflated job to the archive, and let go of it. With workers,
+// this is only done with the mutex held.
+//
+void JarWriter::WriteEntry(Job* job)
+{
+    Entry& entry = entries.Next();
+    entry = job -> entry;
+    entry.offset = offset;
+
+    u2 name_length = strlen(entry.name);
+    PutU4(0x04034b50);
+    PutU2(VERSION_NEEDED);
+    PutU2(UTF8_NAMES);
+    PutU2(entry.method);
+    PutU4(date_time);
+    PutU4(entry.crc);
+    PutU4(entry.compressed_size);
+    PutU4(entry.size);
+    PutU2(name_length);
+    PutU2(0); // extra field length
+    WriteHeader();
+    Write(entry.name, name_length);
+    Write(job -> compressed ? job -> compressed : job -> data,
+          entry.compressed_size);
+
+    //
+    // The local headers carry no zip64 fields, so an entry has to start
+    // within the first 4GB of the archive.
+    //
+    if (entry.offset > 0xFFFFFFFFu)
+        failed = true;
+
+    delete [] job -> compressed;
+    delete [] job -> data;
+    delete job;
+}
+
+
+//
+// Write out the jobs at the head of the reorder buffer that are done.
+//
+void JarWriter::WriteFinished()
+{
+    while (! pending.empty() && pending.front() -> done)
+    {
+        Job* job = pending.front();
+        pending.pop_front();
+        buffered -= job -> entry.size;
+        WriteEntry(job);
+    }
+}
+
+
+//
+// Wait for the jobs in flight to be written, and the workers to be gone.
+//
+void JarWriter::StopWorkers()
+{
+    if (workers.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    work_available.notify_all();
+    for (unsigned i = 0; i < workers.size(); i++)
+        workers[i].join();
+    workers.clear();
+    assert(pending.empty());
+}
+
+
+bool JarWriter::Close()
+{
+    if (! file)
+        return false;
+    StopWorkers();
+
+    u8 directory_offset = offset;
+    for (unsigned i = 0; i < entries.Length(); i++)
+    {
+        Entry& entry = entries[i];
+        u2 name_length = strlen(entry.name);
+        PutU4(0x02014b50);
+        PutU2(VERSION_NEEDED); // version made by: MS-DOS, no attributes
+        PutU2(VERSION_NEEDED);
+        PutU2(UTF8_NAMES);
+        PutU2(entry.method);
+        PutU4(date_time);
+        PutU4(entry.crc);
+        PutU4(entry.compressed_size);
+        PutU4(entry.size);
+        PutU2(name_length);
+        PutU2(0); // extra field length
+        PutU2(0); // comment length
+        PutU2(0); // disk number
+        PutU2(0); // internal attributes
+        PutU4(0); // external attributes
+        PutU4((u4) entry.offset);
+        WriteHeader();
+        Write(entry.name, name_length);
+    }
+    u8 directory_size = offset - directory_offset;
+
+    //
+    // Past 65535 entries, or 4GB of them, the counts and the offset in the
+    // end of central directory record do not fit, and the zip64 records
+    // that hold them go in front of it.
+    //
+    u8 count = entries.Length();
+    bool zip64 = count >= 0xFFFF || directory_offset >= 0xFFFFFFFFu;
+    if (zip64)
+    {
+        u8 zip64_offset = offset;
+        PutU4(0x06064b50);
+        PutU8(44); // the size of the rest of the record
+        PutU2(VERSION_NEEDED_ZIP64);
+        PutU2(VERSION_NEEDED_ZIP64);
+        PutU4(0); // this disk
+        PutU4(0); // the disk of the central directory
+        PutU8(count);
+        PutU8(count);
+        PutU8(directory_size);
+        PutU8(directory_offset);
+        WriteHeader();
+
+        PutU4(0x07064b50);
+        PutU4(0); // the disk of the zip64 record
+        PutU8(zip64_offset);
+        PutU4(1); // number of disks
+        WriteHeader();
+    }
+
+    PutU4(0x06054b50);
+    PutU2(0); // this disk
+    PutU2(0); // the disk of the central directory
+    PutU2(zip64 ? 0xFFFF : (u2) count);
+    PutU2(zip64 ? 0xFFFF : (u2) count);
+    PutU4(zip64 ? 0xFFFFFFFFu : (u4) directory_size);
+    PutU4(zip64 ? 0xFFFFFFFFu : (u4) directory_offset);
+    PutU2(0); // comment length
+    WriteHeader();
+
+    if (fclose(file) != 0)
+        failed = true;
+    file = NULL;
+    if (! failed &&
+        rename(temporary_name.c_str(), file_name.c_str()) != 0)
+    {
+        failed = true;
+    }
+    if (failed)
+        remove(temporary_name.c_str());
+    return ! failed;
+}
+
+
+void JarWriter::Abandon()
+{
+    StopWorkers();
+    if (file)
+    {
+        fclose(file);
+        file = NULL;
+        remove(temporary_name.c_str());
+    }
+}
+
+
+void JarWriter::PutU2(u2 u)
+{
+    header[header_length++] = u & 0xff;
+    header[header_length++] = u >> 8;
+}
+
+
+void JarWriter::PutU4(u4 u)
+{
+    PutU2(u & 0xffff);
+    PutU2(u >> 16);
+}
+
+
+void JarWriter::PutU8(u8 u)
+{
+    PutU4(u & 0xffffffffu);
+    PutU4(u >> 32);
+}
+
+
+void JarWriter::WriteHeader()
+{
+    assert(header_length <= sizeof(header));
+    Write(header, header_length);
+    header_length = 0;
+}
+
+
+void JarWriter::Write(const void* data, size_t size)
+{
+    if (size && fwrite(data, 1, size, file) != size)
+        failed = true;
+    offset += size;
+}
+
+
+//
+// The time of every entry: that of SOURCE_DATE_EPOCH, if it is set (see
+// reproducible-builds.org), in UTC; otherwise the earliest a zip file can
+// express.
+//
+u4 JarWriter::DosDateTime()
+{
+    u4 dos_epoch = (1 << 21) | (1 << 16); // 1980-01-01 00:00:00
+    const char* epoch = getenv("SOURCE_DATE_EPOCH");
+    if (! epoch || ! *epoch)
+        return dos_epoch;
+
+    char* end;
+    long long seconds = strtoll(epoch, &end, 10);
+    time_t t = (time_t) seconds;
+    struct tm tm;
+    if (*end || seconds < 0 || ! gmtime_r(&t, &tm) || tm.tm_year < 80)
+        return dos_epoch;
+    if (tm.tm_year > 207)
+        tm.tm_year = 207; // the last year there is room for
+    return ((u4) (tm.tm_year - 80) << 25) | ((u4) (tm.tm_mon + 1) << 21) |
+        ((u4) tm.tm_mday << 16) | ((u4) tm.tm_hour << 11) |
+        ((u4) tm.tm_min << 5) | ((u4) tm.tm_sec >> 1);
+}
+
+
+} // Close namespace Jopa block
+
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "platform.h"
+#include "tuple.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+//
+// The zip (or jar) file that class files are written to with -d out.jar.
+// Each entry is deflated at the -Xjar-level and appended to the archive as
+// soon as it is added, so only the central directory is held back until
+// Close. The archive depends on nothing but the entries and the order they
+// were added in: every entry has the same time (that of SOURCE_DATE_EPOCH,
+// or else 1980-01-01 00:00), and no attributes of the host are recorded.
+//
+// The archive is written to file_name.tmp, which Close renames over
+// file_name; until then, an archive of the same name is left as it was,
+// even if it is on the classpath of this compilation and mapped in memory.
+//
+// With more than one thread (-j), the entries are deflated on worker
+// threads. They are still appended in the order they were added: an entry
+// deflated ahead of its turn waits in the reorder buffer, which Add keeps
+// from holding more than a few entries per thread, or MAX_BUFFERED bytes.
+//
+class JarWriter
+{
+public:
+    JarWriter(const char* file_name, int level, unsigned num_threads = 1);
+    ~JarWriter();
+
+    bool IsValid() { return file != NULL; }
+
+    //
+    // Append an entry with the contents of buffer. Returns false if it, or
+    // an entry before it, could not be written, in which case the archive
+    // is of no use. Blocks while the reorder buffer is full.
+    //
+    bool Add(const char* name, const OutputBuffer& buffer);
+
+    //
+    // Write the central directory, close the archive and put it in place
+    // of file_name. Returns false if any part of it could not be written,
+    // in which case file_name is left as it was.
+    //
+    bool Close();
+
+    //
+    // Close the archive without putting it in place, as after a compilation
+    // with errors; file_name is left as it was.
+    //
+    void Abandon();
+
+private:
+    struct Entry
+    {
+        char* name;
+        u4 crc;
+        u4 compressed_size;
+        u4 size;
+        u2 method;
+        u8 offset; // of the local header
+    };
+
+    //
+    // An entry on its way to the archive.
+    //
+    struct Job
+    {
+        Entry entry;
+        u1* data;
+        u1* compressed; // NULL if the entry is stored
+        bool done;
+    };
+
+    static const unsigned MAX_BUFFERED = 16 * 1024 * 1024;
+
+    std::string file_name;
+    std::string temporary_name;
+    FILE* file;
+    int level;
+    u4 date_time; // in DOS format
+    u8 offset; // where the next local header goes
+    bool failed;
+    Tuple<Entry> entries;
+
+    unsigned max_in_flight;
+    size_t buffered; // the bytes of data held by the jobs in flight
+    bool shutting_down;
+    std::deque<Job*> queue;   // jobs not yet picked up by a worker
+    std::deque<Job*> pending; // all jobs in flight, in the order added
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+    std::vector<std::thread> workers;
+
+    void Run();
+    void Deflate(Job*);
+    void WriteEntry(Job*);
+    void WriteFinished();
+    void StopWorkers();
+
+    //
+    // The fixed part of the header being put together.
+    //
+    u1 header[64];
+    unsigned header_length;
+
+    void PutU2(u2);
+    void PutU4(u4);
+    void PutU8(u8);
+    void WriteHeader();
+    void Write(const void*, size_t);
+
+    static u4 DosDateTime();
+};
+
+
+} // Close namespace Jopa block
+
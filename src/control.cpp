@@ -1,16 +1,35 @@
 #include "control.h"
 #include "scanner.h"
 #include "parser.h"
+#include "prescan.h"
 #include "semantic.h"
 #include "error.h"
 #include "bytecode.h"
+#include "class_writer.h"
+#include "jar_writer.h"
 #include "case.h"
 #include "option.h"
 #include "paramtype.h"
+#include "incrdb.h"
+#include "profile.h"
+#include "memacct.h"
+#include "watch.h"
 
 
 namespace Jopa { // Open namespace Jopa block
 Control::Control(char** arguments, Option& option_)
+    : Control(option_)
+{
+    Compile(arguments);
+}
+
+
+//
+// Set up the class path and the system packages, without compiling anything
+// yet. No threads are started here, so that a compile server can fork the
+// result (see server.h).
+//
+Control::Control(Option& option_)
     : return_code(0)
     , option(option_)
     , dot_classpath_index(0)
@@ -23,6 +42,11 @@ Control::Control(char** arguments, Option& option_)
     , input_class_file_set(1021)
     , expired_file_set()
     , recompilation_file_set(1021)
+    , class_file_writer(NULL)
+    , jar_writer(NULL)
+    , watcher(NULL)
+    , profiler(NULL)
+    , dependence_database(NULL)
     // Type and method cache. These variables are assigned in control.h
     // accessors, but must be NULL at startup.
     , Annotation_type(NULL)
@@ -134,21 +158,37 @@ Control::Control(char** arguments, Option& option_)
     , float_pool(&bad_value)
     , double_pool(&bad_value)
     , Utf8_pool(&bad_value)
-#ifdef JOPA_DEBUG
     , input_files_processed(0)
     , class_files_read(0)
+    , zip_class_files_read(0)
     , class_files_written(0)
+    , class_files_unchanged(0)
     , line_count(0)
-#endif // JOPA_DEBUG
     // Package cache.  unnamed and lang are initialized in constructor body.
     , annotation_package(NULL)
     , io_package(NULL)
     , util_package(NULL)
+    , zip_prefetcher(NULL)
 {
+    //
+    // The hash tables of the members above are already there; they are not
+    // accounted for, but whatever they grow by is.
+    //
+    if (option.memory || option.memory_name)
+        MemoryAccount::Start();
+    if (option.profile || option.trace_name || option.memory ||
+        option.memory_name)
+    {
+        profiler = new Profiler(option.trace_name != NULL);
+    }
+
     ProcessGlobals();
     ProcessUnnamedPackage();
-    ProcessPath();
-    ProcessSystemInformation();
+    {
+        Profiler::Phase phase(profiler, Profiler::STARTUP);
+        ProcessPath();
+        ProcessSystemInformation();
+    }
 
     //
     // Instantiate a scanner and a parser and initialize the static members
@@ -157,12 +197,53 @@ Control::Control(char** arguments, Option& option_)
     scanner = new Scanner(*this);
     parser = new Parser();
     SemanticError::StaticInitializer();
+}
+
+
+void Control::Compile(char** arguments)
+{
+    //
+    // With -j, class files are serialized and written on worker threads;
+    // but the entries of an archive are added in the order the classes are
+    // generated in, so that it comes out the same every time, and only
+    // deflated on worker threads.
+    //
+    if (option.bytecode && ! option.nowrite)
+    {
+        unsigned num_threads = option.Threads(1);
+        if (option.jar_name)
+        {
+            jar_writer = new JarWriter(option.jar_name, option.jar_level,
+                                       num_threads);
+        }
+        else if (num_threads > 1)
+            class_file_writer = new ClassFileWriter(*this, num_threads);
+    }
+
+    if (option.watch)
+    {
+        watcher = new SourceWatcher();
+        watcher -> StartCycle();
+    }
 
     //
     // Process all file names specified in command line
     //
     ProcessNewInputFiles(input_java_file_set, arguments);
 
+    //
+    // With --incremental-db, drop the input files that need not be compiled
+    // again, and add those that do.
+    //
+    if (option.incremental_db && option.bytecode && ! option.nowrite &&
+        ! option.parse_only)
+    {
+        dependence_database =
+            new DependenceDatabase(option.incremental_db,
+                                   option.options_hash);
+        SelectChangedInputFiles();
+    }
+
     //
     // For each input file, copy it into the input_files array and process
     // its package declaration. Estimate we need 64 tokens.
@@ -176,18 +257,67 @@ Control::Control(char** arguments, Option& option_)
          file_symbol = (FileSymbol*) input_java_file_set.NextElement())
     {
         input_files[num_files++] = file_symbol;
-#ifdef JOPA_DEBUG
-        input_files_processed++;
-#endif
+    }
+
+    //
+    // With --parallel-headers, the files are scanned and header-parsed on
+    // worker threads ahead of this loop; see Prescanner.
+    //
+    Prescanner* prescanner = NULL;
+    if (option.parallel_headers && ! option.parse_only &&
+        option.keyword_map.Length() == 0 && num_files > 1)
+    {
+        unsigned num_threads =
+            option.Threads(std::thread::hardware_concurrency());
+        if (num_threads > 1)
+            prescanner = new Prescanner(*this, input_files, num_files,
+                                        num_threads);
+    }
+
+    //
+    // With --lazy-scan, the stream of each file is dropped once its package
+    // declaration is processed, and the file is scanned again when
+    // ProcessHeaders gets to it, so that the streams of all the files are
+    // not held at once. Each file is then read and scanned twice.
+    //
+    bool lazy_scan = option.lazy_scan && ! prescanner &&
+        ! option.parse_only && num_files > 1;
+
+    for (int k = 0; k < num_files; k++)
+    {
+        file_symbol = input_files[k];
         errno = 0;
-        scanner -> Scan(file_symbol);
+        {
+            Profiler::Phase phase(profiler, Profiler::SCAN, file_symbol);
+            if (prescanner)
+                prescanner -> Finish(k, *scanner);
+            else if (lazy_scan)
+                scanner -> ScanPackage(file_symbol);
+            else scanner -> Scan(file_symbol);
+        }
         if (file_symbol -> lex_stream) // did we have a successful scan!
         {
+            Profiler::Phase phase(profiler, Profiler::PARSE, file_symbol);
+            //
+            // A prescanned file already has its headers; fall back on the
+            // package-only parse when they are broken, since the package
+            // declaration may well be fine.
+            //
+            AstCompilationUnit* compilation_unit =
+                file_symbol -> compilation_unit;
             AstPackageDeclaration* package_declaration =
-                parser -> PackageHeaderParse(file_symbol -> lex_stream,
-                                             ast_pool);
+                (compilation_unit &&
+                 ! compilation_unit -> BadCompilationUnitCast()
+                 ? compilation_unit -> package_declaration_opt
+                 : parser -> PackageHeaderParse(file_symbol -> lex_stream,
+                                                ast_pool));
             ProcessPackageDeclaration(file_symbol, package_declaration);
             ast_pool -> Reset();
+            if (lazy_scan)
+            {
+                delete file_symbol -> lex_stream;
+                file_symbol -> lex_stream = NULL;
+            }
         }
         else
         {
@@ -198,6 +328,7 @@ Control::Control(char** arguments, Option& option_)
             general_io_errors.Next() = err_str.SafeArray();
         }
     }
+    delete prescanner;
 
     //
     // Handle parse-only mode
@@ -326,6 +457,10 @@ Control::Control(char** arguments, Option& option_)
                                           general_io_errors[i]);
         delete [] general_io_errors[i];
     }
+    bad_dirnames.Reset();
+    bad_zip_filenames.Reset();
+    general_io_warnings.Reset();
+    general_io_errors.Reset();
 
     //
     // Require the existence of java.lang.
@@ -374,6 +509,8 @@ Control::Control(char** arguments, Option& option_)
             }
         }
     }
+    else if (jar_writer && ! jar_writer -> IsValid())
+        ReportJarWriteError();
 
     //
     //
@@ -420,6 +557,7 @@ Control::Control(char** arguments, Option& option_)
         // Clean up all the files that have just been compiled in this new
         // batch.
         //
+        CleanUpFinishedFiles(true);
         FileSymbol* file_symbol;
         for (file_symbol = (FileSymbol*) input_java_file_set.FirstElement();
              file_symbol;
@@ -428,6 +566,19 @@ Control::Control(char** arguments, Option& option_)
             CleanUp(file_symbol);
         }
 
+        //
+        // With -d out.jar, all the class files are in the archive by now.
+        // After an error, the archive would be missing the classes that
+        // could not be compiled, so the one there is (if any) is kept.
+        //
+        if (jar_writer)
+        {
+            if (return_code || system_semantic -> return_code > 0)
+                jar_writer -> Abandon();
+            else if (! jar_writer -> Close())
+                ReportJarWriteError();
+        }
+
         //
         // If more messages were added to system_semantic, print them...
         //
@@ -439,9 +590,15 @@ Control::Control(char** arguments, Option& option_)
             return_code = 1;
         }
 
+        if (watcher)
+        {
+            WatchSourceDirectories();
+            watcher -> Report(input_files, num_files, return_code);
+        }
+
         //
         // If the incremental flag is on, check to see if the user wants us
-        // to recompile.
+        // to recompile (or, with --watch, wait for a reason to).
         //
         if (option.incremental)
         {
@@ -531,6 +688,7 @@ Control::Control(char** arguments, Option& option_)
                 // Clean up all the files that have just been compiled in
                 // this new batch.
                 //
+                CleanUpFinishedFiles(true);
                 for (file_symbol = (FileSymbol*) input_java_file_set.FirstElement();
                     // delete file_symbol
                      file_symbol;
@@ -550,6 +708,12 @@ Control::Control(char** arguments, Option& option_)
                 {
                     return_code = 1;
                 }
+
+                if (watcher)
+                {
+                    WatchSourceDirectories();
+                    watcher -> Report(input_files, num_files, return_code);
+                }
             }
         }
 
@@ -662,6 +826,32 @@ Control::Control(char** arguments, Option& option_)
         }
     }
 
+    if (dependence_database && ! dependence_database -> Save())
+    {
+        Coutput << "*** Cannot write dependence database "
+                << option.incremental_db << endl;
+    }
+
+    if (option.profile)
+    {
+        profiler -> Report(option.profile_name, input_files_processed,
+                           line_count, class_files_read - zip_class_files_read,
+                           zip_class_files_read, class_files_written,
+                           class_files_unchanged);
+    }
+    if (option.skip_unchanged && option.verbose)
+    {
+        Coutput << "[" << class_files_unchanged
+                << " unchanged class files not rewritten]" << endl;
+    }
+    if (option.trace_name && ! profiler -> WriteTrace(option.trace_name))
+    {
+        Coutput << "*** Cannot write trace file " << option.trace_name
+                << endl;
+    }
+    if (option.memory || option.memory_name)
+        MemoryAccount::Report(option.memory, option.memory_name);
+
     delete ast_pool;
     delete main_file_clone; // delete the clone of the main source file...
     delete [] input_files;
@@ -670,9 +860,22 @@ Control::Control(char** arguments, Option& option_)
 
 Control::~Control()
 {
+    delete class_file_writer;
+    delete jar_writer;
+    delete watcher;
+    delete profiler;
+    MemoryAccount::Stop();
+    delete dependence_database;
+
     unsigned i;
+    for (i = 0; i < bad_dirnames.Length(); i++)
+        delete [] bad_dirnames[i];
     for (i = 0; i < bad_zip_filenames.Length(); i++)
         delete [] bad_zip_filenames[i];
+    for (i = 0; i < general_io_warnings.Length(); i++)
+        delete [] general_io_warnings[i];
+    for (i = 0; i < general_io_errors.Length(); i++)
+        delete [] general_io_errors[i];
     for (i = 0; i < bad_input_filenames.Length(); i++)
         delete [] bad_input_filenames[i];
     for (i = 0; i < unreadable_input_filenames.Length(); i++)
@@ -909,6 +1112,22 @@ DirectorySymbol* Control::ProcessSubdirectories(wchar_t* source_name,
 #endif
 
 
+//
+// Report that the archive named by -d could not be written.
+//
+void Control::ReportJarWriteError()
+{
+    int length = strlen(option.jar_name);
+    wchar_t* name = new wchar_t[length + 1];
+    for (int j = 0; j < length; j++)
+        name[j] = option.jar_name[j];
+    name[length] = U_NULL;
+    system_semantic -> ReportSemError(SemanticError::CANNOT_WRITE_FILE,
+                                      BAD_TOKEN, name);
+    delete [] name;
+}
+
+
 void Control::ProcessNewInputFiles(SymbolSet& file_set, char** arguments)
 {
     unsigned i;
@@ -926,42 +1145,83 @@ void Control::ProcessNewInputFiles(SymbolSet& file_set, char** arguments)
     //
     if (arguments)
     {
-        int j = 0;
-        while (arguments[j])
+        for (int j = 0; arguments[j]; j++)
+            ProcessNewInputFile(file_set, arguments[j]);
+    }
+}
+
+
+void Control::ProcessNewInputFile(SymbolSet& file_set, char* file_name)
+{
+    unsigned file_name_length = strlen(file_name);
+
+    wchar_t* name = new wchar_t[file_name_length + 1];
+    for (unsigned i = 0; i < file_name_length; i++)
+        name[i] = (file_name[i] != U_BACKSLASH ? file_name[i]
+                   : (wchar_t) U_SLASH); // Change '\' to '/'.
+    name[file_name_length] = U_NULL;
+
+    //
+    // A zip or jar file stands for the .java files in it. Option has put it
+    // on the sourcepath, so it is read by now (and reported, if it could
+    // not be).
+    //
+    if (Option::IsZipFileName(file_name))
+    {
+        PathSymbol* path_symbol = classpath_table.
+            FindPathSymbol(FindOrInsertName(name, file_name_length));
+        if (! path_symbol || ! path_symbol -> IsZip())
+            unreadable_input_filenames.Next() = name;
+        else
         {
-            char* file_name = arguments[j++];
-            unsigned file_name_length = strlen(file_name);
+            delete [] name;
+            ProcessZipInputFiles(file_set, path_symbol -> RootDirectory());
+        }
+    }
+    //
+    // File must be of the form xxx.java where xxx is a
+    // character string consisting of at least one character.
+    //
+    else if (file_name_length < FileSymbol::java_suffix_length ||
+        (! FileSymbol::IsJavaSuffix(&file_name[file_name_length - FileSymbol::java_suffix_length])))
+    {
+        bad_input_filenames.Next() = name;
+    }
+    else
+    {
+        FileSymbol* file_symbol =
+            FindOrInsertJavaInputFile(name,
+                                      file_name_length - FileSymbol::java_suffix_length);
 
-            wchar_t* name = new wchar_t[file_name_length + 1];
-            for (unsigned i = 0; i < file_name_length; i++)
-                name[i] = (file_name[i] != U_BACKSLASH ? file_name[i]
-                           : (wchar_t) U_SLASH); // Change '\' to '/'.
-            name[file_name_length] = U_NULL;
+        if (! file_symbol)
+            unreadable_input_filenames.Next() = name;
+        else
+        {
+            delete [] name;
+            file_set.AddElement(file_symbol);
+        }
+    }
+}
 
-            //
-            // File must be of the form xxx.java where xxx is a
-            // character string consisting of at least one character.
-            //
-            if (file_name_length < FileSymbol::java_suffix_length ||
-                (! FileSymbol::IsJavaSuffix(&file_name[file_name_length - FileSymbol::java_suffix_length])))
-            {
-                bad_input_filenames.Next() = name;
-            }
-            else
-            {
-                FileSymbol* file_symbol =
-                    FindOrInsertJavaInputFile(name,
-                                              file_name_length - FileSymbol::java_suffix_length);
 
-                if (! file_symbol)
-                    unreadable_input_filenames.Next() = name;
-                else
-                {
-                    delete [] name;
-                    file_set.AddElement(file_symbol);
-                }
-            }
+//
+// Add the .java files of a zip file directory, and of its subdirectories, to
+// the input files.
+//
+void Control::ProcessZipInputFiles(SymbolSet& file_set,
+                                   DirectorySymbol* directory_symbol)
+{
+    for (unsigned i = 0; i < directory_symbol -> NumOtherSymbols(); i++)
+    {
+        Symbol* symbol = directory_symbol -> OtherSym(i);
+        FileSymbol* file_symbol = symbol -> FileCast();
+        if (file_symbol)
+        {
+            if (file_symbol -> IsJava())
+                file_set.AddElement(file_symbol);
         }
+        else if (symbol -> DirectoryCast())
+            ProcessZipInputFiles(file_set, symbol -> DirectoryCast());
     }
 }
 
@@ -990,7 +1250,7 @@ FileSymbol* Control::FindOrInsertJavaInputFile(DirectorySymbol* directory_symbol
             file_symbol -> SetJava();
         }
 
-        file_symbol -> mtime = entry -> Mtime();
+        file_symbol -> DeferMtime();
     }
 
     delete [] java_name;
@@ -1107,6 +1367,7 @@ void Control::ProcessHeaders(FileSymbol* file_symbol)
     if (file_symbol -> semantic)
         return;
     input_java_file_set.AddElement(file_symbol);
+    input_files_processed++;
 
     bool initial_invocation = (semantic.Length() == 0);
 
@@ -1118,13 +1379,17 @@ void Control::ProcessHeaders(FileSymbol* file_symbol)
     }
 
     if (! file_symbol -> lex_stream)
-         scanner -> Scan(file_symbol);
+    {
+        Profiler::Phase phase(profiler, Profiler::SCAN, file_symbol);
+        scanner -> Scan(file_symbol);
+    }
     else file_symbol -> lex_stream -> Reset();
 
     if (file_symbol -> lex_stream) // do we have a successful scan!
     {
         if (! file_symbol -> compilation_unit)
         {
+            Profiler::Phase phase(profiler, Profiler::PARSE, file_symbol);
             file_symbol -> compilation_unit =
                 parser -> HeaderParse(file_symbol -> lex_stream);
             // Register ast_pool for cleanup when Control is destroyed
@@ -1143,6 +1408,7 @@ void Control::ProcessHeaders(FileSymbol* file_symbol)
                                           file_symbol -> compilation_unit -> package_declaration_opt);
             file_symbol -> semantic = new Semantic(*this, file_symbol);
             semantic.Next() = file_symbol -> semantic;
+            Profiler::Phase phase(profiler, Profiler::TYPE_HEADERS, file_symbol);
             file_symbol -> semantic -> ProcessTypeNames();
         }
     }
@@ -1182,6 +1448,8 @@ void Control::ProcessMembers()
             {
                 TypeSymbol* type = partially_ordered_types[j];
                 needs_member_work.AddElement(type);
+                Profiler::Phase phase(profiler, Profiler::TYPE_HEADERS,
+                                      type -> file_symbol);
                 type -> ProcessTypeHeaders();
                 type -> semantic_environment -> sem ->
                     types_to_be_processed.AddElement(type);
@@ -1199,6 +1467,8 @@ void Control::ProcessMembers()
         {
             TypeSymbol* type = partially_ordered_types[i];
             needs_body_work.Next() = type;
+            Profiler::Phase phase(profiler, Profiler::MEMBERS,
+                                  type -> file_symbol);
             type -> ProcessMembers();
         }
     }
@@ -1239,6 +1509,8 @@ void Control::CollectTypes(TypeSymbol* type, Tuple<TypeSymbol*>& types)
 void Control::ProcessBodies(TypeSymbol* type)
 {
     Semantic* sem = type -> semantic_environment -> sem;
+    Profiler::Phase phase(profiler, Profiler::BODIES,
+                          sem -> source_file_symbol);
 
     if (type -> declaration &&
         ! sem -> compilation_unit -> BadCompilationUnitCast())
@@ -1246,8 +1518,13 @@ void Control::ProcessBodies(TypeSymbol* type)
 
         if (type -> declaration -> UnparsedClassBodyCast())
         {
-            if (! parser -> InitializerParse(sem -> lex_stream,
-                                             type -> declaration))
+            bool parsed;
+            {
+                Profiler::Phase phase(profiler, Profiler::PARSE);
+                parsed = parser -> InitializerParse(sem -> lex_stream,
+                                                    type -> declaration);
+            }
+            if (! parsed)
             {
                 // Mark that syntax errors were detected.
                 sem -> compilation_unit -> MarkBad();
@@ -1255,7 +1532,12 @@ void Control::ProcessBodies(TypeSymbol* type)
             else
             {
                 type -> CompleteSymbolTable();
-                if (! parser -> BodyParse(sem -> lex_stream, type -> declaration))
+                {
+                    Profiler::Phase phase(profiler, Profiler::PARSE);
+                    parsed = parser -> BodyParse(sem -> lex_stream,
+                                                 type -> declaration);
+                }
+                if (! parsed)
                 {
                     // Mark that syntax errors were detected.
                     sem -> compilation_unit -> MarkBad();
@@ -1285,11 +1567,15 @@ void Control::ProcessBodies(TypeSymbol* type)
                 for (unsigned k = 0; k < types -> Length(); k++)
                 {
                     TypeSymbol* type = (*types)[k];
+                    Profiler::Phase phase(profiler, Profiler::CODEGEN, NULL,
+                                          type -> fully_qualified_name -> value);
                     // Make sure the literal is available for bytecode.
                     type -> file_symbol -> SetFileNameLiteral(this);
                     ByteCode* code = new ByteCode(type);
                     code -> GenerateCode();
-                    delete code;
+                    if (code -> WriteDeferred())
+                        class_file_writer -> Submit(code, type);
+                    else delete code;
                 }
             }
 
@@ -1331,8 +1617,33 @@ void Control::ProcessBodies(TypeSymbol* type)
         CheckForUnusedImports(sem);
         if (! option.nocleanup)
         {
-            CleanUp(sem -> source_file_symbol);
+            if (class_file_writer)
+            {
+                finished_files.push_back(sem -> source_file_symbol);
+                CleanUpFinishedFiles(false);
+            }
+            else CleanUp(sem -> source_file_symbol);
+        }
+    }
+}
+
+
+//
+// Clean up the files in finished_files, oldest first, stopping at the first
+// one whose class files are still being written unless wait is set.
+//
+void Control::CleanUpFinishedFiles(bool wait)
+{
+    while (! finished_files.empty())
+    {
+        FileSymbol* file_symbol = finished_files.front();
+        if (file_symbol -> semantic &&
+            ! class_file_writer -> Collect(file_symbol -> semantic, wait))
+        {
+            break;
         }
+        finished_files.pop_front();
+        CleanUp(file_symbol);
     }
 }
 
@@ -1413,7 +1724,8 @@ void Control::ProcessPackageDeclaration(FileSymbol* file_symbol,
     // For a file in package com.sun.tools.javah at path /foo/com/sun/tools/javah/X.java,
     // the source root is /foo/ which should be registered with unnamed_package.
     //
-    if (package_declaration && file_symbol -> directory_symbol)
+    if (package_declaration && file_symbol -> directory_symbol &&
+        ! file_symbol -> IsZip())
     {
         DirectorySymbol* dir = file_symbol -> directory_symbol;
         const char* dir_name = dir -> DirectoryName();
@@ -1537,9 +1849,13 @@ void Control::CleanUp(FileSymbol* file_symbol)
                                                "unparsed/");
         }
 #endif // JOPA_DEBUG
+        if (class_file_writer)
+            class_file_writer -> Collect(sem, true);
         sem -> PrintMessages();
         if (sem -> return_code > 0)
             return_code = 1;
+        if (dependence_database)
+            dependence_database -> Compiled(file_symbol, sem -> return_code == 0);
 
         //
         // For successful compilations, delete the AST pool early to reduce
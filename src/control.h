@@ -5,6 +5,7 @@
 #include "tuple.h"
 #include "set.h"
 
+#include <deque>
 #include <vector>
 #include <unordered_set>
 
@@ -19,6 +20,12 @@ class LexStream;
 class AstPackageDeclaration;
 class AstName;
 class TypeDependenceChecker;
+class ClassFileWriter;
+class JarWriter;
+class ZipPrefetcher;
+class SourceWatcher;
+class DependenceDatabase;
+class Profiler;
 
 //
 // This class represents the control information common across all compilation
@@ -60,6 +67,31 @@ public:
     Parser* parser;
     Scanner* scanner;
 
+    //
+    // Non-NULL when class files are written on worker threads (-j).
+    //
+    ClassFileWriter* class_file_writer;
+
+    //
+    // Non-NULL when class files are written to an archive (-d out.jar).
+    //
+    JarWriter* jar_writer;
+
+    //
+    // Non-NULL in watch mode (--watch); see IncrementalRecompilation.
+    //
+    SourceWatcher* watcher;
+
+    //
+    // Non-NULL with -Xprofile, --trace-out or -Xmemory; see profile.h.
+    //
+    Profiler* profiler;
+
+    //
+    // Non-NULL with --incremental-db; see SelectChangedInputFiles.
+    //
+    DependenceDatabase* dependence_database;
+
     //
     // Tables for hashing everything we've seen so far.
     //
@@ -389,13 +421,37 @@ public:                                                         \
     Control(char**, Option&);
     ~Control();
 
+    //
+    // The two halves of the constructor above, for a compile server (see
+    // server.h): a Control set up once with the options may be forked and
+    // used by Compile any number of times, provided that the system types
+    // it has read (if any, see PreloadSystemTypes) are not invalidated by
+    // ReloadPackages.
+    //
+    Control(Option&);
+    void Compile(char**);
+    bool PreloadSystemTypes();
+    bool ReloadPackages();
+
+    //
+    // With --incremental-db, whether the compilation left files out of
+    // date, which another one, with the same arguments, is to compile.
+    //
+    bool StaleDependents();
+
     Utf8LiteralValue* ConvertUnicodeToUtf8(const wchar_t* source)
     {
-        // Should be big enough for the worst case.
-        char* target = new char[wcslen(source) * 3 + 1];
+        //
+        // The pool keeps a copy, so the conversion only needs room for the
+        // worst case for as long as this runs; most names fit on the stack.
+        //
+        char buffer[256];
+        size_t size = wcslen(source) * 3 + 1;
+        char* target = size <= sizeof(buffer) ? buffer : new char[size];
         int length = ConvertUnicodeToUtf8(source, target);
         Utf8LiteralValue* literal = Utf8_pool.FindOrInsert(target, length);
-        delete [] target;
+        if (target != buffer)
+            delete [] target;
         return literal;
     }
 
@@ -417,8 +473,13 @@ public:                                                         \
     void RemoveTrashedTypes(SymbolSet&);
     void RereadDirectory(DirectorySymbol*);
     void RereadDirectories();
+    bool ReloadPackage(PackageSymbol*);
     void ComputeRecompilationSet(TypeDependenceChecker&);
+    void WatchDirectory(DirectorySymbol*);
+    void WatchSourceDirectories();
+    bool WaitForSourceChanges();
     bool IncrementalRecompilation();
+    void SelectChangedInputFiles();
 
     //
     // The one and only bad value constant.
@@ -431,9 +492,15 @@ public:                                                         \
     // A literal is converted during the semantic pass so that an
     // accurate diagnostic can be issued in case it is invalid.
     //
-    NameSymbol* FindOrInsertName(const wchar_t* name, int len)
+    template <typename Char> // wchar_t, or SourceChar in the input buffer
+    NameSymbol* FindOrInsertName(const Char* name, int len)
+    {
+        return FindOrInsertName(name, len, Hash::Function(name, len));
+    }
+    template <typename Char>
+    NameSymbol* FindOrInsertName(const Char* name, int len, unsigned hash)
     {
-        NameSymbol* name_symbol = name_table.FindOrInsertName(name, len);
+        NameSymbol* name_symbol = name_table.FindOrInsertName(name, len, hash);
         if (! name_symbol -> Utf8_literal)
             name_symbol -> Utf8_literal =
                 ConvertUnicodeToUtf8(name_symbol -> Name());
@@ -505,12 +572,12 @@ public:                                                         \
 
     void ProcessHeaders(FileSymbol*);
 
-#ifdef JOPA_DEBUG
     int input_files_processed,
         class_files_read,
+        zip_class_files_read,
         class_files_written,
+        class_files_unchanged, // left alone with --skip-unchanged
         line_count;
-#endif // JOPA_DEBUG
 
     PackageSymbol* ProcessPackage(const wchar_t*);
 
@@ -533,6 +600,13 @@ private:
     //
     std::unordered_set<StoragePool*> ast_pools_to_delete;
 
+    //
+    // Compilation units whose bodies are done but whose class files may
+    // still be in the hands of class_file_writer. They are cleaned up in
+    // this order, so that messages come out as they would in a serial run.
+    //
+    std::deque<FileSymbol*> finished_files;
+
     //
     // Cache of system packages. lang and unnamed are always valid, because of
     // ProcessUnnamedPackage and ProcessSystemInformation in system.cpp, the
@@ -545,12 +619,20 @@ private:
     PackageSymbol* util_package;
     PackageSymbol* unnamed_package;
 
+    //
+    // Non-NULL while ProcessPath runs, if the archives on the paths are
+    // read on worker threads; see PrefetchArchives.
+    //
+    ZipPrefetcher* zip_prefetcher;
+
     static int ConvertUnicodeToUtf8(const wchar_t*, char*);
     NameSymbol* FindOrInsertSystemName(const char* name);
 
     void ProcessGlobals();
     void ProcessUnnamedPackage();
     void ProcessPath();
+    void PrefetchArchives();
+    Zip* OpenZip(char*, bool source_only = false);
     void ProcessBootClassPath();
     void ProcessExtDirs();
     void ProcessClassPath();
@@ -566,8 +648,12 @@ private:
     void CollectTypes(TypeSymbol*, Tuple<TypeSymbol*>&);
     void ProcessBodies(TypeSymbol*);
     void CheckForUnusedImports(Semantic *);
+    void CleanUpFinishedFiles(bool);
+    void ReportJarWriteError();
 
     void ProcessNewInputFiles(SymbolSet&, char**);
+    void ProcessNewInputFile(SymbolSet&, char*);
+    void ProcessZipInputFiles(SymbolSet&, DirectorySymbol*);
 
     FileSymbol* FindOrInsertJavaInputFile(DirectorySymbol*, NameSymbol*);
     FileSymbol* FindOrInsertJavaInputFile(wchar_t*, int);
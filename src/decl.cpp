@@ -2446,6 +2446,31 @@ void Semantic::CheckForSerializationMistakes(AstClassBody* class_body)
 }
 
 
+//
+// Annotations are not otherwise resolved, but the @Retention and @Target of
+// the annotation types on a type's declaration decide how it is compiled.
+// Record a dependence on each one named by a simple name that denotes a
+// type, so that an incremental build recompiles the annotated type when the
+// annotation type changes. Names that denote nothing are left alone.
+//
+void Semantic::AddAnnotationDependences(AstClassBody* class_body)
+{
+    AstModifiers* modifiers = class_body -> owner
+        ? class_body -> owner -> modifiers_opt : NULL;
+    if (! modifiers)
+        return;
+    for (unsigned i = 0; i < modifiers -> NumModifiers(); i++)
+    {
+        AstAnnotation* annotation = modifiers -> Modifier(i) -> AnnotationCast();
+        if (! annotation || annotation -> name -> base_opt)
+            continue;
+        TypeSymbol* type = FindType(annotation -> name -> identifier_token);
+        if (type && type -> ACC_ANNOTATION())
+            AddDependence(ThisType(), type);
+    }
+}
+
+
 void Semantic::ProcessMembers(AstClassBody* class_body)
 {
     state_stack.Push(class_body -> semantic_environment);
@@ -2466,6 +2491,7 @@ void Semantic::ProcessMembers(AstClassBody* class_body)
         AddEnumSyntheticMethods(this_type);
 
     ProcessClassBodyForEffectiveJavaChecks(class_body);
+    AddAnnotationDependences(class_body);
 
     delete this_type -> innertypes_closure; // save some space !!!
     this_type -> innertypes_closure = NULL;
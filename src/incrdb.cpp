@@ -0,0 +1,418 @@
+#include "incrdb.h"
+#include "symbol.h"
+#include "set.h"
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+DependenceDatabase::DependenceDatabase(const char* file_name_,
+                                       u8 options_hash_)
+    : file_name(file_name_)
+    , options_hash(options_hash_)
+{}
+
+
+//
+// Hash the contents of a file (FNV-1a); returns false if it cannot be read.
+//
+bool DependenceDatabase::HashFile(const char* file_name, u8& hash)
+{
+    FILE* file = SystemFopen(file_name, "rb");
+    if (! file)
+        return false;
+
+    hash = 14695981039346656037ULL;
+    u1 buffer[64 * 1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ buffer[i]) * 1099511628211ULL;
+    }
+    bool success = ! ferror(file);
+    fclose(file);
+    return success;
+}
+
+
+static bool ReadLine(FILE* file, std::string& line)
+{
+    line.clear();
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), file))
+    {
+        line += buffer;
+        if (line[line.length() - 1] == '\n')
+        {
+            line.erase(line.length() - 1);
+            return true;
+        }
+    }
+    return ! line.empty();
+}
+
+
+bool DependenceDatabase::Load()
+{
+    entries.clear();
+    FILE* file = SystemFopen(file_name.c_str(), "r");
+    if (! file)
+        return false;
+
+    std::string line;
+    char header[64];
+    snprintf(header, sizeof(header), "jopa-deps 2 %016llx",
+             (unsigned long long) options_hash);
+    bool valid = ReadLine(file, line) && line == header;
+
+    Entry* entry = NULL;
+    while (valid && ReadLine(file, line))
+    {
+        if (line.length() < 2 || line[1] != ' ')
+        {
+            valid = false;
+            break;
+        }
+        std::string value(line, 2);
+        switch (line[0])
+        {
+        case 'F':
+            {
+                size_t space = value.find(' ');
+                if (space == std::string::npos)
+                {
+                    valid = false;
+                    break;
+                }
+                entry = &entries[value.substr(space + 1)];
+                entry -> ok = value[0] != '-';
+                entry -> hash = (entry -> ok
+                                 ? strtoull(value.c_str(), NULL, 16) : 0);
+            }
+            break;
+        case 'T':
+            {
+                size_t space = value.find(' ');
+                if (space == std::string::npos)
+                {
+                    valid = false;
+                    break;
+                }
+                if (entry)
+                    entry -> types[value.substr(space + 1)] =
+                        strtoull(value.c_str(), NULL, 16);
+            }
+            break;
+        case 'C':
+            if (entry)
+                entry -> class_files.push_back(value);
+            break;
+        case 'D':
+            if (entry)
+                entry -> parents.push_back(value);
+            break;
+        case 'S':
+            if (entry)
+                entry -> static_parents.push_back(value);
+            break;
+        default:
+            valid = false;
+        }
+        valid = valid && entry;
+    }
+    fclose(file);
+
+    if (! valid)
+        entries.clear();
+    return valid;
+}
+
+
+bool DependenceDatabase::Analyze(const std::vector<std::string>& input_files,
+                                 bool closure)
+{
+    recompile.clear();
+    dependents.clear();
+    if (! Load())
+    {
+        recompile.insert(input_files.begin(), input_files.end());
+        return false;
+    }
+
+    std::map<std::string, Entry>::iterator entry;
+    for (entry = entries.begin(); entry != entries.end(); entry++)
+    {
+        const Entry& e = entry -> second;
+        for (unsigned i = 0; i < e.parents.size(); i++)
+            users[e.parents[i]].push_back(entry -> first);
+        for (unsigned i = 0; i < e.static_parents.size(); i++)
+            users[e.static_parents[i]].push_back(entry -> first);
+    }
+
+    //
+    // Find the files that changed, and the types declared in those that
+    // were deleted.
+    //
+    std::set<std::string> changed_types;
+    std::vector<std::string> removed;
+    for (entry = entries.begin(); entry != entries.end(); entry++)
+    {
+        const Entry& e = entry -> second;
+        u8 hash;
+        bool changed;
+        if (! HashFile(entry -> first.c_str(), hash))
+        {
+            removed.push_back(entry -> first);
+            changed = true;
+        }
+        else
+        {
+            hashes[entry -> first] = hash;
+            changed = ! e.ok || hash != e.hash;
+            struct stat status;
+            for (unsigned i = 0; i < e.class_files.size() && ! changed; i++)
+                changed = SystemStat(e.class_files[i].c_str(), &status) != 0;
+            if (changed)
+                recompile.insert(entry -> first);
+        }
+        if (changed && (closure || hashes.find(entry -> first) == hashes.end()))
+        {
+            std::map<std::string, u8>::const_iterator type;
+            for (type = e.types.begin(); type != e.types.end(); type++)
+                changed_types.insert(type -> first);
+        }
+    }
+
+    for (unsigned i = 0; i < input_files.size(); i++)
+    {
+        if (entries.find(input_files[i]) == entries.end())
+            recompile.insert(input_files[i]);
+    }
+
+    //
+    // Add the files depending on a type that is gone. Whether a type that
+    // changed is different for its dependents only shows once it has been
+    // compiled, in Compiled; unless closure is set, in which case the files
+    // depending on it are added now, and those depending on their types in
+    // turn, and so on.
+    //
+    std::vector<std::string> work(changed_types.begin(),
+                                  changed_types.end());
+    while (! work.empty())
+    {
+        std::string type = work.back();
+        work.pop_back();
+
+        std::vector<std::string>& files = users[type];
+        for (unsigned i = 0; i < files.size(); i++)
+        {
+            const std::string& file = files[i];
+            if (hashes.find(file) == hashes.end() || // removed
+                ! recompile.insert(file).second || ! closure)
+            {
+                continue;
+            }
+            const Entry& e = entries[file];
+            std::map<std::string, u8>::const_iterator type;
+            for (type = e.types.begin(); type != e.types.end(); type++)
+            {
+                if (changed_types.insert(type -> first).second)
+                    work.push_back(type -> first);
+            }
+        }
+    }
+
+    //
+    // Forget the files that were deleted, and their class files.
+    //
+    for (unsigned i = 0; i < removed.size(); i++)
+    {
+        Entry& e = entries[removed[i]];
+        for (unsigned k = 0; k < e.class_files.size(); k++)
+            remove(e.class_files[k].c_str());
+        entries.erase(removed[i]);
+    }
+
+    std::set<std::string> inputs(input_files.begin(), input_files.end());
+    std::set<std::string>::iterator file;
+    for (file = recompile.begin(); file != recompile.end(); file++)
+    {
+        if (inputs.find(*file) == inputs.end())
+            dependents.push_back(*file);
+    }
+    return true;
+}
+
+
+//
+// Whether a dependence on type is worth recording for file_symbol.
+//
+static bool Tracked(TypeSymbol* type, FileSymbol* file_symbol)
+{
+    return type -> file_symbol && type -> file_symbol != file_symbol &&
+        ! type -> file_symbol -> IsZip();
+}
+
+
+void DependenceDatabase::Compiled(FileSymbol* file_symbol, bool ok)
+{
+    std::string name(file_symbol -> FileName());
+    Entry entry;
+    entry.ok = ok;
+    std::map<std::string, u8>::iterator hash = hashes.find(name);
+    if (hash != hashes.end())
+        entry.hash = hash -> second;
+    else if (! HashFile(name.c_str(), entry.hash))
+        entry.ok = false;
+
+    std::set<std::string> parents;
+    std::set<std::string> static_parents;
+    for (unsigned i = 0; i < file_symbol -> types.Length(); i++)
+    {
+        TypeSymbol* type = file_symbol -> types[i];
+        entry.types[type -> fully_qualified_name -> value] =
+            type -> abi_fingerprint;
+        if (ok)
+            entry.class_files.push_back(type -> ClassName());
+
+        TypeSymbol* parent;
+        for (parent = (TypeSymbol*) type -> parents -> FirstElement();
+             parent;
+             parent = (TypeSymbol*) type -> parents -> NextElement())
+        {
+            if (Tracked(parent, file_symbol))
+                parents.insert(parent -> fully_qualified_name -> value);
+        }
+        for (parent = (TypeSymbol*) type -> static_parents -> FirstElement();
+             parent;
+             parent = (TypeSymbol*) type -> static_parents -> NextElement())
+        {
+            if (Tracked(parent, file_symbol))
+                static_parents.insert(parent -> fully_qualified_name -> value);
+        }
+    }
+    entry.parents.assign(parents.begin(), parents.end());
+    entry.static_parents.assign(static_parents.begin(), static_parents.end());
+
+    //
+    // A file that failed to compile keeps the class files it had, which are
+    // still to be replaced, and the fingerprints of their types; one that
+    // compiled leaves behind those of the types it no longer declares.
+    //
+    std::map<std::string, Entry>::iterator old = entries.find(name);
+    std::map<std::string, u8> old_types;
+    if (old != entries.end())
+    {
+        old_types = old -> second.types;
+        if (! ok)
+        {
+            entry.types = old_types;
+            entry.class_files = old -> second.class_files;
+        }
+        else
+        {
+            std::set<std::string> class_files(entry.class_files.begin(),
+                                              entry.class_files.end());
+            for (unsigned i = 0; i < old -> second.class_files.size(); i++)
+            {
+                const std::string& class_file = old -> second.class_files[i];
+                if (class_files.find(class_file) == class_files.end())
+                    remove(class_file.c_str());
+            }
+        }
+    }
+    entries[name] = entry;
+    compiled.insert(name);
+    stale.erase(name);
+
+    //
+    // The files that depend on a type whose fingerprint changed (or that is
+    // gone), and that were not compiled along with it, are now out of date:
+    // they are marked as having failed, so that the next compilation (see
+    // Stale) takes them up.
+    //
+    if (! ok)
+        return;
+    std::set<std::string> changed_types;
+    std::map<std::string, u8>::iterator type;
+    for (type = old_types.begin(); type != old_types.end(); type++)
+    {
+        std::map<std::string, u8>::iterator new_type =
+            entry.types.find(type -> first);
+        if (new_type == entry.types.end() ||
+            new_type -> second != type -> second)
+        {
+            changed_types.insert(type -> first);
+        }
+    }
+    for (type = entry.types.begin(); type != entry.types.end(); type++)
+    {
+        if (old_types.find(type -> first) == old_types.end())
+            changed_types.insert(type -> first);
+    }
+
+    std::set<std::string>::iterator changed_type;
+    for (changed_type = changed_types.begin();
+         changed_type != changed_types.end(); changed_type++)
+    {
+        std::vector<std::string>& files = users[*changed_type];
+        for (unsigned i = 0; i < files.size(); i++)
+        {
+            std::map<std::string, Entry>::iterator user =
+                entries.find(files[i]);
+            if (user != entries.end() &&
+                compiled.find(files[i]) == compiled.end())
+            {
+                user -> second.ok = false;
+                stale.insert(files[i]);
+            }
+        }
+    }
+}
+
+
+bool DependenceDatabase::Save()
+{
+    std::string temporary_name = file_name + ".tmp";
+    FILE* file = SystemFopen(temporary_name.c_str(), "w");
+    if (! file)
+        return false;
+
+    fprintf(file, "jopa-deps 2 %016llx\n", (unsigned long long) options_hash);
+    std::map<std::string, Entry>::iterator entry;
+    for (entry = entries.begin(); entry != entries.end(); entry++)
+    {
+        const Entry& e = entry -> second;
+        if (e.ok)
+        {
+            fprintf(file, "F %016llx %s\n", (unsigned long long) e.hash,
+                    entry -> first.c_str());
+        }
+        else fprintf(file, "F - %s\n", entry -> first.c_str());
+        std::map<std::string, u8>::const_iterator type;
+        for (type = e.types.begin(); type != e.types.end(); type++)
+        {
+            fprintf(file, "T %016llx %s\n",
+                    (unsigned long long) type -> second, type -> first.c_str());
+        }
+        for (unsigned i = 0; i < e.class_files.size(); i++)
+            fprintf(file, "C %s\n", e.class_files[i].c_str());
+        for (unsigned i = 0; i < e.parents.size(); i++)
+            fprintf(file, "D %s\n", e.parents[i].c_str());
+        for (unsigned i = 0; i < e.static_parents.size(); i++)
+            fprintf(file, "S %s\n", e.static_parents[i].c_str());
+    }
+
+    bool success = ! ferror(file);
+    success = fclose(file) == 0 && success;
+    if (success)
+        success = rename(temporary_name.c_str(), file_name.c_str()) == 0;
+    if (! success)
+        remove(temporary_name.c_str());
+    return success;
+}
+
+
+} // Close namespace Jopa block
+
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "platform.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class FileSymbol;
+
+
+//
+// The dependence database of --incremental-db, which carries what ++ knows
+// about a compilation over to the next invocation of jopa. For each source
+// file compiled, it records a hash of its contents, the types it declares
+// (with their class files), and the types those depend on: their parents
+// and static_parents, as collected by Semantic::AddDependence, less the
+// types from zip files, which are not expected to change.
+//
+// The next compilation with the same options then compiles only the input
+// files that are new, that changed or failed to compile, or whose class
+// files are gone, and the files that depend on a type declared in a file
+// that was deleted. The types of the other files are read from their class
+// files.
+//
+// Whether the dependents of a file that changed need to be compiled as well
+// depends on whether the change shows from outside. So each type also has
+// an ABI fingerprint (see ClassFile::AbiFingerprint), which covers its
+// signatures and constant values but not its code; when that of a type is
+// different after its compilation, the files depending on it that were not
+// compiled along with it are marked as failed, and Stale tells that another
+// compilation is due, which takes them up, against the new class files. An
+// edit to the body of a method thus only recompiles its own file.
+//
+// The database is a text file, with a line per item:
+//
+//   jopa-deps 2 <options hash>
+//   F <hash, or - if it did not compile> <source file>
+//   T <ABI fingerprint> <type declared in the file>
+//   C <class file of the type>
+//   D <type a type of the file depends on>
+//   S <type a type of the file depends on for a constant>
+//
+class DependenceDatabase
+{
+public:
+    DependenceDatabase(const char* file_name, u8 options_hash);
+
+    //
+    // Decide which of the input files (given by FileName) are to be
+    // compiled. Returns false if there is no usable database, in which
+    // case all of them are. With closure, the files that depend on a file
+    // to be compiled are added right away, fingerprints or not, as ++ does
+    // not get to run another compilation.
+    //
+    bool Analyze(const std::vector<std::string>& input_files, bool closure);
+
+    bool Recompile(const char* file_name)
+    {
+        return recompile.find(file_name) != recompile.end();
+    }
+
+    //
+    // The files to be compiled that are not input files themselves.
+    //
+    const std::vector<std::string>& Dependents() { return dependents; }
+
+    //
+    // Record file_symbol, whose compilation is over, and was free of errors
+    // if ok.
+    //
+    void Compiled(FileSymbol* file_symbol, bool ok);
+
+    //
+    // Whether files that were not compiled are out of date, now that the
+    // fingerprint of a type they depend on changed.
+    //
+    bool Stale() { return ! stale.empty(); }
+
+    bool Save();
+
+private:
+    struct Entry
+    {
+        bool ok;
+        u8 hash;
+        std::map<std::string, u8> types; // with their ABI fingerprints
+        std::vector<std::string> class_files;
+        std::vector<std::string> parents;
+        std::vector<std::string> static_parents;
+    };
+
+    std::string file_name;
+    u8 options_hash;
+    std::map<std::string, Entry> entries; // by source file name
+    std::map<std::string, u8> hashes;     // computed by Analyze
+    std::set<std::string> recompile;
+    std::vector<std::string> dependents;
+    std::map<std::string, std::vector<std::string> > users; // by type
+    std::set<std::string> compiled;
+    std::set<std::string> stale;
+
+    bool Load();
+    static bool HashFile(const char* file_name, u8& hash);
+};
+
+
+} // Close namespace Jopa block
+
@@ -4,7 +4,11 @@
 #include "parser.h"
 #include "semantic.h"
 #include "case.h"
+#include "option.h"
+#include "profile.h"
 #include "set.h"
+#include "incrdb.h"
+#include "watch.h"
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -125,10 +129,10 @@ void Control::FindMoreRecentInputFiles(SymbolSet& file_candidates)
                 if (file_symbol -> IsJava())
                     expired_file_set.AddElement(file_symbol);
             }
-            else if (java_entry -> Mtime() > file_symbol -> mtime)
+            else if (java_entry -> Mtime() > file_symbol -> Mtime())
             {
                 // A newer file was found.
-                file_symbol -> mtime = java_entry -> Mtime();
+                file_symbol -> SetMtime(java_entry -> Mtime());
                 recompilation_file_set.AddElement(file_symbol);
             }
         }
@@ -157,6 +161,51 @@ void Control::RereadDirectories()
 }
 
 
+//
+// Bring the directories of a Control that is being reused (see
+// PreloadSystemTypes) up to date for another compilation: reread the
+// directories on the class path, and look for the directories of each
+// known package anew, since a package may have gained or lost some in the
+// meantime. That is all it takes as long as every type read so far came
+// from an archive, which does not change; returns false if a package with
+// types now has a directory on disk as well.
+//
+bool Control::ReloadPackages()
+{
+    RereadDirectories();
+    for (unsigned i = 0; i < external_table.NumOtherSymbols(); i++)
+    {
+        PackageSymbol* package = (PackageSymbol*) external_table.OtherSym(i);
+        if (package != unnamed_package && ! ReloadPackage(package))
+            return false;
+    }
+    return true;
+}
+
+
+bool Control::ReloadPackage(PackageSymbol* package)
+{
+    package -> directory.Reset();
+    package -> source_roots_searched = 0;
+    FindPathsToDirectory(package);
+    if (package -> NumTypeSymbols())
+    {
+        for (unsigned k = 0; k < package -> directory.Length(); k++)
+        {
+            if (! package -> directory[k] -> IsZip())
+                return false;
+        }
+    }
+
+    for (unsigned i = 0; i < package -> NumSubpackages(); i++)
+    {
+        if (! ReloadPackage(package -> Subpackage(i)))
+            return false;
+    }
+    return true;
+}
+
+
 void Control::ComputeRecompilationSet(TypeDependenceChecker& dependence_checker)
 {
     SymbolSet type_trash_set;
@@ -249,7 +298,11 @@ void Control::ComputeRecompilationSet(TypeDependenceChecker& dependence_checker)
                 file_symbol -> Reset();
                 file_symbol -> SetJava();
 
-                scanner -> Scan(file_symbol);
+                {
+                    Profiler::Phase phase(profiler, Profiler::SCAN,
+                                          file_symbol);
+                    scanner -> Scan(file_symbol);
+                }
 
                 LexStream* lex_stream = file_symbol -> lex_stream;
                 if (lex_stream) // did we have a successful scan!
@@ -313,7 +366,7 @@ void Control::ComputeRecompilationSet(TypeDependenceChecker& dependence_checker)
             {
                 file_seen.AddElement(file_symbol);
                 new_set.AddElement(file_symbol);
-                file_symbol -> mtime = 0; // to force a reread of the file.
+                file_symbol -> SetMtime(0); // to force a reread of the file.
             }
         }
 
@@ -362,6 +415,117 @@ void Control::ComputeRecompilationSet(TypeDependenceChecker& dependence_checker)
 }
 
 
+//
+// Trim the input files of a compilation with --incremental-db down to those
+// that changed since the last one, and add the files that depend on them.
+//
+void Control::SelectChangedInputFiles()
+{
+    std::vector<std::string> input_files;
+    FileSymbol* file_symbol;
+    for (file_symbol = (FileSymbol*) input_java_file_set.FirstElement();
+         file_symbol;
+         file_symbol = (FileSymbol*) input_java_file_set.NextElement())
+    {
+        input_files.push_back(file_symbol -> FileName());
+    }
+
+    if (! dependence_database -> Analyze(input_files, option.incremental))
+        return;
+
+    Tuple<FileSymbol*> unchanged_files;
+    for (file_symbol = (FileSymbol*) input_java_file_set.FirstElement();
+         file_symbol;
+         file_symbol = (FileSymbol*) input_java_file_set.NextElement())
+    {
+        if (! dependence_database -> Recompile(file_symbol -> FileName()))
+            unchanged_files.Next() = file_symbol;
+    }
+    for (unsigned i = 0; i < unchanged_files.Length(); i++)
+        input_java_file_set.RemoveElement(unchanged_files[i]);
+
+    const std::vector<std::string>& dependents =
+        dependence_database -> Dependents();
+    for (unsigned k = 0; k < dependents.size(); k++)
+    {
+        ProcessNewInputFile(input_java_file_set,
+                            const_cast<char*>(dependents[k].c_str()));
+    }
+}
+
+
+bool Control::StaleDependents()
+{
+    return dependence_database && ! option.incremental &&
+        dependence_database -> Stale();
+}
+
+
+void Control::WatchDirectory(DirectorySymbol* directory_symbol)
+{
+    watcher -> Watch(directory_symbol);
+
+    for (unsigned i = 0; i < directory_symbol -> subdirectories.Length(); i++)
+        WatchDirectory(directory_symbol -> subdirectories[i]);
+}
+
+
+//
+// Watch the source directories (--watch). This is done anew after each
+// compilation, as it may have looked into directories that were not known
+// before; and before its summary is out, so that no change made in response
+// to the summary goes unseen.
+//
+void Control::WatchSourceDirectories()
+{
+    for (unsigned i = (dot_classpath_index == 0 ? 0 : 1);
+         i < classpath.Length(); i++)
+    {
+        PathSymbol* path_symbol = classpath[i];
+        if (! path_symbol -> IsZip())
+            WatchDirectory(path_symbol -> RootDirectory());
+    }
+    FileSymbol* file_symbol;
+    for (file_symbol = (FileSymbol*) input_java_file_set.FirstElement();
+         file_symbol;
+         file_symbol = (FileSymbol*) input_java_file_set.NextElement())
+    {
+        watcher -> Watch(file_symbol -> directory_symbol);
+    }
+}
+
+
+//
+// Block until a source file changes (--watch). A change to a file that was
+// compiled or read before is made to show by resetting its time stamp, as
+// the time stamps of the file system may be too coarse to tell an edit from
+// the compilation before it.
+//
+bool Control::WaitForSourceChanges()
+{
+    if (! watcher -> WaitForChanges(option.watch_delay))
+    {
+        fprintf(stderr, "\n*** Cannot watch the source directories: %s\n",
+                strerror(errno));
+        fflush(stderr);
+        return false;
+    }
+    watcher -> StartCycle();
+
+    for (unsigned k = 0; k < watcher -> NumChanges(); k++)
+    {
+        const std::string& name = watcher -> ChangedFile(k);
+        NameSymbol* name_symbol = ConvertUtf8ToUnicode(name.c_str(),
+            name.length() - FileSymbol::java_suffix_length);
+        FileSymbol* file_symbol =
+            watcher -> ChangedDirectory(k) -> FindFileSymbol(name_symbol);
+        if (file_symbol)
+            file_symbol -> SetMtime(0);
+    }
+    return true;
+}
+
+
 //
 // Check whether or not there are files to be recompiled.
 //
@@ -378,7 +542,19 @@ bool Control::IncrementalRecompilation()
                          recompilation_file_set.Size());
 
     if (! recompilation_file_set.IsEmpty())
+    {
         candidates = recompilation_file_set;
+        if (watcher)
+            watcher -> StartCycle();
+    }
+    else if (watcher)
+    {
+        if (! WaitForSourceChanges())
+            return false;
+
+        candidates = input_java_file_set;
+        candidates.Union(input_class_file_set);
+    }
     else
     {
         Ostream out;
@@ -424,6 +600,18 @@ bool Control::IncrementalRecompilation()
     // type_trash_set, the set of files that should be removed from the
     // database as they will be recompiled.
     //
+    if (watcher)
+    {
+        FileSymbol* file_symbol;
+        for (file_symbol = (FileSymbol*) expired_file_set.FirstElement();
+             file_symbol;
+             file_symbol = (FileSymbol*) expired_file_set.NextElement())
+        {
+            watcher -> Removed(file_symbol);
+        }
+        return true;
+    }
+
     fprintf(stderr, "%s", (recompilation_file_set.IsEmpty() &&
                            expired_file_set.IsEmpty()
                            ? "\nnothing changed...\n" : "\nok...\n"));
@@ -10,6 +10,7 @@
 #include "platform.h"
 #include "jikesapi.h"
 #include "error.h"
+#include "server.h"
 
 #ifdef JOPA_HAS_CPPTRACE
 #include <cpptrace/cpptrace.hpp>
@@ -48,7 +49,9 @@ int main(int argc, char *argv[])
                "\tRegular options:\n"
                "-bootclasspath path location of system classes [default '']\n"
                "-classpath path     location of user classes and source files [default .]\n"
-               "-d dir              write class files in directory dir [default .]\n"
+               "-d dir              write class files in directory dir [default .];\n"
+               "                      if dir ends in .jar or .zip, write them to that\n"
+               "                      archive instead\n"
                "-debug              no effect (ignored for compatibility)\n"
                "-depend | -Xdepend  recompile all used classes\n"
                "-deprecation        report uses of deprecated features\n"
@@ -65,37 +68,79 @@ int main(int argc, char *argv[])
                "                      control level of debug information in class files\n"
                "                      [default lines,source]\n"
                "-J...               no effect (ignored for compatibility)\n"
+               "-j n | --jobs=n     write class files (or deflate them into a -d\n"
+               "                      archive), and read the zip and jar files on\n"
+               "                      the paths ahead of time, using n threads (at\n"
+               "                      most 256), 0 for one per processor [default 1,\n"
+               "                      which does neither on a thread of its own]\n"
                "-nowarn             javac-compatible equivalent of +Z0\n"
                "-nowrite            do not write any class files, useful with -verbose\n"
                "--parse-only file   parse only, write result to file (for testing)\n"
                "-O                  optimize bytecode (presently does nothing)\n"
                "-source release     interpret source by Java SDK release rules\n"
                "                      [default to max(target, 1.4)]\n"
-               "-sourcepath path    location of user source files [default '']\n"
+               "-sourcepath path    location of user source files, in directories or\n"
+               "                      zip/jar files [default '']\n"
                "-target release     output bytecode for Java SDK release rules\n"
                "                      [default to source if specified, else 1.4.2]\n"
                "-verbose            list files read and written\n"
                "-Werror             javac-compatible equivalent of +Z2\n"
+               "-Xjar-level=n       deflate the class files in a -d archive at level n,\n"
+               "                      from 0 (store) to 9 [default 6]\n"
+               "-Xmemory[=file]     report the high-water marks of the memory held by\n"
+               "                      the compilation, by phase and kind, and the\n"
+               "                      files holding the most AST at the peak; also\n"
+               "                      append them to file as a line of JSON\n"
+               "                      [default file $JOPA_MEMORY_LOG, unprinted]\n"
+               "-Xprofile[=file]    report the time spent in each phase of the\n"
+               "                      compilation and on each file, with counters;\n"
+               "                      also write them to file as JSON\n"
                "-Xstdout            redirect output listings to stdout\n"
                "-Xswitchcheck       warn about fallthrough between switch statement cases\n"
                "\tEnhanced options:\n"
                "++                  compile in incremental mode\n"
                "+a                  omit assert statements from class files\n"
                "+B                  do not invoke bytecode generator\n"
+               "--connect=socket    compile through the server on socket (see\n"
+               "                      --server), or locally if none is running\n"
                "+D                  report errors immediately in emacs-form without buffering\n"
                "+DR=filename        generate dependence report in filename\n"
                "+E                  list errors in emacs-form\n"
                "+F                  do full dependence check except for Zip and Jar files\n"
+               "--incremental-db[=file]\n"
+               "                    compile only the input files that changed since the\n"
+               "                      last compilation with this option, and the files\n"
+               "                      that depend on them, as recorded in file [default\n"
+               "                      jopa.deps in the -d directory]; the -d directory is\n"
+               "                      searched for class files after the class path\n"
                "+Kname=TypeKeyWord  map name to type keyword\n"
+               "--lazy-scan         hold the tokens of an input file only while it is\n"
+               "                      compiled; each file is scanned twice, which takes\n"
+               "                      longer\n"
                "+M                  generate makefile dependencies\n"
                "+OLDCSO             perform original classpath order for compatibility\n"
+               "--parallel-headers  read, scan and parse headers of all input files up\n"
+               "                      front using the -j threads (one per processor if\n"
+               "                      -j is not given)\n"
                "+P                  pedantic compilation - issues lots of warnings\n"
                "                      some warnings can be turned on or off independently:\n");
 
         SemanticError::PrintNamedWarnings();
 
-        printf("+T=n                set value of tab to n spaces, defaults to 8\n"
+        printf("--server=socket     serve compilations on the UNIX domain socket;\n"
+               "                      takes no other options, as each compilation\n"
+               "                      brings its own\n"
+               "--skip-unchanged    do not rewrite a class file that already has the\n"
+               "                      contents it would be written with, so that it\n"
+               "                      keeps its time stamp\n"
+               "+T=n                set value of tab to n spaces, defaults to 8\n"
+               "--trace-out=file    write a timeline of the compilation to file as\n"
+               "                      Chrome trace events, for Perfetto or\n"
+               "                      chrome://tracing\n"
                "+U                  do full dependence check including Zip and Jar files\n"
+               "--watch[=ms]        like ++, but recompile whenever a source file changes,\n"
+               "                      once no change has been seen for ms milliseconds\n"
+               "                      [default 200]; prints a JSON summary of each cycle\n"
                "+Z0                 do not issue warning messages\n"
                "+Z1                 treat cautions as errors\n"
                "+Z2                 treat both warnings and cautions as errors\n"
@@ -125,9 +170,20 @@ int main(int argc, char *argv[])
 
         return_code = 0;
     }
+    else if (compiler -> getOptions() -> server_socket && files)
+    {
+        CompileServer server(compiler -> getOptions() -> server_socket,
+                             argv[0]);
+        return_code = server.Serve();
+    }
     else if (files && files[0])
     {
-        return_code = compiler -> compile(files);
+        return_code = -1;
+        if (compiler -> getOptions() -> connect_socket)
+            return_code = CompileServer::Request(compiler -> getOptions() ->
+                                                 connect_socket, argc, argv);
+        if (return_code < 0)
+            return_code = compiler -> compile(files);
     }
     else
     {
@@ -2,6 +2,10 @@
 #include "control.h"
 #include "jikesapi.h"
 #include "option.h"
+#ifdef HAVE_SYS_MMAN_H
+# include <fcntl.h>
+# include <sys/mman.h>
+#endif
 
 
 using namespace Jopa;
@@ -16,6 +20,10 @@ using namespace Jopa;
 namespace Jopa {
 //
 // A default implementation of ReadObject that read from the file sysytem.
+// Where mmap is available, a file of at least MIN_MAPPED_SIZE bytes is
+// mapped instead of copied to the heap; smaller ones are cheaper to read.
+// Either way, the contents go away with the reader, so a caller should
+// delete it as soon as the buffer has been processed.
 //
 class DefaultFileReader: public JopaAPI::FileReader
 {
@@ -27,10 +35,13 @@ public:
     virtual const char* getBuffer() { return buffer; }
     virtual size_t getBufferSize() { return size; }
 
+    static const size_t MIN_MAPPED_SIZE = 16 * 1024;
+
 private:
 
     const char* buffer;
     size_t size;
+    bool mapped; // buffer is a mapping of the file, not a heap copy
 
 // FIXME : need to move into platform.h
 };
@@ -74,6 +85,8 @@ JopaOption::~JopaOption()
     delete [] extdirs;
     delete [] sourcepath;
     delete [] parse_only_output;
+    delete [] server_socket;
+    delete [] connect_socket;
 }
 
 JopaOption::JopaOption()
@@ -93,6 +106,8 @@ JopaOption::JopaOption()
       old_classpath_search_order(false),
       help(false),
       version(false),
+      server_socket(NULL),
+      connect_socket(NULL),
       g(SOURCE | LINES),
       source(UNKNOWN),
       target(UNKNOWN),
@@ -190,6 +205,12 @@ int JopaAPI::compile(char** filenames)
 
     Control *control = new Control(filenames, *((Option *) option));
     int return_code = control -> return_code;
+    while (return_code == 0 && control -> StaleDependents())
+    {
+        delete control;
+        control = new Control(filenames, *((Option *) option));
+        return_code = control -> return_code;
+    }
     delete control;
     return return_code;
 }
@@ -296,11 +317,34 @@ DefaultFileReader::DefaultFileReader(const char *fileName)
 {
     size = 0;
     buffer = NULL;
+    mapped = false;
 
     struct stat status;
-    JopaAPI::getInstance() -> stat(fileName, &status);
+    if (JopaAPI::getInstance() -> stat(fileName, &status) != 0)
+        return;
     size = status.st_size;
 
+#ifdef HAVE_SYS_MMAN_H
+    if (size >= MIN_MAPPED_SIZE)
+    {
+        int fd = open(fileName, O_RDONLY);
+        if (fd >= 0)
+        {
+            void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (map != MAP_FAILED)
+            {
+                // Sources and class files alike are scanned front to back,
+                // once.
+                madvise(map, size, MADV_SEQUENTIAL);
+                buffer = (const char*) map;
+                mapped = true;
+                return;
+            }
+        }
+    }
+#endif
+
     FILE *srcfile = SystemFopen(fileName, "rb");
     if (srcfile != NULL)
     {
@@ -324,6 +368,13 @@ DefaultFileReader::DefaultFileReader(const char *fileName)
  */
 DefaultFileReader::~DefaultFileReader()
 {
+#ifdef HAVE_SYS_MMAN_H
+    if (mapped)
+    {
+        munmap((void*) buffer, size);
+        return;
+    }
+#endif
     delete [] buffer;
 }
 
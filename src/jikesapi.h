@@ -22,6 +22,8 @@ public:
     int old_classpath_search_order; // Use older classpath search order
     int help;            // Display a usage help message
     int version;         // Display a version message
+    char* server_socket; // Serve compilations on this socket
+    char* connect_socket; // Compile through the server on this socket
 
     enum DebugLevel
     {
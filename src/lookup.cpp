@@ -3,6 +3,7 @@
 #include "code.h"
 #include "ast.h"
 #include "case.h"
+#include "memacct.h"
 #include <cwchar>
 
 
@@ -329,14 +330,23 @@ NameLookupTable::NameLookupTable(int estimate)
 
 NameLookupTable::~NameLookupTable()
 {
+    size_t bytes = 0;
     for (unsigned i = 0; i < symbol_pool.Length(); i++)
+    {
+        bytes += sizeof(NameSymbol) +
+            (symbol_pool[i] -> NameLength() + 1) * sizeof(wchar_t);
         delete symbol_pool[i];
+    }
     delete [] base;
+    MemoryAccount::Free(MemoryAccount::NAMES, bytes);
 }
 
 
 void NameLookupTable::Rehash()
 {
+    MemoryAccount::Allocate(MemoryAccount::NAMES,
+                            (primes[prime_index + 1] - hash_size) *
+                            sizeof(NameSymbol*));
     hash_size = primes[++prime_index];
 
     delete [] base;
@@ -353,16 +363,43 @@ void NameLookupTable::Rehash()
 }
 
 
-NameSymbol* NameLookupTable::FindOrInsertName(const wchar_t* str, unsigned len)
+//
+// Whether the len characters of name, as held by a symbol, are those of str.
+//
+static inline bool SameChars(const wchar_t* name, const wchar_t* str,
+                             unsigned len)
 {
-    unsigned hash_address = Hash(str, len);
+    return memcmp(name, str, len * sizeof(wchar_t)) == 0;
+}
+
+static inline bool SameChars(const wchar_t* name, const SourceChar* str,
+                             unsigned len)
+{
+    for (unsigned i = 0; i < len; i++)
+    {
+        if (name[i] != str[i])
+            return false;
+    }
+    return true;
+}
+
+
+//
+// Names are interned from the input buffer of the scanner as well as from
+// wide strings; either way the symbol holds the name as wchar_t.
+//
+template <typename Char>
+NameSymbol* NameLookupTable::Find(const Char* str, unsigned len,
+                                  unsigned hash_address)
+{
+    assert(hash_address == Hash(str, len));
     int k = hash_address % hash_size;
     NameSymbol* symbol;
     for (symbol = base[k]; symbol; symbol = (NameSymbol*) symbol -> next)
     {
         if (hash_address == symbol -> hash_address &&
             len == symbol -> NameLength() &&
-            memcmp(symbol -> Name(), str, len * sizeof(wchar_t)) == 0)
+            SameChars(symbol -> Name(), str, len))
         {
             return symbol;
         }
@@ -372,6 +409,8 @@ NameSymbol* NameLookupTable::FindOrInsertName(const wchar_t* str, unsigned len)
     symbol = new NameSymbol();
     symbol_pool.Next() = symbol;
     symbol -> Initialize(str, len, hash_address, index);
+    MemoryAccount::Allocate(MemoryAccount::NAMES, sizeof(NameSymbol) +
+                            (len + 1) * sizeof(wchar_t));
 
     symbol -> next = base[k];
     base[k] = symbol;
@@ -388,6 +427,22 @@ NameSymbol* NameLookupTable::FindOrInsertName(const wchar_t* str, unsigned len)
 }
 
 
+NameSymbol* NameLookupTable::FindOrInsertName(const wchar_t* str,
+                                              unsigned len,
+                                              unsigned hash_address)
+{
+    return Find(str, len, hash_address);
+}
+
+
+NameSymbol* NameLookupTable::FindOrInsertName(const SourceChar* str,
+                                              unsigned len,
+                                              unsigned hash_address)
+{
+    return Find(str, len, hash_address);
+}
+
+
 unsigned TypeLookupTable::primes[] = {
     DEFAULT_HASH_SIZE, 8191, 16411, MAX_HASH_SIZE
 };
@@ -1351,6 +1406,9 @@ Utf8LiteralValue* Utf8LiteralTable::FindOrInsert(wchar_t ch)
 
 void Utf8LiteralTable::Rehash()
 {
+    MemoryAccount::Allocate(MemoryAccount::NAMES,
+                            (primes[prime_index + 1] - hash_size) *
+                            sizeof(Utf8LiteralValue*));
     hash_size = primes[++prime_index];
 
     delete [] base;
@@ -1388,9 +1446,17 @@ Utf8LiteralTable::Utf8LiteralTable(LiteralValue* bad_value_)
 
 Utf8LiteralTable::~Utf8LiteralTable()
 {
+    size_t bytes = 0;
     for (unsigned i = 0; i < symbol_pool.Length(); i++)
-        delete symbol_pool[i];
+    {
+        if (symbol_pool[i])
+        {
+            bytes += sizeof(Utf8LiteralValue) + symbol_pool[i] -> length + 1;
+            delete symbol_pool[i];
+        }
+    }
     delete [] base;
+    MemoryAccount::Free(MemoryAccount::NAMES, bytes);
 }
 
 
@@ -1413,6 +1479,8 @@ Utf8LiteralValue* Utf8LiteralTable::FindOrInsert(const char* str, int len)
     lit = new Utf8LiteralValue();
     lit -> Initialize(str, len, hash_address, symbol_pool.Length());
     symbol_pool.Next() = lit;
+    MemoryAccount::Allocate(MemoryAccount::NAMES,
+                            sizeof(Utf8LiteralValue) + len + 1);
 
     lit -> next = base[k];
     base[k] = lit;
@@ -1643,8 +1711,8 @@ void LiteralLookupTable::Rehash()
 }
 
 
-LiteralSymbol* LiteralLookupTable::FindOrInsertLiteral(const wchar_t* str,
-                                                       unsigned len)
+template <typename Char>
+LiteralSymbol* LiteralLookupTable::Find(const Char* str, unsigned len)
 {
     unsigned hash_address = Hash(str, len);
     int k = hash_address % hash_size;
@@ -1653,15 +1721,16 @@ LiteralSymbol* LiteralLookupTable::FindOrInsertLiteral(const wchar_t* str,
     {
         if (hash_address == symbol -> hash_address &&
             len == symbol -> NameLength() &&
-            memcmp(symbol -> Name(), str, len * sizeof(wchar_t)) == 0)
+            SameChars(symbol -> Name(), str, len))
         {
             return symbol;
         }
     }
 
+    int index = symbol_pool.Length(); // index of the next element
     symbol = new LiteralSymbol();
     symbol_pool.Next() = symbol;
-    symbol -> Initialize(str, hash_address, len);
+    symbol -> Initialize(str, hash_address, len, index);
 
     symbol -> next = base[k];
     base[k] = symbol;
@@ -1677,6 +1746,20 @@ LiteralSymbol* LiteralLookupTable::FindOrInsertLiteral(const wchar_t* str,
     return symbol;
 }
 
+
+LiteralSymbol* LiteralLookupTable::FindOrInsertLiteral(const wchar_t* str,
+                                                       unsigned len)
+{
+    return Find(str, len);
+}
+
+
+LiteralSymbol* LiteralLookupTable::FindOrInsertLiteral(const SourceChar* str,
+                                                       unsigned len)
+{
+    return Find(str, len);
+}
+
 bool NameSymbol::Contains(wchar_t character) const
 {
     for (wchar_t* ptr = name_; *ptr; ptr++)
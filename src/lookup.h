@@ -57,6 +57,18 @@ public:
         return hash_value;
     }
 
+    //
+    // Same as above function for the input buffer of the scanner: a name
+    // hashes the same from either.
+    //
+    inline static unsigned Function(const SourceChar* head, int len)
+    {
+        unsigned hash_value = 0;
+        while (--len >= 0)
+            hash_value = (hash_value << 5) - hash_value + *head++;
+        return hash_value;
+    }
+
     //
     // Same as above function for a regular "char" string.
     //
@@ -421,7 +433,8 @@ public:
     NameSymbol() : name_(NULL) {}
     virtual ~NameSymbol() { delete [] name_; }
 
-    inline void Initialize(const wchar_t* str, unsigned length_,
+    template <typename Char>
+    inline void Initialize(const Char* str, unsigned length_,
                            unsigned hash_address_, int index_)
     {
         Symbol::_kind = NAME;
@@ -431,7 +444,8 @@ public:
 
         length = length_;
         name_ = new wchar_t[length + 1];
-        memcpy(name_, str, length * sizeof(wchar_t));
+        for (unsigned i = 0; i < length; i++)
+            name_[i] = str[i];
         name_[length] = U_NULL;
 
         Utf8_literal = NULL;
@@ -456,7 +470,15 @@ public:
     NameLookupTable(int estimate = 16384);
     ~NameLookupTable();
 
-    NameSymbol* FindOrInsertName(const wchar_t*, unsigned);
+    NameSymbol* FindOrInsertName(const wchar_t* str, unsigned len)
+    {
+        return FindOrInsertName(str, len, Hash(str, len));
+    }
+    //
+    // For a caller that has hashed the name already, with Hash::Function.
+    //
+    NameSymbol* FindOrInsertName(const wchar_t*, unsigned, unsigned hash);
+    NameSymbol* FindOrInsertName(const SourceChar*, unsigned, unsigned hash);
 
 private:
     enum
@@ -471,11 +493,15 @@ private:
     static unsigned primes[];
     int prime_index;
 
-    inline static unsigned Hash(const wchar_t* head, int len)
+    template <typename Char>
+    static unsigned Hash(const Char* head, int len)
     {
         return Hash::Function(head, len);
     }
 
+    template <typename Char>
+    NameSymbol* Find(const Char*, unsigned, unsigned hash);
+
     void Rehash();
 };
 
@@ -518,6 +544,7 @@ class LiteralSymbol : public Symbol
 {
 public:
     LiteralValue* value;
+    int index;
 
     virtual const wchar_t* Name() const { return name_; }
     virtual unsigned NameLength() const { return length; }
@@ -526,15 +553,19 @@ public:
     LiteralSymbol() : name_(NULL) {}
     virtual ~LiteralSymbol() { delete [] name_; }
 
-    void Initialize(const wchar_t* str, unsigned hash_address_, int length_)
+    template <typename Char>
+    void Initialize(const Char* str, unsigned hash_address_, int length_,
+                    int index_)
     {
         Symbol::_kind = LITERAL;
 
         hash_address = hash_address_;
+        index = index_;
 
         length = length_;
         name_ = new wchar_t[length + 1];
-        memcpy(name_, str, length * sizeof(wchar_t));
+        for (int i = 0; i < length; i++)
+            name_[i] = str[i];
         name_[length] = U_NULL;
 
         value = NULL;
@@ -559,6 +590,7 @@ public:
     ~LiteralLookupTable();
 
     LiteralSymbol* FindOrInsertLiteral(const wchar_t*, unsigned);
+    LiteralSymbol* FindOrInsertLiteral(const SourceChar*, unsigned);
 
 private:
     enum
@@ -573,11 +605,15 @@ private:
     static unsigned primes[];
     int prime_index;
 
-    inline static unsigned Hash(const wchar_t* head, int len)
+    template <typename Char>
+    static unsigned Hash(const Char* head, int len)
     {
         return Hash::Function(head, len);
     }
 
+    template <typename Char>
+    LiteralSymbol* Find(const Char*, unsigned);
+
     void Rehash();
 };
 
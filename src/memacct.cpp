@@ -0,0 +1,261 @@
+#include "memacct.h"
+#include "profile.h"
+#include "symbol.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+#ifdef HAVE_SYS_RESOURCE_H
+# include <sys/resource.h>
+#endif
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+bool MemoryAccount::enabled = false;
+
+static const char* kind_names[MemoryAccount::NUM_KINDS] =
+{
+    "ast", "lex", "names", "symbols", "class_files"
+};
+
+//
+// The bytes of each kind, and their total in the last slot.
+//
+struct Usage
+{
+    long bytes[MemoryAccount::NUM_KINDS + 1];
+};
+
+static const unsigned TOTAL = MemoryAccount::NUM_KINDS;
+static const unsigned MAX_UNITS = 10;
+
+static std::mutex mutex;
+static Usage current;
+static Usage phase_peaks[Profiler::NUM_PHASES + 1]; // the last one for none
+static Usage peak; // at the time of the overall peak
+static int phase;
+
+static std::map<FileSymbol*, long> live_ast;
+static std::vector<std::pair<long, FileSymbol*> > peak_units;
+static bool peak_units_pending; // the peak has not been looked at yet
+
+
+//
+// Note the units with the most live AST, as of now.
+//
+static void NotePeakUnits()
+{
+    peak_units.clear();
+    std::map<FileSymbol*, long>::iterator unit;
+    for (unit = live_ast.begin(); unit != live_ast.end(); unit++)
+        peak_units.push_back(std::make_pair(unit -> second, unit -> first));
+    unsigned count = std::min<size_t>(peak_units.size(), MAX_UNITS);
+    std::partial_sort(peak_units.begin(), peak_units.begin() + count,
+                      peak_units.end(),
+                      std::greater<std::pair<long, FileSymbol*> >());
+    peak_units.resize(count);
+    peak_units_pending = false;
+}
+
+
+//
+// Raise the high-water marks of the current phase to what is held now.
+//
+static void NotePhasePeak()
+{
+    Usage& phase_peak = phase_peaks[phase];
+    for (unsigned i = 0; i <= TOTAL; i++)
+    {
+        if (current.bytes[i] > phase_peak.bytes[i])
+            phase_peak.bytes[i] = current.bytes[i];
+    }
+}
+
+
+void MemoryAccount::Start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    memset(&current, 0, sizeof(current));
+    memset(phase_peaks, 0, sizeof(phase_peaks));
+    memset(&peak, 0, sizeof(peak));
+    phase = Profiler::NUM_PHASES;
+    live_ast.clear();
+    peak_units.clear();
+    peak_units_pending = false;
+    enabled = true;
+}
+
+
+void MemoryAccount::Stop()
+{
+    enabled = false;
+}
+
+
+void MemoryAccount::SetPhase(int phase_)
+{
+    if (enabled)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        phase = phase_;
+        NotePhasePeak();
+    }
+}
+
+
+void MemoryAccount::Change(Kind kind, long bytes, FileSymbol* unit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes < 0)
+    {
+        //
+        // The peak is behind us as soon as anything is released; if it was
+        // a new one, now is the time to see who held it.
+        //
+        if (peak_units_pending)
+            NotePeakUnits();
+    }
+    current.bytes[kind] += bytes;
+    current.bytes[TOTAL] += bytes;
+    if (kind == AST && unit)
+    {
+        long& live = live_ast[unit];
+        live += bytes;
+        if (live <= 0)
+            live_ast.erase(unit);
+    }
+    if (bytes <= 0)
+        return;
+
+    NotePhasePeak();
+    if (current.bytes[TOTAL] > peak.bytes[TOTAL])
+    {
+        peak = current;
+        peak_units_pending = true;
+    }
+}
+
+
+static long PeakRssKb()
+{
+#ifdef HAVE_SYS_RESOURCE_H
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return usage.ru_maxrss; // in kilobytes on Linux
+#endif
+    return 0;
+}
+
+
+static void PrintJsonUsage(FILE* file, const Usage& usage)
+{
+    fprintf(file, "{\"total\":%ld", usage.bytes[TOTAL]);
+    for (unsigned i = 0; i < MemoryAccount::NUM_KINDS; i++)
+        fprintf(file, ",\"%s\":%ld", kind_names[i], usage.bytes[i]);
+    putc('}', file);
+}
+
+
+static void PrintUsage(const char* name, const Usage& usage)
+{
+    char line[256];
+    int length = snprintf(line, sizeof(line), "%-12s %10ld", name,
+                          usage.bytes[TOTAL] / 1024);
+    for (unsigned i = 0; i < MemoryAccount::NUM_KINDS; i++)
+    {
+        length += snprintf(line + length, sizeof(line) - length, " %10ld",
+                           usage.bytes[i] / 1024);
+    }
+    Coutput << line << endl;
+}
+
+
+void MemoryAccount::Report(bool print, const char* file_name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (peak_units_pending)
+        NotePeakUnits();
+    long peak_rss_kb = PeakRssKb();
+
+    if (print)
+    {
+        char line[256];
+        int length = snprintf(line, sizeof(line), "%-12s %10s", "KB peak",
+                              "total");
+        for (unsigned i = 0; i < NUM_KINDS; i++)
+        {
+            length += snprintf(line + length, sizeof(line) - length,
+                               " %10s", kind_names[i]);
+        }
+        Coutput << endl << line << endl;
+        for (unsigned i = 0; i < Profiler::NUM_PHASES; i++)
+        {
+            if (phase_peaks[i].bytes[TOTAL])
+                PrintUsage(Profiler::Name((Profiler::PhaseKind) i),
+                           phase_peaks[i]);
+        }
+        if (phase_peaks[Profiler::NUM_PHASES].bytes[TOTAL])
+            PrintUsage("other", phase_peaks[Profiler::NUM_PHASES]);
+        PrintUsage("at peak", peak);
+        if (peak_rss_kb)
+        {
+            snprintf(line, sizeof(line), "%-12s %10ld", "peak rss",
+                     peak_rss_kb);
+            Coutput << line << endl;
+        }
+
+        if (! peak_units.empty())
+        {
+            snprintf(line, sizeof(line), "%10s  %s", "ast KB",
+                     "most live AST at peak");
+            Coutput << endl << line << endl;
+            for (unsigned i = 0; i < peak_units.size(); i++)
+            {
+                snprintf(line, sizeof(line), "%10ld  ",
+                         peak_units[i].first / 1024);
+                Coutput << line << peak_units[i].second -> FileName() << endl;
+            }
+        }
+        Coutput.flush();
+    }
+
+    if (! file_name)
+        return;
+    FILE* file = SystemFopen(file_name, "a");
+    if (! file)
+    {
+        Coutput << "*** Cannot open memory output file " << file_name
+                << endl;
+        return;
+    }
+    fprintf(file, "{\"peak_rss_kb\":%ld,\"peak\":", peak_rss_kb);
+    PrintJsonUsage(file, peak);
+    fprintf(file, ",\"phases\":{");
+    bool first = true;
+    for (unsigned i = 0; i <= Profiler::NUM_PHASES; i++)
+    {
+        if (! phase_peaks[i].bytes[TOTAL])
+            continue;
+        fprintf(file, "%s\"%s\":", first ? "" : ",",
+                i < Profiler::NUM_PHASES
+                ? Profiler::Name((Profiler::PhaseKind) i) : "other");
+        PrintJsonUsage(file, phase_peaks[i]);
+        first = false;
+    }
+    fprintf(file, "},\"units\":[");
+    for (unsigned i = 0; i < peak_units.size(); i++)
+    {
+        fprintf(file, "%s{\"file\":", i ? "," : "");
+        Profiler::PrintJsonString(file, peak_units[i].second -> FileName());
+        fprintf(file, ",\"ast\":%ld}", peak_units[i].first);
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+}
+
+
+} // Close namespace Jopa block
+
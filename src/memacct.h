@@ -0,0 +1,88 @@
+#pragma once
+
+#include "platform.h"
+
+
+namespace Jopa { // Open namespace Jopa block
+class FileSymbol;
+
+
+//
+// The memory accounting of -Xmemory: the bytes held by the big consumers of
+// a compilation, by kind, as they come and go. Each kind is accounted for
+// where its memory is allocated and released:
+//
+//   ast          StoragePool segments (the AST of each compilation unit)
+//   lex          LexStream input, token, comment and line buffers
+//   names        NameLookupTable and Utf8LiteralTable entries
+//   symbols      SymbolTable entries
+//   class_files  ClassFile objects, read or generated
+//
+// The high-water mark of each kind, and of their total, is kept for each
+// phase of the Profiler; an allocation on a worker thread counts for the
+// phase the main thread is in. At the overall peak, the live AST of each
+// compilation unit is noted, so that Report can tell which units held the
+// most of it.
+//
+// Accounting is off unless Start is called; a call to Allocate or Free is
+// then just a test.
+//
+class MemoryAccount
+{
+public:
+    enum Kind
+    {
+        AST,
+        LEX,
+        NAMES,
+        SYMBOLS,
+        CLASS_FILES,
+        NUM_KINDS
+    };
+
+    static inline void Allocate(Kind kind, size_t bytes,
+                                FileSymbol* unit = NULL)
+    {
+        if (enabled)
+            Change(kind, (long) bytes, unit);
+    }
+    static inline void Free(Kind kind, size_t bytes, FileSymbol* unit = NULL)
+    {
+        if (enabled)
+            Change(kind, - (long) bytes, unit);
+    }
+
+    //
+    // Start accounting from zero; Stop ends it.
+    //
+    static void Start();
+    static void Stop();
+
+    //
+    // The phase allocations count for, as a Profiler::PhaseKind;
+    // Profiler::NUM_PHASES stands for none.
+    //
+    static void SetPhase(int phase);
+
+    //
+    // Print the high-water marks with Coutput (if print is set), and append
+    // them to file_name (if not NULL) as one line of JSON:
+    //
+    //   {"peak_rss_kb":...,"peak":{"total":...,"ast":...,...},
+    //    "phases":{"startup":{"total":...,"ast":...,...},...},
+    //    "units":[{"file":"...","ast":...},...]}
+    //
+    // in bytes, where units are those with the most live AST at the peak.
+    // Each compilation adds a line, so that a build can collect them all.
+    //
+    static void Report(bool print, const char* file_name);
+
+private:
+    static bool enabled;
+
+    static void Change(Kind, long, FileSymbol*);
+};
+
+
+} // Close namespace Jopa block
+
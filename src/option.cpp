@@ -4,6 +4,7 @@
 #include "case.h"
 #include "tab.h"
 #include "stream.h"
+#include <thread>
 
 namespace Jopa { // Open namespace Jopa block
 
@@ -182,10 +183,29 @@ const wchar_t* OptionError::GetErrorMessage()
         s << '\"' << name
           << "\" is not a valid tab size. An integer value is expected.";
         break;
+    case INVALID_JOBS_VALUE:
+        s << '\"' << name
+          << "\" is not a valid number of jobs. An integer value from 0 "
+          << "to " << (int) Option::MAX_JOBS << " is expected.";
+        break;
+    case INVALID_WATCH_DELAY:
+        s << '\"' << name
+          << "\" is not a valid delay for \"--watch\". A non-negative "
+          << "number of milliseconds is expected.";
+        break;
     case INVALID_P_ARGUMENT:
         s << '\"' << name
           << "\" is not a recognized flag for controlling pedantic warnings.";
         break;
+    case INVALID_JAR_LEVEL:
+        s << '\"' << name
+          << "\" is not a valid level for \"-Xjar-level\". An integer from 0 "
+          << "(store) to 9 (best compression) is expected.";
+        break;
+    case JAR_OUTPUT_CONFLICT:
+        s << "The \"-d\" option names an archive, which cannot be used with \""
+          << name << "\".";
+        break;
     case INVALID_DIRECTORY:
         s << "The directory specified in the \"-d\" option, \"" << name
           << "\", is either invalid or it could not be expanded.";
@@ -209,6 +229,10 @@ const wchar_t* OptionError::GetErrorMessage()
         s << "The option \"" << name
           << "\" has been temporarily disabled.";
         break;
+    case SERVER_WITH_ARGUMENTS:
+        s << "\"" << name << "\" takes no other options or files; "
+          << "those are given with each compilation.";
+        break;
     default:
         assert(false && "invalid OptionError kind");
     }
@@ -241,6 +265,9 @@ static inline char* makeStrippedCopy(char* value)
 Option::Option(ArgumentExpander& arguments,
                Tuple<OptionError *>& bad_options)
     : first_file_index(arguments.argc),
+      jobs(-1),
+      watch_delay(200),
+      jar_level(6),
 #ifdef JOPA_DEBUG
       debug_trap_op(0),
       debug_dump_lex(false),
@@ -253,6 +280,7 @@ Option::Option(ArgumentExpander& arguments,
 #endif // JOPA_DEBUG
       nocleanup(false),
       incremental(false),
+      watch(false),
       makefile(false),
       dependence_report(false),
       bytecode(true),
@@ -262,12 +290,25 @@ Option::Option(ArgumentExpander& arguments,
       errors(true),
       pedantic(false),
       noassert(false),
+      parallel_headers(false),
+      lazy_scan(false),
+      skip_unchanged(false),
+      profile(false),
+      memory(false),
       nosuppressed(false),
       nowarn_unchecked(false),
-      dependence_report_name(NULL)
+      dependence_report_name(NULL),
+      incremental_db(NULL),
+      options_hash(0),
+      profile_name(NULL),
+      trace_name(NULL),
+      memory_name(NULL),
+      jar_name(NULL)
 {
 
     Tuple<int> filename_index(2048);
+    int server_argc = 0;
+    bool use_incremental_db = false;
 
     for (int i = 1; i < arguments.argc; i++)
     {
@@ -437,6 +478,44 @@ Option::Option(ArgumentExpander& arguments,
             }
             else if (arguments.argv[i][1] == 'J')
                 ; // Ignore for compatibility.
+            else if (arguments.argv[i][1] == 'j' ||
+                     strncmp(arguments.argv[i], "--jobs", 6) == 0)
+            {
+                char* image = arguments.argv[i] + 2;
+                if (arguments.argv[i][1] == '-')
+                    image += 4;
+                if (*image == '=')
+                    image++;
+                else if (! *image)
+                {
+                    if (i + 1 == arguments.argc)
+                    {
+                        bad_options.Next() =
+                            new OptionError(OptionError::MISSING_OPTION_ARGUMENT,
+                                            arguments.argv[i]);
+                        continue;
+                    }
+                    image = arguments.argv[++i];
+                }
+
+                //
+                // Stop adding up digits past MAX_JOBS, so that a long
+                // number cannot overflow.
+                //
+                int value = 0;
+                char *p;
+                for (p = image; *p && *p >= '0' && *p <= '9'; p++)
+                {
+                    if (value <= MAX_JOBS)
+                        value = value * 10 + (*p - '0');
+                }
+                if (*p || p == image || value > MAX_JOBS)
+                {
+                    bad_options.Next() =
+                        new OptionError(OptionError::INVALID_JOBS_VALUE, image);
+                }
+                else jobs = value;
+            }
             else if (strcmp(arguments.argv[i], "-nowarn") == 0 ||
                      strcmp(arguments.argv[i], "--nowarn") == 0 ||
                      strcmp(arguments.argv[i], "-q") == 0)
@@ -586,10 +665,57 @@ Option::Option(ArgumentExpander& arguments,
                 assert(success);
                 (void)success;
             }
+            else if (strncmp(arguments.argv[i], "-Xprofile", 9) == 0 &&
+                     (arguments.argv[i][9] == U_NULL ||
+                      arguments.argv[i][9] == U_EQUAL))
+            {
+                profile = true;
+                delete [] profile_name;
+                profile_name = NULL;
+                if (arguments.argv[i][9] == U_EQUAL)
+                {
+                    char* image = arguments.argv[i] + 10;
+                    profile_name = new char[strlen(image) + 1];
+                    strcpy(profile_name, image);
+                }
+            }
+            else if (strncmp(arguments.argv[i], "-Xmemory", 8) == 0 &&
+                     (arguments.argv[i][8] == U_NULL ||
+                      arguments.argv[i][8] == U_EQUAL))
+            {
+                memory = true;
+                delete [] memory_name;
+                memory_name = NULL;
+                if (arguments.argv[i][8] == U_EQUAL)
+                {
+                    char* image = arguments.argv[i] + 9;
+                    memory_name = new char[strlen(image) + 1];
+                    strcpy(memory_name, image);
+                }
+            }
+            else if (strncmp(arguments.argv[i], "-Xjar-level", 11) == 0 &&
+                     (arguments.argv[i][11] == U_NULL ||
+                      arguments.argv[i][11] == U_EQUAL))
+            {
+                char* image = arguments.argv[i] + 12;
+                if (arguments.argv[i][11] == U_NULL || *image == U_NULL)
+                {
+                    bad_options.Next() =
+                        new OptionError(OptionError::MISSING_OPTION_ARGUMENT,
+                                        "-Xjar-level");
+                }
+                else if (image[0] < '0' || image[0] > '9' || image[1])
+                {
+                    bad_options.Next() =
+                        new OptionError(OptionError::INVALID_JAR_LEVEL,
+                                        image);
+                }
+                else jar_level = image[0] - '0';
+            }
             else if (arguments.argv[i][1] == 'X')
             {
                 // Note that we've already consumed -Xdepend, -Xstdout,
-                // and -Xswitchcheck.
+                // -Xswitchcheck, -Xprofile, -Xmemory and -Xjar-level.
                 bad_options.Next() =
                     new OptionError(OptionError::UNSUPPORTED_OPTION,
                                     arguments.argv[i]);
@@ -618,6 +744,122 @@ Option::Option(ArgumentExpander& arguments,
             {
                 noassert = true;
             }
+            else if (strcmp(arguments.argv[i], "--parallel-headers") == 0)
+            {
+                parallel_headers = true;
+            }
+            else if (strcmp(arguments.argv[i], "--lazy-scan") == 0)
+            {
+                lazy_scan = true;
+            }
+            else if (strcmp(arguments.argv[i], "--skip-unchanged") == 0)
+            {
+                skip_unchanged = true;
+            }
+            else if (strncmp(arguments.argv[i], "--incremental-db", 16) == 0 &&
+                     (arguments.argv[i][16] == U_NULL ||
+                      arguments.argv[i][16] == U_EQUAL))
+            {
+                use_incremental_db = true;
+                delete [] incremental_db;
+                incremental_db = NULL;
+                if (arguments.argv[i][16] == U_EQUAL)
+                {
+                    char* image = arguments.argv[i] + 17;
+                    incremental_db = new char[strlen(image) + 1];
+                    strcpy(incremental_db, image);
+                }
+            }
+            else if (strncmp(arguments.argv[i], "--trace-out", 11) == 0 &&
+                     (arguments.argv[i][11] == U_NULL ||
+                      arguments.argv[i][11] == U_EQUAL))
+            {
+                delete [] trace_name;
+                trace_name = NULL;
+                char* image = arguments.argv[i] + 12;
+                if (arguments.argv[i][11] == U_NULL || *image == U_NULL)
+                {
+                    bad_options.Next() =
+                        new OptionError(OptionError::MISSING_OPTION_ARGUMENT,
+                                        "--trace-out");
+                }
+                else
+                {
+                    trace_name = new char[strlen(image) + 1];
+                    strcpy(trace_name, image);
+                }
+            }
+            else if (strncmp(arguments.argv[i], "--watch", 7) == 0 &&
+                     (arguments.argv[i][7] == U_NULL ||
+                      arguments.argv[i][7] == U_EQUAL))
+            {
+#ifdef HAVE_SYS_INOTIFY_H
+                incremental = true;
+                full_check = true;
+                watch = true;
+                if (arguments.argv[i][7] == U_EQUAL)
+                {
+                    char* image = arguments.argv[i] + 8;
+                    int value = 0;
+                    char *p;
+                    for (p = image; *p && *p >= '0' && *p <= '9'; p++)
+                        value = value * 10 + (*p - '0');
+                    if (*p || p == image)
+                    {
+                        bad_options.Next() =
+                            new OptionError(OptionError::INVALID_WATCH_DELAY,
+                                            image);
+                    }
+                    else watch_delay = value;
+                }
+#else // ! defined(HAVE_SYS_INOTIFY_H)
+                bad_options.Next() =
+                    new OptionError(OptionError::UNSUPPORTED_OPTION,
+                                    "--watch");
+#endif // ! defined(HAVE_SYS_INOTIFY_H)
+            }
+            else if (strncmp(arguments.argv[i], "--server", 8) == 0 ||
+                     strncmp(arguments.argv[i], "--connect", 9) == 0)
+            {
+                bool server = arguments.argv[i][2] == 's';
+                char* image = arguments.argv[i] + (server ? 8 : 9);
+                int argc = 1;
+                if (*image == '=')
+                    image++;
+                else if (*image)
+                {
+                    bad_options.Next() =
+                        new OptionError(OptionError::INVALID_OPTION,
+                                        arguments.argv[i]);
+                    continue;
+                }
+                else
+                {
+                    if (i + 1 == arguments.argc)
+                    {
+                        bad_options.Next() =
+                            new OptionError(OptionError::MISSING_OPTION_ARGUMENT,
+                                            arguments.argv[i]);
+                        continue;
+                    }
+                    image = arguments.argv[++i];
+                    argc++;
+                }
+
+                char* socket_name = new char[strlen(image) + 1];
+                strcpy(socket_name, image);
+                if (server)
+                {
+                    delete [] server_socket;
+                    server_socket = socket_name;
+                    server_argc = argc;
+                }
+                else
+                {
+                    delete [] connect_socket;
+                    connect_socket = socket_name;
+                }
+            }
             else if (strcmp(arguments.argv[i], "--nosuppressed") == 0)
             {
                 // Disable addSuppressed() calls in try-with-resources
@@ -861,6 +1103,34 @@ Option::Option(ArgumentExpander& arguments,
             filename_index.Next() = i;
     }
 
+    //
+    // The options of a compile server are those of each compilation it is
+    // given. (Besides, the global state they set would leak into them.)
+    //
+    if (server_socket && arguments.argc - 1 > server_argc)
+    {
+        bad_options.Next() =
+            new OptionError(OptionError::SERVER_WITH_ARGUMENTS, "--server");
+    }
+
+    //
+    // A -d that names a zip or jar file is the archive to write the class
+    // files to. There is no going back to an archive to recompile some of
+    // its classes, so it is no good for an incremental compilation.
+    //
+    if (directory && IsZipFileName(directory))
+    {
+        jar_name = directory;
+        directory = NULL;
+        if (incremental || use_incremental_db)
+        {
+            bad_options.Next() =
+                new OptionError(OptionError::JAR_OUTPUT_CONFLICT,
+                                watch ? "--watch"
+                                : incremental ? "++" : "--incremental-db");
+        }
+    }
+
     // Specify defaults for -source and -target.
     if (source == UNKNOWN)
     {
@@ -916,6 +1186,17 @@ Option::Option(ArgumentExpander& arguments,
         //   this copy and delete it later in ~JopaOption
             classpath = makeStrippedCopy(getenv("CLASSPATH"));
     }
+    if (! memory)
+    {
+        // Without -Xmemory, the memory accounting may still be asked for
+        //   by the build (see memacct.h); it is then only written out
+        memory_name = makeStrippedCopy(getenv("JOPA_MEMORY_LOG"));
+        if (memory_name && ! *memory_name)
+        {
+            delete [] memory_name;
+            memory_name = NULL;
+        }
+    }
     if (! sourcepath)
     {
         // Create a clean copy of the sourcepath envvar so we can modify
@@ -929,6 +1210,81 @@ Option::Option(ArgumentExpander& arguments,
             sourcepath[1] = U_NULL;
         }
     }
+    for (unsigned k = 0; k < filename_index.Length(); k++)
+    {
+        const char* file_name = arguments.argv[filename_index[k]];
+        if (IsZipFileName(file_name))
+        {
+            char* extended = new char[strlen(sourcepath) +
+                                      strlen(file_name) + 2];
+            sprintf(extended, "%s%c%s", sourcepath, PathSeparator(),
+                    file_name);
+            delete [] sourcepath;
+            sourcepath = extended;
+        }
+    }
+
+    if (use_incremental_db)
+    {
+        //
+        // Hash the options, in their order, and the paths they default to.
+        //
+        const char* paths[] = { bootclasspath, extdirs, classpath, sourcepath };
+        u8 hash = 14695981039346656037ULL; // FNV-1a
+        unsigned k = 0;
+        for (int i = 1; i < arguments.argc; i++)
+        {
+            if (k < filename_index.Length() && filename_index[k] == i)
+            {
+                k++;
+                continue;
+            }
+            for (const char* p = arguments.argv[i]; ; p++)
+            {
+                hash = (hash ^ (u1) *p) * 1099511628211ULL;
+                if (! *p)
+                    break;
+            }
+        }
+        for (unsigned j = 0; j < sizeof(paths) / sizeof(paths[0]); j++)
+        {
+            for (const char* p = paths[j] ? paths[j] : ""; ; p++)
+            {
+                hash = (hash ^ (u1) *p) * 1099511628211ULL;
+                if (! *p)
+                    break;
+            }
+        }
+        options_hash = hash;
+
+        if (! incremental_db)
+        {
+            const char* name = "jopa.deps";
+            incremental_db = new char[(directory ? strlen(directory) : 0) +
+                                      strlen(name) + 2];
+            if (directory)
+            {
+                strcpy(incremental_db, directory);
+                strcat(incremental_db, StringConstant::U8S_SL);
+                strcat(incremental_db, name);
+            }
+            else strcpy(incremental_db, name);
+        }
+
+        //
+        // The types of the files that are not recompiled come from the class
+        // files of the last compilation, so look for them in the output
+        // directory, after everything else.
+        //
+        if (directory)
+        {
+            const char* path = classpath ? classpath : ".";
+            char* extended = new char[strlen(path) + strlen(directory) + 2];
+            sprintf(extended, "%s%c%s", path, PathSeparator(), directory);
+            delete [] classpath;
+            classpath = extended;
+        }
+    }
 
     //
     // Initially, first_file_index is set to argc. Since the array
@@ -955,10 +1311,30 @@ Option::Option(ArgumentExpander& arguments,
 }
 
 
+bool Option::IsZipFileName(const char* file_name)
+{
+    size_t length = strlen(file_name);
+    return length > 4 && (strcasecmp(&file_name[length - 4], ".jar") == 0 ||
+                          strcasecmp(&file_name[length - 4], ".zip") == 0);
+}
+
+
+unsigned Option::Threads(unsigned unset) const
+{
+    if (jobs < 0)
+        return unset;
+    return jobs > 0 ? jobs : std::thread::hardware_concurrency();
+}
+
+
 Option::~Option()
 {
     delete [] dependence_report_name;
-
+    delete [] profile_name;
+    delete [] trace_name;
+    delete [] memory_name;
+    delete [] incremental_db;
+    delete [] jar_name;
 }
 
 
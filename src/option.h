@@ -51,13 +51,18 @@ public:
         INVALID_K_OPTION,
         INVALID_K_TARGET,
         INVALID_TAB_VALUE,
+        INVALID_JOBS_VALUE,
+        INVALID_WATCH_DELAY,
         INVALID_P_ARGUMENT,
         INVALID_DIRECTORY,
         INVALID_AT_FILE,
         NESTED_AT_FILE,
         UNSUPPORTED_ENCODING,
         UNSUPPORTED_OPTION,
-        DISABLED_OPTION
+        DISABLED_OPTION,
+        SERVER_WITH_ARGUMENTS,
+        INVALID_JAR_LEVEL,
+        JAR_OUTPUT_CONFLICT
     };
 
     OptionError(OptionErrorKind kind_, const char *str) : kind(kind_)
@@ -86,6 +91,13 @@ public:
 
     int first_file_index;
 
+    enum { MAX_JOBS = 256 }; // the most threads -j may ask for
+    int jobs; // threads to use; 0 means one per processor, -1 that -j is unset
+
+    int watch_delay; // with --watch, milliseconds of quiet before recompiling
+
+    int jar_level; // with -Xjar-level, how hard to deflate the -d archive
+
 #ifdef JOPA_DEBUG
     int debug_trap_op;
 
@@ -100,6 +112,7 @@ public:
 
     bool nocleanup,
          incremental,
+         watch,  // Recompile whenever a source file changes (implies ++)
          makefile,
          dependence_report,
          bytecode,
@@ -109,14 +122,63 @@ public:
          errors,
          pedantic,
          noassert,
+         parallel_headers,  // Scan and header-parse input files up front, in parallel
+         lazy_scan,  // Scan input files again when compiled, not holding their tokens
+         skip_unchanged,  // Leave class files that would not change alone
+         profile,  // Time the phases of the compilation (-Xprofile)
+         memory,  // Report the memory held by the compilation (-Xmemory)
          nosuppressed,  // Disable addSuppressed() calls for older class libraries
          nowarn_unchecked;  // Suppress unchecked type conversion warnings
 
     char *dependence_report_name;
 
+    //
+    // With --incremental-db, the file of the dependence database (see
+    // incrdb.h), and a hash of the options proper: the database of a
+    // compilation with other options is no use.
+    //
+    char *incremental_db;
+    u8 options_hash;
+
+    //
+    // With -Xprofile=file, where to write the profile as JSON (see
+    // profile.h).
+    //
+    char *profile_name;
+
+    //
+    // With --trace-out=file, where to write the timeline of the compilation
+    // as Chrome trace events (see profile.h).
+    //
+    char *trace_name;
+
+    //
+    // With -Xmemory=file (or JOPA_MEMORY_LOG in the environment), where to
+    // append the memory high-water marks as JSON (see memacct.h).
+    //
+    char *memory_name;
+
+    //
+    // With -d out.jar (or out.zip), the archive the class files are written
+    // to instead of a directory; directory is then NULL. See jar_writer.h.
+    //
+    char *jar_name;
+
     Option(ArgumentExpander &, Tuple<OptionError *>&);
 
     ~Option();
+
+    //
+    // Whether an input file is a zip or jar file, which stands for the .java
+    // files in it; such a file is added to the sourcepath.
+    //
+    static bool IsZipFileName(const char *);
+
+    //
+    // The number of threads -j asks for, with one per processor for -j 0;
+    // or unset, if -j is not given.
+    //
+    unsigned Threads(unsigned unset) const;
 };
 
 
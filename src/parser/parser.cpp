@@ -75,7 +75,8 @@ AstPackageDeclaration* Parser::PackageHeaderParse(LexStream* lex_stream_,
     if (lex_stream_ -> PackageToken())
     {
         ast_pool = ast_pool_;
-        list_node_pool = new StoragePool(lex_stream_ -> NumTokens());
+        list_node_pool = new StoragePool(lex_stream_ -> NumTokens(),
+                                         lex_stream_ -> file_symbol);
         free_list_nodes = NULL;
 
         parse_package_header_only = true;
@@ -109,9 +110,11 @@ AstCompilationUnit* Parser::HeaderParse(LexStream* lex_stream_,
 {
     lex_stream_ -> Reset();
 
-    body_pool = new StoragePool(lex_stream_ -> NumTokens());
+    body_pool = new StoragePool(lex_stream_ -> NumTokens(),
+                                lex_stream_ -> file_symbol);
     ast_pool = (ast_pool_ ? ast_pool_ : body_pool);
-    list_node_pool = new StoragePool(lex_stream_ -> NumTokens());
+    list_node_pool = new StoragePool(lex_stream_ -> NumTokens(),
+                                     lex_stream_ -> file_symbol);
     free_list_nodes = NULL;
     AstCompilationUnit *compilation_unit = NULL;
 
@@ -226,7 +229,8 @@ bool Parser::BodyParse(LexStream* lex_stream_, AstClassBody* class_body)
     lex_stream = lex_stream_;
     ast_pool = class_body -> pool;
     body_pool = class_body -> pool;
-    list_node_pool = new StoragePool(lex_stream_ -> NumTokens());
+    list_node_pool = new StoragePool(lex_stream_ -> NumTokens(),
+                                     lex_stream_ -> file_symbol);
     free_list_nodes = NULL;
 
     bool success = Body(class_body);
@@ -291,7 +295,8 @@ bool Parser::InitializerParse(LexStream* stream, AstClassBody* class_body)
     lex_stream = stream;
     ast_pool = class_body -> pool;
     body_pool = class_body -> pool;
-    list_node_pool = new StoragePool(stream -> NumTokens());
+    list_node_pool = new StoragePool(stream -> NumTokens(),
+                                     stream -> file_symbol);
     free_list_nodes = NULL;
 
     bool success = Initializer(class_body);
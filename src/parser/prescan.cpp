@@ -0,0 +1,131 @@
+#include "prescan.h"
+#include "ast.h"
+#include "control.h"
+#include "parser.h"
+#include "profile.h"
+#include "scanner.h"
+#include "stream.h"
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+Prescanner::Prescanner(Control& control_, FileSymbol** files_,
+                       unsigned num_files_, unsigned num_threads)
+    : control(control_)
+    , files(files_)
+    , num_files(num_files_)
+    , window(num_threads * 4)
+    , next_file(0)
+    , finished(0)
+    , results(num_files_)
+{
+    //
+    // File and directory names are computed lazily, and directories are
+    // shared between files; settle them all before any worker looks.
+    //
+    for (unsigned i = 0; i < num_files; i++)
+    {
+        files[i] -> FileName();
+        results[i].compilation_unit = NULL;
+        results[i].error_number = 0;
+        results[i].done = false;
+    }
+
+    for (unsigned k = 0; k < num_threads; k++)
+        workers.push_back(std::thread(&Prescanner::Run, this));
+}
+
+
+Prescanner::~Prescanner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        num_files = 0; // let the workers go
+    }
+    file_taken.notify_all();
+    for (unsigned k = 0; k < workers.size(); k++)
+        workers[k].join();
+}
+
+
+void Prescanner::Finish(unsigned i, Scanner& scanner)
+{
+    assert(i == finished);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        file_done.wait(lock, [this, i] { return results[i].done; });
+    }
+
+    FileSymbol* file_symbol = files[i];
+    if (file_symbol -> lex_stream)
+    {
+        scanner.Resolve(file_symbol -> lex_stream);
+
+        AstCompilationUnit* compilation_unit =
+            results[i].compilation_unit;
+        if (compilation_unit)
+        {
+            file_symbol -> compilation_unit = compilation_unit;
+            control.RegisterAstPool(compilation_unit -> ast_pool);
+        }
+    }
+    errno = results[i].error_number;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished++;
+    }
+    file_taken.notify_all();
+}
+
+
+void Prescanner::Run()
+{
+    Scanner scanner(control);
+    Parser parser;
+
+    for (;;)
+    {
+        unsigned i;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            file_taken.wait(lock, [this] {
+                return next_file >= num_files ||
+                    next_file < finished + window;
+            });
+            if (next_file >= num_files)
+                return;
+            i = next_file++;
+        }
+
+        FileSymbol* file_symbol = files[i];
+        errno = 0;
+        {
+            Profiler::Phase phase(control.profiler, Profiler::SCAN,
+                                  file_symbol);
+            scanner.ScanDeferred(file_symbol);
+        }
+        int error_number = errno;
+        AstCompilationUnit* compilation_unit = NULL;
+        if (file_symbol -> lex_stream)
+        {
+            Profiler::Phase phase(control.profiler, Profiler::PARSE,
+                                  file_symbol);
+            compilation_unit =
+                parser.HeaderParse(file_symbol -> lex_stream);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            results[i].compilation_unit = compilation_unit;
+            results[i].error_number = error_number;
+            results[i].done = true;
+        }
+        file_done.notify_all();
+    }
+}
+
+
+} // Close namespace Jopa block
+
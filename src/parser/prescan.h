@@ -0,0 +1,69 @@
+#pragma once
+
+#include "platform.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class AstCompilationUnit;
+class Control;
+class FileSymbol;
+class Scanner;
+
+
+//
+// The optional up-front pass over the input files (--parallel-headers):
+// worker threads, each with a Scanner and Parser of its own, read, scan
+// and header-parse the files into their own storage pools, a bounded
+// number of files ahead of the main thread. The main thread then takes
+// the results over in file order with Finish, which interns the names and
+// literals of the file, so everything shared through Control is still
+// built serially and in the same order as without the pass.
+//
+class Prescanner
+{
+public:
+    Prescanner(Control&, FileSymbol** files, unsigned num_files,
+               unsigned num_threads);
+    ~Prescanner();
+
+    //
+    // Wait for files[i] to be done, and complete it with scanner: on return
+    // its lex_stream (if it could be read) and compilation_unit are set,
+    // exactly as if it had been scanned and header-parsed serially, and
+    // errno is what the read of the file left. Must be invoked for each
+    // file in turn.
+    //
+    void Finish(unsigned i, Scanner& scanner);
+
+private:
+    struct Result
+    {
+        AstCompilationUnit* compilation_unit;
+        int error_number;
+        bool done;
+    };
+
+    Control& control;
+    FileSymbol** files;
+    unsigned num_files;
+    unsigned window;        // how far the workers may run ahead
+    unsigned next_file;     // next file to be claimed by a worker
+    unsigned finished;      // number of files taken over by Finish
+    std::vector<Result> results;
+
+    std::mutex mutex;
+    std::condition_variable file_done;
+    std::condition_variable file_taken;
+    std::vector<std::thread> workers;
+
+    void Run();
+};
+
+
+} // Close namespace Jopa block
+
@@ -5,25 +5,130 @@
 #include "grammar/javasym.h"
 #include "option.h"
 #include "code.h"
+#include "skip.h"
 
 
 namespace Jopa { // Open namespace Jopa block
-int (*Scanner::scan_keyword[13]) (const wchar_t* p1) =
+const Scanner::KeywordTable Scanner::keywords;
+
+
+//
+// Try multipliers, and then tables of more slots, until every keyword has a
+// slot of its own. The keywords are always the same, so this always ends
+// the same way, after a few tries.
+//
+Scanner::KeywordTable::KeywordTable()
+{
+    static const struct
+    {
+        const wchar_t* name;
+        int kind;
+    } list[] = {
+        { StringConstant::US_abstract, TK_abstract },
+        { StringConstant::US_assert, TK_assert },
+        { StringConstant::US_boolean, TK_boolean },
+        { StringConstant::US_break, TK_break },
+        { StringConstant::US_byte, TK_byte },
+        { StringConstant::US_case, TK_case },
+        { StringConstant::US_catch, TK_catch },
+        { StringConstant::US_char, TK_char },
+        { StringConstant::US_class, TK_class },
+        { StringConstant::US_const, TK_const },
+        { StringConstant::US_continue, TK_continue },
+        { StringConstant::US_default, TK_default },
+        { StringConstant::US_do, TK_do },
+        { StringConstant::US_double, TK_double },
+        { StringConstant::US_else, TK_else },
+        { StringConstant::US_enum, TK_enum },
+        { StringConstant::US_extends, TK_extends },
+        { StringConstant::US_false, TK_false },
+        { StringConstant::US_final, TK_final },
+        { StringConstant::US_finally, TK_finally },
+        { StringConstant::US_float, TK_float },
+        { StringConstant::US_for, TK_for },
+        { StringConstant::US_goto, TK_goto },
+        { StringConstant::US_if, TK_if },
+        { StringConstant::US_implements, TK_implements },
+        { StringConstant::US_import, TK_import },
+        { StringConstant::US_instanceof, TK_instanceof },
+        { StringConstant::US_int, TK_int },
+        { StringConstant::US_interface, TK_interface },
+        { StringConstant::US_long, TK_long },
+        { StringConstant::US_native, TK_native },
+        { StringConstant::US_new, TK_new },
+        { StringConstant::US_null, TK_null },
+        { StringConstant::US_package, TK_package },
+        { StringConstant::US_private, TK_private },
+        { StringConstant::US_protected, TK_protected },
+        { StringConstant::US_public, TK_public },
+        { StringConstant::US_return, TK_return },
+        { StringConstant::US_short, TK_short },
+        { StringConstant::US_static, TK_static },
+        { StringConstant::US_strictfp, TK_strictfp },
+        { StringConstant::US_super, TK_super },
+        { StringConstant::US_switch, TK_switch },
+        { StringConstant::US_synchronized, TK_synchronized },
+        { StringConstant::US_this, TK_this },
+        { StringConstant::US_throw, TK_throw },
+        { StringConstant::US_throws, TK_throws },
+        { StringConstant::US_transient, TK_transient },
+        { StringConstant::US_true, TK_true },
+        { StringConstant::US_try, TK_try },
+        { StringConstant::US_void, TK_void },
+        { StringConstant::US_volatile, TK_volatile },
+        { StringConstant::US_while, TK_while },
+    };
+    const unsigned count = sizeof(list) / sizeof(list[0]);
+
+    for (int bits = 7; bits <= MAX_BITS; bits++)
+    {
+        shift = 32 - bits;
+        for (multiplier = 0x9E3779B1u; multiplier < 0x9E3779B1u + 2000;
+             multiplier += 2)
+        {
+            memset(slots, 0, sizeof(slots));
+            unsigned i;
+            for (i = 0; i < count; i++)
+            {
+                int length = wcslen(list[i].name);
+                unsigned hash = Hash::Function(list[i].name, length);
+                Slot& slot = slots[(u4) (hash * multiplier) >> shift];
+                if (slot.length)
+                    break;
+                slot.name = list[i].name;
+                slot.length = length;
+                slot.kind = list[i].kind;
+            }
+            if (i == count)
+                return;
+        }
+    }
+    assert(false && "no perfect hash for the keywords");
+}
+
+
+//
+// Whether the first len characters of name are those at p.
+//
+inline bool Scanner::SameName(const wchar_t* name, const SourceChar* p,
+                              int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        if (name[i] != p[i])
+            return false;
+    }
+    return true;
+}
+
+
+inline int Scanner::KeywordTable::Find(const SourceChar* name, int length,
+                                       unsigned hash) const
 {
-    ScanKeyword0,
-    ScanKeyword0,
-    ScanKeyword2,
-    ScanKeyword3,
-    ScanKeyword4,
-    ScanKeyword5,
-    ScanKeyword6,
-    ScanKeyword7,
-    ScanKeyword8,
-    ScanKeyword9,
-    ScanKeyword10,
-    ScanKeyword0,
-    ScanKeyword12
-};
+    const Slot& slot = slots[(u4) (hash * multiplier) >> shift];
+    return slot.length == length && SameName(slot.name, name, length)
+        ? slot.kind : TK_Identifier;
+}
 
 
 //
@@ -32,7 +137,8 @@ int (*Scanner::scan_keyword[13]) (const wchar_t* p1) =
 Scanner::Scanner(Control& control_)
     : control(control_),
       dollar_warning_given(false),
-      deprecated(false)
+      deprecated(false),
+      defer_symbols(false)
 {
     //
     // If this assertion fails, the Token structure in stream.h must be
@@ -66,6 +172,12 @@ Scanner::Scanner(Control& control_)
     }
     classify_token[128] = &Scanner::ClassifyNonAsciiUnicode;
 
+    for (int c = 0; c < 128; c++)
+    {
+        wchar_t name[2] = { (wchar_t) c, U_NULL };
+        ascii_name_part[c] = Code::IsAlnum(name);
+    }
+
     classify_token[U_a] = &Scanner::ClassifyIdOrKeyword;
     classify_token[U_b] = &Scanner::ClassifyIdOrKeyword;
     classify_token[U_c] = &Scanner::ClassifyIdOrKeyword;
@@ -167,25 +279,152 @@ void Scanner::Scan(FileSymbol* file_symbol)
     {
         Scan();
         lex -> CompressSpace();
+        Finish(lex);
+    }
+    else
+    {
+        delete lex;
+        lex = NULL;
+    }
+    file_symbol -> lex_stream = lex;
+}
+
+
+//
+// Like Scan, but without touching the name and literal tables shared
+// through control, so that several scanners may run at once (see
+// Prescanner). Each name or literal token is left holding its length, and
+// the input buffer is kept; Resolve must then be invoked, on the main
+// scanner, before the stream is otherwise used.
+//
+void Scanner::ScanDeferred(FileSymbol* file_symbol)
+{
+    defer_symbols = true;
+    dollar_warning_given = false; // Resolve decides which file reports it
+    Initialize(file_symbol);
+    lex -> ReadInput();
+    cursor = lex -> InputBuffer();
+    if (cursor)
+    {
+        Scan();
+        lex -> CompressSpace();
+    }
+    else
+    {
+        delete lex;
+        lex = NULL;
+    }
+    file_symbol -> lex_stream = lex;
+}
 
-        if (control.option.dump_errors)
+
+//
+// Complete a stream produced by ScanDeferred: intern its names and
+// literals, in token order, and keep only the first warning about a dollar
+// sign in an identifier, as a serial scan would.
+//
+void Scanner::Resolve(LexStream* stream)
+{
+    const SourceChar* input = stream -> InputBuffer();
+    for (unsigned i = 0; i < stream -> token_stream.Length(); i++)
+    {
+        LexStream::Token* token = &(stream -> token_stream[i]);
+        const SourceChar* name = &input[token -> Location()];
+        unsigned len = token -> additional_info.length;
+        LiteralLookupTable* table;
+        switch (token -> Kind())
         {
-            lex -> SortMessages();
-            for (unsigned i = 0; i < lex -> bad_tokens.Length(); i++)
-                JopaAPI::getInstance() ->
-                    reportError(&(lex -> bad_tokens[i]));
+        case TK_Identifier:
+            token -> SetSymbol(control.FindOrInsertName(name, len) -> index);
+            continue;
+        case TK_IntegerLiteral: table = &control.int_table; break;
+        case TK_LongLiteral: table = &control.long_table; break;
+        case TK_FloatLiteral: table = &control.float_table; break;
+        case TK_DoubleLiteral: table = &control.double_table; break;
+        case TK_CharacterLiteral: table = &control.char_table; break;
+        case TK_StringLiteral: table = &control.string_table; break;
+        default:
+            continue;
         }
-        lex -> DestroyInput(); // get rid of input buffer
+        token -> SetSymbol(table -> FindOrInsertLiteral(name, len) -> index);
+    }
+
+    if (stream -> HasMessage(StreamError::DOLLAR_IN_IDENTIFIER))
+    {
+        if (dollar_warning_given)
+            stream -> RemoveMessage(StreamError::DOLLAR_IN_IDENTIFIER);
+        dollar_warning_given = true;
+    }
+
+    Finish(stream);
+}
+
+
+//
+// Report the messages of a freshly scanned stream if they are not being
+// buffered, and release its input.
+//
+void Scanner::Finish(LexStream* stream)
+{
+    if (control.option.dump_errors)
+    {
+        stream -> SortMessages();
+        for (unsigned i = 0; i < stream -> bad_tokens.Length(); i++)
+            JopaAPI::getInstance() ->
+                reportError(&(stream -> bad_tokens[i]));
+    }
+    stream -> DestroyInput(); // get rid of input buffer
+}
+
+
+//
+// Scan a file for Control to process its package declaration, with
+// --lazy-scan. The stream is meant to be discarded once that is done, and
+// the file scanned again by Scan when it is compiled; so it reports
+// nothing, and leaves the warning about a dollar sign in an identifier to
+// that scan.
+//
+void Scanner::ScanPackage(FileSymbol* file_symbol)
+{
+    bool dollar_warning = dollar_warning_given;
+    Initialize(file_symbol);
+    lex -> ReadInput();
+    cursor = lex -> InputBuffer();
+    if (cursor)
+    {
+        Scan();
+        lex -> CompressSpace();
+        lex -> DestroyInput();
+        lex -> file_read = false; // its lines are counted by the full scan
     }
     else
     {
         delete lex;
         lex = NULL;
     }
+    dollar_warning_given = dollar_warning;
     file_symbol -> lex_stream = lex;
 }
 
 
+inline void Scanner::SetNameSymbol(unsigned len, unsigned hash)
+{
+    if (defer_symbols)
+        current_token -> SetLength(len);
+    else current_token ->
+        SetSymbol(control.FindOrInsertName(cursor, len, hash) -> index);
+}
+
+
+inline void Scanner::SetLiteralSymbol(LiteralLookupTable& table, unsigned len)
+{
+    if (defer_symbols)
+        current_token -> SetLength(len);
+    else current_token ->
+        SetSymbol(table.FindOrInsertLiteral(cursor, len) -> index);
+}
+
+
 //
 // Scan the InputBuffer() and process all tokens and comments.
 //
@@ -250,7 +489,7 @@ void Scanner::Scan()
 //
 void Scanner::ScanStarComment()
 {
-    const wchar_t* start = cursor - 1;
+    const SourceChar* start = cursor - 1;
     current_token -> SetKind(0);
 #ifdef JOPA_DEBUG
     LexStream::Comment* current_comment = NULL;
@@ -288,6 +527,17 @@ void Scanner::ScanStarComment()
         } state = HEADER;
         while (*cursor != U_CARRIAGE_RETURN)
         {
+            //
+            // Past the first word of a line, only the end of the line or
+            // of the comment matters.
+            //
+            if (state == REMAINDER)
+            {
+                cursor = Skip::To(cursor, input_buffer_tail, U_STAR,
+                                  U_LINE_FEED, U_CARRIAGE_RETURN);
+                if (*cursor == U_CARRIAGE_RETURN)
+                    break;
+            }
             switch (*cursor++)
             {
             case U_LINE_FEED:
@@ -345,8 +595,12 @@ void Scanner::ScanStarComment()
         // Normal comments do not affect deprecation.
         if (current_token -> Deprecated())
             deprecated = true;
-        while (*cursor != U_CARRIAGE_RETURN)
+        for (;;)
         {
+            cursor = Skip::To(cursor, input_buffer_tail, U_STAR,
+                              U_LINE_FEED, U_CARRIAGE_RETURN);
+            if (*cursor == U_CARRIAGE_RETURN)
+                break;
             if (*cursor == U_STAR) // Potential comment closer.
             {
                 while (*++cursor == U_STAR)
@@ -398,7 +652,8 @@ void Scanner::ScanSlashComment()
     if (current_token -> Deprecated())
         deprecated = true;
     current_token -> SetKind(0);
-    while (! Code::IsNewline(*++cursor));  // Skip all until \n or EOF
+    cursor = Skip::To(cursor + 1, input_buffer_tail, // Skip until \n or EOF
+                      U_LINE_FEED, U_CARRIAGE_RETURN);
 #ifdef JOPA_DEBUG
     if (control.option.debug_comments)
     {
@@ -433,303 +688,15 @@ inline void Scanner::SkipSpaces()
     {
         if (Code::IsNewline(*cursor))  // Starting a new line?
             lex -> line_location.Next() = cursor + 1 - lex -> InputBuffer();
+        if (Code::IsSpaceButNotNewline(cursor[1])) // a run of blanks
+        {
+            cursor = Skip::Past(cursor + 1, input_buffer_tail,
+                                U_SPACE, U_HORIZONTAL_TAB, U_FORM_FEED) - 1;
+        }
     } while (Code::IsSpace(*++cursor));
 }
 
 
-//
-// scan_keyword(i):
-// Scan an identifier of length I and determine if it is a keyword.
-//
-int Scanner::ScanKeyword0(const wchar_t*)
-{
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword2(const wchar_t* p1)
-{
-    if (p1[0] == U_d && p1[1] == U_o)
-        return TK_do;
-    if (p1[0] == U_i && p1[1] == U_f)
-        return TK_if;
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword3(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_f:
-        if (p1[1] == U_o && p1[2] == U_r)
-            return TK_for;
-        break;
-    case U_i:
-        if (p1[1] == U_n && p1[2] == U_t)
-            return TK_int;
-        break;
-    case U_n:
-        if (p1[1] == U_e && p1[2] == U_w)
-            return TK_new;
-        break;
-    case U_t:
-        if (p1[1] == U_r && p1[2] == U_y)
-            return TK_try;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword4(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_b:
-        if (p1[1] == U_y && p1[2] == U_t && p1[3] == U_e)
-            return TK_byte;
-        break;
-    case U_c:
-        if (p1[1] == U_a && p1[2] == U_s && p1[3] == U_e)
-            return TK_case;
-        if (p1[1] == U_h && p1[2] == U_a && p1[3] == U_r)
-            return TK_char;
-        break;
-    case U_e:
-        if (p1[1] == U_l && p1[2] == U_s && p1[3] == U_e)
-            return TK_else;
-        if (p1[1] == U_n && p1[2] == U_u && p1[3] == U_m)
-            return TK_enum;
-        break;
-    case U_g:
-        if (p1[1] == U_o && p1[2] == U_t && p1[3] == U_o)
-            return TK_goto;
-        break;
-    case U_l:
-        if (p1[1] == U_o && p1[2] == U_n && p1[3] == U_g)
-            return TK_long;
-        break;
-    case U_n:
-        if (p1[1] == U_u && p1[2] == U_l && p1[3] == U_l)
-            return TK_null;
-        break;
-    case U_t:
-        if (p1[1] == U_h && p1[2] == U_i && p1[3] == U_s)
-            return TK_this;
-        if (p1[1] == U_r && p1[2] == U_u && p1[3] == U_e)
-            return TK_true;
-        break;
-    case U_v:
-        if (p1[1] == U_o && p1[2] == U_i && p1[3] == U_d)
-            return TK_void;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword5(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_b:
-        if (p1[1] == U_r && p1[2] == U_e && p1[3] == U_a && p1[4] == U_k)
-            return TK_break;
-        break;
-    case U_c:
-        if (p1[1] == U_a && p1[2] == U_t && p1[3] == U_c && p1[4] == U_h)
-            return TK_catch;
-        if (p1[1] == U_l && p1[2] == U_a && p1[3] == U_s && p1[4] == U_s)
-            return TK_class;
-        if (p1[1] == U_o && p1[2] == U_n && p1[3] == U_s && p1[4] == U_t)
-            return TK_const;
-        break;
-    case U_f:
-        if (p1[1] == U_a && p1[2] == U_l && p1[3] == U_s && p1[4] == U_e)
-            return TK_false;
-        if (p1[1] == U_i && p1[2] == U_n && p1[3] == U_a && p1[4] == U_l)
-            return TK_final;
-        if (p1[1] == U_l && p1[2] == U_o && p1[3] == U_a && p1[4] == U_t)
-            return TK_float;
-        break;
-    case U_s:
-        if (p1[1] == U_h && p1[2] == U_o && p1[3] == U_r && p1[4] == U_t)
-            return TK_short;
-        if (p1[1] == U_u && p1[2] == U_p && p1[3] == U_e && p1[4] == U_r)
-            return TK_super;
-        break;
-    case U_t:
-        if (p1[1] == U_h && p1[2] == U_r && p1[3] == U_o && p1[4] == U_w)
-            return TK_throw;
-        break;
-    case U_w:
-        if (p1[1] == U_h && p1[2] == U_i && p1[3] == U_l && p1[4] == U_e)
-            return TK_while;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword6(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_a:
-        if (p1[1] == U_s && p1[2] == U_s &&
-            p1[3] == U_e && p1[4] == U_r && p1[5] == U_t)
-            return TK_assert;
-        break;
-    case U_d:
-        if (p1[1] == U_o && p1[2] == U_u &&
-            p1[3] == U_b && p1[4] == U_l && p1[5] == U_e)
-            return TK_double;
-        break;
-    case U_i:
-        if (p1[1] == U_m && p1[2] == U_p &&
-            p1[3] == U_o && p1[4] == U_r && p1[5] == U_t)
-            return TK_import;
-        break;
-    case U_n:
-        if (p1[1] == U_a && p1[2] == U_t &&
-            p1[3] == U_i && p1[4] == U_v && p1[5] == U_e)
-            return TK_native;
-        break;
-    case U_p:
-        if (p1[1] == U_u && p1[2] == U_b &&
-            p1[3] == U_l && p1[4] == U_i && p1[5] == U_c)
-            return TK_public;
-        break;
-    case U_r:
-        if (p1[1] == U_e && p1[2] == U_t &&
-            p1[3] == U_u && p1[4] == U_r && p1[5] == U_n)
-            return TK_return;
-        break;
-    case U_s:
-        if (p1[1] == U_t && p1[2] == U_a &&
-            p1[3] == U_t && p1[4] == U_i && p1[5] == U_c)
-            return TK_static;
-        if (p1[1] == U_w && p1[2] == U_i &&
-            p1[3] == U_t && p1[4] == U_c && p1[5] == U_h)
-            return TK_switch;
-        break;
-    case U_t:
-        if (p1[1] == U_h && p1[2] == U_r &&
-            p1[3] == U_o && p1[4] == U_w && p1[5] == U_s)
-            return TK_throws;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword7(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_b:
-        if (p1[1] == U_o && p1[2] == U_o && p1[3] == U_l &&
-            p1[4] == U_e && p1[5] == U_a && p1[6] == U_n)
-            return TK_boolean;
-        break;
-    case U_d:
-        if (p1[1] == U_e && p1[2] == U_f && p1[3] == U_a &&
-            p1[4] == U_u && p1[5] == U_l && p1[6] == U_t)
-            return TK_default;
-        break;
-    case U_e:
-        if (p1[1] == U_x && p1[2] == U_t && p1[3] == U_e &&
-            p1[4] == U_n && p1[5] == U_d && p1[6] == U_s)
-            return TK_extends;
-        break;
-    case U_f:
-        if (p1[1] == U_i && p1[2] == U_n && p1[3] == U_a &&
-            p1[4] == U_l && p1[5] == U_l && p1[6] == U_y)
-            return TK_finally;
-        break;
-    case U_p:
-        if (p1[1] == U_a && p1[2] == U_c && p1[3] == U_k &&
-            p1[4] == U_a && p1[5] == U_g && p1[6] == U_e)
-            return TK_package;
-        if (p1[1] == U_r && p1[2] == U_i && p1[3] == U_v &&
-            p1[4] == U_a && p1[5] == U_t && p1[6] == U_e)
-            return TK_private;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword8(const wchar_t* p1)
-{
-    switch (*p1)
-    {
-    case U_a:
-        if (p1[1] == U_b && p1[2] == U_s &&
-            p1[3] == U_t && p1[4] == U_r &&
-            p1[5] == U_a && p1[6] == U_c && p1[7] == U_t)
-            return TK_abstract;
-        break;
-    case U_c:
-        if (p1[1] == U_o && p1[2] == U_n &&
-            p1[3] == U_t && p1[4] == U_i &&
-            p1[5] == U_n && p1[6] == U_u && p1[7] == U_e)
-            return TK_continue;
-        break;
-    case U_s:
-        if (p1[1] == U_t && p1[2] == U_r &&
-            p1[3] == U_i && p1[4] == U_c &&
-            p1[5] == U_t && p1[6] == U_f && p1[7] == U_p)
-            return TK_strictfp;
-        break;
-    case U_v:
-        if (p1[1] == U_o && p1[2] == U_l &&
-            p1[3] == U_a && p1[4] == U_t &&
-            p1[5] == U_i && p1[6] == U_l && p1[7] == U_e)
-            return TK_volatile;
-        break;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword9(const wchar_t* p1)
-{
-    if (p1[0] == U_i && p1[1] == U_n && p1[2] == U_t &&
-        p1[3] == U_e && p1[4] == U_r && p1[5] == U_f &&
-        p1[6] == U_a && p1[7] == U_c && p1[8] == U_e)
-        return TK_interface;
-    if (p1[0] == U_p && p1[1] == U_r && p1[2] == U_o &&
-        p1[3] == U_t && p1[4] == U_e && p1[5] == U_c &&
-        p1[6] == U_t && p1[7] == U_e && p1[8] == U_d)
-        return TK_protected;
-    if (p1[0] == U_t && p1[1] == U_r && p1[2] == U_a &&
-        p1[3] == U_n && p1[4] == U_s && p1[5] == U_i &&
-        p1[6] == U_e && p1[7] == U_n && p1[8] == U_t)
-        return TK_transient;
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword10(const wchar_t* p1)
-{
-    if (p1[0] == U_i)
-    {
-        if (p1[1] == U_m && p1[2] == U_p && p1[3] == U_l &&
-            p1[4] == U_e && p1[5] == U_m && p1[6] == U_e &&
-            p1[7] == U_n && p1[8] == U_t && p1[9] == U_s)
-            return TK_implements;
-        if (p1[1] == U_n && p1[2] == U_s && p1[3] == U_t &&
-            p1[4] == U_a && p1[5] == U_n && p1[6] == U_c &&
-            p1[7] == U_e && p1[8] == U_o && p1[9] == U_f)
-            return TK_instanceof;
-    }
-    return TK_Identifier;
-}
-
-int Scanner::ScanKeyword12(const wchar_t* p1)
-{
-    if (p1[0] == U_s && p1[1] == U_y && p1[2] == U_n &&
-        p1[3] == U_c && p1[4] == U_h && p1[5] == U_r &&
-        p1[6] == U_o && p1[7] == U_n && p1[8] == U_i &&
-        p1[9] == U_z && p1[10] == U_e&& p1[11] == U_d)
-        return TK_synchronized;
-    return TK_Identifier;
-}
-
-
 //
 // This procedure is invoked to scan a character literal. After the character
 // literal has been scanned and classified, it is entered in the table with
@@ -743,7 +710,7 @@ void Scanner::ClassifyCharLiteral()
     //
     current_token -> SetKind(TK_CharacterLiteral);
     bool bad = false;
-    const wchar_t* ptr = cursor + 1;
+    const SourceChar* ptr = cursor + 1;
     switch (*ptr)
     {
     case U_SINGLE_QUOTE:
@@ -849,9 +816,7 @@ void Scanner::ClassifyCharLiteral()
     }
 
     ptr++;
-    current_token ->
-        SetSymbol(control.char_table.FindOrInsertLiteral(cursor,
-                                                         ptr - cursor));
+    SetLiteralSymbol(control.char_table, ptr - cursor);
     cursor = ptr;
 }
 
@@ -869,43 +834,45 @@ void Scanner::ClassifyStringLiteral()
     //
     current_token -> SetKind(TK_StringLiteral);
 
-    const wchar_t* ptr = cursor + 1;
+    const SourceChar* ptr = cursor + 1;
 
-    while (*ptr != U_DOUBLE_QUOTE && ! Code::IsNewline(*ptr))
+    for (;;)
     {
-        if (*ptr++ == U_BACKSLASH)
+        ptr = Skip::To(ptr, input_buffer_tail, U_DOUBLE_QUOTE, U_BACKSLASH,
+                       U_LINE_FEED, U_CARRIAGE_RETURN);
+        if (*ptr != U_BACKSLASH)
+            break;
+        ptr++;
+        switch (*ptr++)
         {
-            switch (*ptr++)
-            {
-            case U_b:
-            case U_f:
-            case U_n:
-            case U_r:
-            case U_t:
-            case U_SINGLE_QUOTE:
-            case U_DOUBLE_QUOTE:
-            case U_BACKSLASH:
-            case U_0:
-            case U_1:
-            case U_2:
-            case U_3:
-            case U_4:
-            case U_5:
-            case U_6:
-            case U_7:
-                break;
-            case U_u:
-                //
-                // By now, Unicode escapes have already been flattened; and it
-                // is illegal to try it twice (such as "\u005cu0000").
-                //
-            default:
-                ptr--;
-                lex -> ReportMessage(StreamError::INVALID_ESCAPE_SEQUENCE,
-                                     ptr - lex -> InputBuffer() - 1,
-                                     (ptr - lex -> InputBuffer() -
-                                      (Code::IsNewline(*ptr) ? 1 : 0)));
-            }
+        case U_b:
+        case U_f:
+        case U_n:
+        case U_r:
+        case U_t:
+        case U_SINGLE_QUOTE:
+        case U_DOUBLE_QUOTE:
+        case U_BACKSLASH:
+        case U_0:
+        case U_1:
+        case U_2:
+        case U_3:
+        case U_4:
+        case U_5:
+        case U_6:
+        case U_7:
+            break;
+        case U_u:
+            //
+            // By now, Unicode escapes have already been flattened; and it
+            // is illegal to try it twice (such as "\u005cu0000").
+            //
+        default:
+            ptr--;
+            lex -> ReportMessage(StreamError::INVALID_ESCAPE_SEQUENCE,
+                                 ptr - lex -> InputBuffer() - 1,
+                                 (ptr - lex -> InputBuffer() -
+                                  (Code::IsNewline(*ptr) ? 1 : 0)));
         }
     }
 
@@ -918,13 +885,41 @@ void Scanner::ClassifyStringLiteral()
     }
 
     ptr++;
-    current_token ->
-        SetSymbol(control.string_table.FindOrInsertLiteral(cursor,
-                                                           ptr - cursor));
+    SetLiteralSymbol(control.string_table, ptr - cursor);
     cursor = ptr;
 }
 
 
+//
+// Scan the name that starts at ptr, and return its end. The hash of the name
+// is taken on the way, as Hash::Function would, so that the name need not be
+// gone over again to look it up; and has_dollar is set if it has a '$'.
+//
+inline const SourceChar* Scanner::ScanName(const SourceChar* ptr,
+                                           unsigned& hash, bool& has_dollar)
+{
+    for (;;)
+    {
+        unsigned c = *ptr;
+        if (c < 128)
+        {
+            if (! ascii_name_part[c])
+                return ptr;
+            if (c == U_DS)
+                has_dollar = true;
+            hash = (hash << 5) - hash + c;
+            ptr++;
+        }
+        else if (Code::IsAlnum(ptr))
+        {
+            for (int n = Code::Codelength(ptr); n > 0; n--)
+                hash = (hash << 5) - hash + *ptr++;
+        }
+        else return ptr;
+    }
+}
+
+
 //
 // This procedure is invoked when CURSOR points to a letter which starts a
 // keyword. It scans the identifier and checks whether or not it is a keyword.
@@ -933,18 +928,12 @@ void Scanner::ClassifyStringLiteral()
 //
 void Scanner::ClassifyIdOrKeyword()
 {
-    const wchar_t* ptr = cursor + 1;
+    unsigned hash = 0;
     bool has_dollar = false;
-
-    while (Code::IsAlnum(ptr))
-    {
-        has_dollar = has_dollar || (*ptr == U_DS);
-        ptr += Code::Codelength(ptr);
-    }
+    const SourceChar* ptr = ScanName(cursor, hash, has_dollar);
     int len = ptr - cursor;
 
-    current_token -> SetKind(len < 13 ? (scan_keyword[len])(cursor)
-                             : TK_Identifier);
+    current_token -> SetKind(keywords.Find(cursor, len, hash));
 
     if (current_token -> Kind() == TK_assert &&
         control.option.source < JopaOption::SDK1_4)
@@ -973,7 +962,7 @@ void Scanner::ClassifyIdOrKeyword()
         control.option.source >= JopaOption::SDK1_8)
     {
         // Skip whitespace to find next non-space character
-        const wchar_t* lookahead = ptr;
+        const SourceChar* lookahead = ptr;
         while (Code::IsSpace(*lookahead))
             lookahead++;
 
@@ -995,11 +984,11 @@ void Scanner::ClassifyIdOrKeyword()
 
     if (current_token -> Kind() == TK_Identifier)
     {
-        current_token -> SetSymbol(control.FindOrInsertName(cursor, len));
+        SetNameSymbol(len, hash);
         for (unsigned i = 0; i < control.option.keyword_map.Length(); i++)
         {
             if (control.option.keyword_map[i].length == len &&
-                wcsncmp(cursor, control.option.keyword_map[i].name, len) == 0)
+                SameName(control.option.keyword_map[i].name, cursor, len))
             {
                 current_token -> SetKind(control.option.keyword_map[i].key);
             }
@@ -1027,15 +1016,9 @@ void Scanner::ClassifyIdOrKeyword()
 //
 void Scanner::ClassifyId()
 {
-    const wchar_t* ptr = cursor;
+    unsigned hash = 0;
     bool has_dollar = false;
-
-    while (Code::IsAlnum(ptr))
-    {
-        has_dollar = has_dollar || (*ptr == U_DS);
-        ptr += Code::Codelength(ptr);
-    }
-
+    const SourceChar* ptr = ScanName(cursor, hash, has_dollar);
     int len = ptr - cursor;
 
     if (has_dollar && ! dollar_warning_given)
@@ -1047,12 +1030,12 @@ void Scanner::ClassifyId()
     }
 
     current_token -> SetKind(TK_Identifier);
-    current_token -> SetSymbol(control.FindOrInsertName(cursor, len));
+    SetNameSymbol(len, hash);
 
     for (unsigned i = 0; i < control.option.keyword_map.Length(); i++)
     {
         if (control.option.keyword_map[i].length == len &&
-            wcsncmp(cursor, control.option.keyword_map[i].name, len) == 0)
+            SameName(control.option.keyword_map[i].name, cursor, len))
         {
             current_token -> SetKind(control.option.keyword_map[i].key);
         }
@@ -1072,8 +1055,8 @@ void Scanner::ClassifyNumericLiteral()
     // Scan the initial sequence of digits, if any.
     // Java 7: Allow underscores in numeric literals
     //
-    const wchar_t* ptr = cursor - 1;
-    const wchar_t* tmp;
+    const SourceChar* ptr = cursor - 1;
+    const SourceChar* tmp;
     while (Code::IsDecimalDigit(*++ptr) || *ptr == U_UNDERSCORE)
     {
         if (*ptr == U_UNDERSCORE)
@@ -1122,7 +1105,7 @@ void Scanner::ClassifyNumericLiteral()
                     if (*ptr == U_UNDERSCORE)
                     {
                         // Skip underscore but check for consecutive/trailing underscores
-                        const wchar_t* next = ptr + 1;
+                        const SourceChar* next = ptr + 1;
                         if (*next == U_UNDERSCORE ||
                             (!Code::IsBinaryDigit(*next) && *next != U_l && *next != U_L))
                         {
@@ -1147,7 +1130,7 @@ void Scanner::ClassifyNumericLiteral()
                     if (*ptr == U_UNDERSCORE)
                     {
                         // Skip underscore
-                        const wchar_t* next = ptr + 1;
+                        const SourceChar* next = ptr + 1;
                         if (*next == U_UNDERSCORE ||
                             (!Code::IsHexDigit(*next) && *next != U_DOT &&
                              *next != U_p && *next != U_P &&
@@ -1292,15 +1275,13 @@ void Scanner::ClassifyNumericLiteral()
     if (*ptr == U_f || *ptr == U_F)
     {
         len = ++ptr - cursor;
-        current_token ->
-            SetSymbol(control.float_table.FindOrInsertLiteral(cursor, len));
+        SetLiteralSymbol(control.float_table, len);
         current_token -> SetKind(TK_FloatLiteral);
     }
     else if (*ptr == U_d || *ptr == U_D)
     {
         len = ++ptr - cursor;
-        current_token ->
-            SetSymbol(control.double_table.FindOrInsertLiteral(cursor, len));
+        SetLiteralSymbol(control.double_table, len);
         current_token -> SetKind(TK_DoubleLiteral);
     }
     else if (current_token -> Kind() == TK_IntegerLiteral)
@@ -1315,23 +1296,20 @@ void Scanner::ClassifyNumericLiteral()
             }
             
             len = ++ptr - cursor;
-            current_token ->
-                SetSymbol(control.long_table.FindOrInsertLiteral(cursor, len));
+            SetLiteralSymbol(control.long_table, len);
             current_token -> SetKind(TK_LongLiteral);
         }
         else
         {
             len = ptr - cursor;
-            current_token ->
-                SetSymbol(control.int_table.FindOrInsertLiteral(cursor, len));
+            SetLiteralSymbol(control.int_table, len);
         }
     }
     else
     {
         assert(current_token -> Kind() == TK_DoubleLiteral);
         len = ptr - cursor;
-        current_token ->
-            SetSymbol(control.double_table.FindOrInsertLiteral(cursor, len));
+        SetLiteralSymbol(control.double_table, len);
     }
     cursor = ptr;
 }
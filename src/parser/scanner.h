@@ -7,6 +7,7 @@
 namespace Jopa { // Open namespace Jopa block
 class Control;
 class FileSymbol;
+class LiteralLookupTable;
 
 //
 // The Scanner object
@@ -21,33 +22,70 @@ public:
     void SetUp(FileSymbol*);
     void Scan(FileSymbol*);
 
+    void ScanDeferred(FileSymbol*);
+    void Resolve(LexStream*);
+
+    void ScanPackage(FileSymbol*);
+
 private:
     Control& control;
 
     LexStream* lex;
-    const wchar_t* cursor;
-    const wchar_t* input_buffer_tail;
+    const SourceChar* cursor;
+    const SourceChar* input_buffer_tail;
     bool dollar_warning_given;
     bool deprecated; // true if the next token should be marked deprecated
+    bool defer_symbols; // set by ScanDeferred
 
     LexStream::Token* current_token;
     TokenIndex current_token_index;
 
     void Initialize(FileSymbol*);
     void Scan();
+    void Finish(LexStream*);
+    static inline bool SameName(const wchar_t*, const SourceChar*, int);
+
+    inline void SetNameSymbol(unsigned, unsigned);
+    inline void SetLiteralSymbol(LiteralLookupTable&, unsigned);
+
+    //
+    // The keywords, found by a perfect hash of the hash of their name (see
+    // Hash::Function), which the scanner computes for the name table as it
+    // scans an identifier.
+    //
+    class KeywordTable
+    {
+    public:
+        KeywordTable();
+
+        //
+        // The kind of keyword the name is, or TK_Identifier.
+        //
+        inline int Find(const SourceChar*, int, unsigned hash) const;
+
+    private:
+        enum { MAX_BITS = 10 };
+
+        struct Slot
+        {
+            const wchar_t* name;
+            int length; // 0 if the slot is empty
+            int kind;
+        };
+
+        u4 multiplier;
+        int shift;
+        Slot slots[1 << MAX_BITS];
+    };
+
+    static const KeywordTable keywords;
+
+    //
+    // Whether each ASCII character may be part of an identifier.
+    //
+    bool ascii_name_part[128];
 
-    static int (*scan_keyword[13]) (const wchar_t* p1);
-    static int ScanKeyword0(const wchar_t* p1);
-    static int ScanKeyword2(const wchar_t* p1);
-    static int ScanKeyword3(const wchar_t* p1);
-    static int ScanKeyword4(const wchar_t* p1);
-    static int ScanKeyword5(const wchar_t* p1);
-    static int ScanKeyword6(const wchar_t* p1);
-    static int ScanKeyword7(const wchar_t* p1);
-    static int ScanKeyword8(const wchar_t* p1);
-    static int ScanKeyword9(const wchar_t* p1);
-    static int ScanKeyword10(const wchar_t* p1);
-    static int ScanKeyword12(const wchar_t* p1);
+    inline const SourceChar* ScanName(const SourceChar*, unsigned&, bool&);
 
     inline void SkipSpaces();
     void ScanSlashComment();
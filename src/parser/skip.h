@@ -0,0 +1,92 @@
+#pragma once
+
+#include "platform.h"
+
+//
+// With SSE2, which every x86-64 has, the input is searched eight code units
+// at a time.
+//
+#if defined(__SSE2__)
+# define JOPA_SKIP_SSE2
+# include <emmintrin.h>
+#endif
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+//
+// The scanner spends most of its time going over the insides of comments,
+// string literals and white space, looking for the few characters that end
+// them. These search the input buffer for such characters a vector at a
+// time; end must not be past the U_NULL that ends the buffer.
+//
+class Skip
+{
+public:
+    //
+    // The first character in [p, end) that is one of chars, or end.
+    //
+    template <typename... Chars>
+    static inline const SourceChar* To(const SourceChar* p,
+                                       const SourceChar* end, Chars... chars)
+    {
+#ifdef JOPA_SKIP_SSE2
+        for ( ; p + 8 <= end; p += 8)
+        {
+            int mask = Matches(p, chars...);
+            if (mask)
+                return p + __builtin_ctz(mask) / 2;
+        }
+#endif
+        for ( ; p < end; p++)
+        {
+            if (((*p == (SourceChar) chars) || ...))
+                return p;
+        }
+        return end;
+    }
+
+    //
+    // The first character in [p, end) that is none of chars, or end.
+    //
+    template <typename... Chars>
+    static inline const SourceChar* Past(const SourceChar* p,
+                                         const SourceChar* end,
+                                         Chars... chars)
+    {
+#ifdef JOPA_SKIP_SSE2
+        for ( ; p + 8 <= end; p += 8)
+        {
+            int mask = Matches(p, chars...) ^ 0xFFFF;
+            if (mask)
+                return p + __builtin_ctz(mask) / 2;
+        }
+#endif
+        for ( ; p < end; p++)
+        {
+            if (! ((*p == (SourceChar) chars) || ...))
+                return p;
+        }
+        return end;
+    }
+
+private:
+#ifdef JOPA_SKIP_SSE2
+    //
+    // Two bits for each of the eight code units at p that is one of chars.
+    //
+    template <typename... Chars>
+    static inline int Matches(const SourceChar* p, Chars... chars)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i hit = _mm_setzero_si128();
+        ((hit = _mm_or_si128(hit, _mm_cmpeq_epi16(v, _mm_set1_epi16(chars)))),
+         ...);
+        return _mm_movemask_epi8(hit);
+    }
+#endif
+};
+
+
+} // Close namespace Jopa block
@@ -7,6 +7,8 @@
 #include "grammar/javasym.h"
 #include "option.h"
 #include "tab.h"
+#include "memacct.h"
+#include "widen.h"
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -231,7 +233,7 @@ wchar_t Stream::DecodeNextCharacter()
 # if defined(HAVE_LIBICU_UC)
 
     if (!HaveDecoder())
-        return (wchar_t) *source_ptr++;
+        return (wchar_t) ((*source_ptr++) & 0x00FF); // see below
 
     UErrorCode err = U_ZERO_ERROR;
     next = ucnv_getNextUChar(_decoder, &source_ptr, source_tail + 1, &err);
@@ -324,9 +326,7 @@ wchar_t Stream::DecodeNextCharacter()
 
 LexStream::LexStream(Control& control_, FileSymbol* file_symbol_)
     : file_symbol(file_symbol_),
-#ifdef JOPA_DEBUG
       file_read(false),
-#endif
       index(0),
       tokens(NULL),
       token_stream(12, 16),
@@ -337,6 +337,7 @@ LexStream::LexStream(Control& control_, FileSymbol* file_symbol_)
       package(0),
       initial_reading_of_input(true),
       comment_buffer(NULL),
+      accounted(0),
       control(control_)
 {
     StreamError::emacs_style_report = ! control_.option.errors;
@@ -344,12 +345,11 @@ LexStream::LexStream(Control& control_, FileSymbol* file_symbol_)
 
 LexStream::~LexStream()
 {
-#ifdef JOPA_DEBUG
     if (file_read)
         control.line_count += (line_location.Length() - 3);
-#endif
 
     DestroyInput();
+    MemoryAccount::Free(MemoryAccount::LEX, accounted);
 }
 
 
@@ -474,24 +474,24 @@ unsigned LexStream::RightColumn(TokenIndex i)
 {
     if (! input_buffer)
         return 0;
-    unsigned location = tokens[i].Location() - 1 +
-        (NameSymbol(i) || LiteralSymbol(i)
-         ? tokens[i].additional_info.symbol -> NameLength()
-         : wcslen(KeywordName(tokens[i].Kind())));
+    unsigned location = tokens[i].Location() - 1 + NameStringLength(i);
     return FindColumn(location);
 }
 
 const wchar_t* LexStream::NameString(TokenIndex i)
 {
-    return NameSymbol(i) || LiteralSymbol(i)
-        ? tokens[i].additional_info.symbol -> Name()
-        : KeywordName(tokens[i].Kind());
+    Symbol* symbol = NameSymbol(i);
+    if (! symbol)
+        symbol = LiteralSymbol(i);
+    return symbol ? symbol -> Name() : KeywordName(tokens[i].Kind());
 }
 
 unsigned LexStream::NameStringLength(TokenIndex i)
 {
-    return NameSymbol(i) || LiteralSymbol(i)
-        ? tokens[i].additional_info.symbol -> NameLength()
+    Symbol* symbol = NameSymbol(i);
+    if (! symbol)
+        symbol = LiteralSymbol(i);
+    return symbol ? symbol -> NameLength()
         : wcslen(KeywordName(tokens[i].Kind()));
 }
 
@@ -515,22 +515,48 @@ unsigned LexStream::LineSegmentLength(TokenIndex i)
 class LiteralSymbol* LexStream::LiteralSymbol(TokenIndex i)
 {
     assert(i < (unsigned) token_stream.Length());
-    Symbol* symbol = tokens[i].additional_info.symbol;
-    return (symbol && Kind(i) != TK_LBRACE)
-        ? symbol -> LiteralCast() : (class LiteralSymbol*) NULL;
+    unsigned symbol = tokens[i].additional_info.symbol;
+    if (! symbol)
+        return NULL;
+    LiteralLookupTable* table;
+    switch (Kind(i))
+    {
+    case TK_IntegerLiteral: table = &control.int_table; break;
+    case TK_LongLiteral: table = &control.long_table; break;
+    case TK_FloatLiteral: table = &control.float_table; break;
+    case TK_DoubleLiteral: table = &control.double_table; break;
+    case TK_CharacterLiteral: table = &control.char_table; break;
+    case TK_StringLiteral: table = &control.string_table; break;
+    default:
+        return NULL;
+    }
+    return table -> symbol_pool[symbol - 1];
 }
 
 
 //
-// If the token represents a literal, this returns the name symbol
-// associated with it.
+// If the token represents an identifier, this returns the name symbol
+// associated with it. That includes an identifier that -K made a keyword
+// of: every token but a literal or a brace that has a symbol has a name.
 //
 class NameSymbol* LexStream::NameSymbol(TokenIndex i)
 {
     assert(i < (unsigned) token_stream.Length());
-    Symbol* symbol = tokens[i].additional_info.symbol;
-    return (symbol && Kind(i) != TK_LBRACE)
-        ? symbol -> NameCast() : (class NameSymbol*) NULL;
+    unsigned symbol = tokens[i].additional_info.symbol;
+    switch (Kind(i))
+    {
+    case TK_LBRACE:
+    case TK_IntegerLiteral:
+    case TK_LongLiteral:
+    case TK_FloatLiteral:
+    case TK_DoubleLiteral:
+    case TK_CharacterLiteral:
+    case TK_StringLiteral:
+        return NULL;
+    default:
+        return symbol ? control.name_table.symbol_pool[symbol - 1]
+            : (class NameSymbol*) NULL;
+    }
 }
 
 
@@ -553,6 +579,24 @@ void LexStream::CompressSpace()
     comments = comment_stream.Array();
     locations = line_location.Array();
     types = type_index.Array();
+    Account();
+}
+
+
+//
+// Bring MemoryAccount up to date with the input and token buffers held.
+//
+void LexStream::Account()
+{
+    size_t bytes = TokenSpaceAllocated() + CommentSpaceAllocated() +
+        line_location.Length() * sizeof(unsigned) +
+        type_index.Length() * sizeof(TokenIndex);
+    if (input_buffer)
+        bytes += (input_buffer_length + 3) * sizeof(SourceChar);
+    if (bytes > accounted)
+        MemoryAccount::Allocate(MemoryAccount::LEX, bytes - accounted);
+    else MemoryAccount::Free(MemoryAccount::LEX, accounted - bytes);
+    accounted = bytes;
 }
 
 
@@ -711,12 +755,13 @@ void LexStream::ReadInput()
     {
         ZipFile* zipfile = new ZipFile(file_symbol);
 
+        //
+        // Without a buffer the entry is corrupt, or compressed in a way we
+        // cannot read: the file is then reported as unreadable, like one on
+        // disk.
+        //
         if (zipfile -> Buffer() == NULL)
-        {
-            fprintf(stderr, "chaos: Don\'t know how to process compressed "
-                    "(\".java\") source in a zip file\n");
-            assert(false);
-        }
+            errno = EIO;
         else if (! file_symbol -> lex_stream)
         {
             // Once the zip file is loaded, it never changes. So, we only read
@@ -732,7 +777,7 @@ void LexStream::ReadInput()
         struct stat status;
         JopaAPI::getInstance() -> stat(FileName(), &status);
 
-        file_symbol -> mtime = status.st_mtime; // actual time stamp of file read
+        file_symbol -> SetMtime(status.st_mtime); // actual time stamp of file read
         file_symbol -> lex_stream = this;
 
 
@@ -756,14 +801,9 @@ void LexStream::RereadInput()
     {
         ZipFile* zipfile = new ZipFile(file_symbol);
 
-        if (zipfile -> Buffer() == NULL)
-        {
-            fprintf(stderr, "chaos: Don\'t know how to process compressed "
-                    "(\".java\") source in a zip file\n");
-            assert(false);
-        }
-        else ProcessInput(zipfile -> Buffer(),
-                          file_symbol -> uncompressed_size);
+        if (zipfile -> Buffer())
+            ProcessInput(zipfile -> Buffer(),
+                         file_symbol -> uncompressed_size);
         delete zipfile;
     }
     else
@@ -771,7 +811,7 @@ void LexStream::RereadInput()
         struct stat status;
         JopaAPI::getInstance() -> stat(FileName(), &status);
 
-        if (status.st_mtime == file_symbol -> mtime)
+        if (status.st_mtime == file_symbol -> Mtime())
         {
            JopaAPI::FileReader* file =
                JopaAPI::getInstance() -> read(FileName());
@@ -786,6 +826,7 @@ void LexStream::RereadInput()
             // TODO: File has changed !!!
         }
     }
+    Account();
 }
 
 
@@ -830,11 +871,9 @@ void LexStream::ProcessInput(const char* buffer, long filesize)
 
 void LexStream::ProcessInputAscii(const char* buffer, long filesize)
 {
-#ifdef JOPA_DEBUG
     file_read = true;
-#endif
 
-    wchar_t* input_ptr = AllocateInputBuffer(filesize);
+    SourceChar* input_ptr = AllocateInputBuffer(filesize);
     *input_ptr = U_LINE_FEED; // Add an initial '\n' for correct line numbers.
 
     if (buffer)
@@ -843,6 +882,17 @@ void LexStream::ProcessInputAscii(const char* buffer, long filesize)
 
         while (source_ptr <= source_tail)
         {
+            //
+            // Copy the run of bytes that need no attention in one go.
+            //
+            size_t n = Widen::PlainBytes(source_ptr,
+                                         source_tail - source_ptr + 1,
+                                         input_ptr + 1);
+            source_ptr += n;
+            input_ptr += n;
+            if (source_ptr > source_tail)
+                break;
+
             // The (& 0x00ff) guarantees that quantity is unsigned value.
             *(++input_ptr) = (*source_ptr++) & 0x00ff;
 
@@ -967,21 +1017,38 @@ void LexStream::ProcessInputAscii(const char* buffer, long filesize)
 
 #if defined(HAVE_ENCODING)
 
+//
+// Put the decoded character ch after ptr in the input buffer, and advance
+// ptr past it: as one code unit, or as a surrogate pair if ch is outside
+// the Basic Multilingual Plane.
+//
+static inline void Append(SourceChar*& ptr, wchar_t ch)
+{
+    u4 c = (u4) ch;
+    if (c < 0x10000)
+        *(++ptr) = (SourceChar) c;
+    else
+    {
+        c -= 0x10000;
+        *(++ptr) = (SourceChar) (0xd800 + (c >> 10));
+        *(++ptr) = (SourceChar) (0xdc00 + (c & 0x3ff));
+    }
+}
+
+
 void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
 {
     //fprintf(stderr,"LexStream::ProcessInputUnicode called.\n");
-#ifdef JOPA_DEBUG
     file_read = true;
-#endif
 
-    wchar_t* input_ptr = AllocateInputBuffer(filesize);
-    wchar_t* input_tail = input_ptr + filesize;
+    SourceChar* input_ptr = AllocateInputBuffer(filesize);
+    SourceChar* input_tail = input_ptr + filesize;
     *input_ptr = U_LINE_FEED; // add an initial '\n';
 
     if (buffer)
     {
         int escape_value = 0;
-        wchar_t* escape_ptr = NULL;
+        SourceChar* escape_ptr = NULL;
         UnicodeLexerState saved_state = RAW;
         UnicodeLexerState state = START;
         bool oncemore = false;
@@ -1017,14 +1084,32 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 // slow down compilation a bit.
                 size_t cursize = input_ptr - input_buffer;
                 size_t newsize = cursize + cursize / 10 + 4; // add 10%
-                wchar_t* tmp = new wchar_t[newsize];
-                memcpy(tmp, input_buffer, cursize * sizeof(wchar_t));
+                SourceChar* tmp = new SourceChar[newsize];
+                memcpy(tmp, input_buffer, cursize * sizeof(SourceChar));
                 delete [] input_buffer;
                 input_buffer = tmp;
                 input_tail = input_buffer + newsize - 1;
                 input_ptr  = input_buffer + cursize;
             }
 
+            //
+            // Without a decoder, a run of bytes that RAW would just copy is
+            // copied in one go.
+            //
+            if (state == RAW && ! oncemore && ! HaveDecoder())
+            {
+                size_t n = Widen::PlainBytes(source_ptr,
+                                             source_tail - source_ptr + 1,
+                                             input_ptr + 1);
+                if (n)
+                {
+                    source_ptr += n;
+                    input_ptr += n;
+                    saved_state = RAW;
+                    continue;
+                }
+            }
+
             if (! oncemore)
             {
                 ch = DecodeNextCharacter();
@@ -1060,7 +1145,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 }
                 break;
             case UNICODE_ESCAPE:
-                *(++input_ptr) = ch;
+                Append(input_ptr, ch);
                 if (Code::IsHexDigit(ch))
                 {
                     state = UNICODE_ESCAPE_DIGIT_0;
@@ -1077,7 +1162,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 }
                 break;
             case UNICODE_ESCAPE_DIGIT_0:
-                *(++input_ptr) = ch;
+                Append(input_ptr, ch);
                 if (Code::IsHexDigit(ch))
                 {
                     state = UNICODE_ESCAPE_DIGIT_1;
@@ -1094,7 +1179,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 }
                 break;
             case UNICODE_ESCAPE_DIGIT_1:
-                *(++input_ptr) = ch;
+                Append(input_ptr, ch);
                 if (Code::IsHexDigit(ch))
                 {
                     state = UNICODE_ESCAPE_DIGIT_2;
@@ -1120,7 +1205,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 }
                 else
                 {
-                    *(++input_ptr) = ch;
+                    Append(input_ptr, ch);
                     if (initial_reading_of_input)
                         ReportMessage(StreamError::INVALID_UNICODE_ESCAPE,
                                       (unsigned) (escape_ptr - input_buffer),
@@ -1151,7 +1236,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 else
                 {
                     state = RAW;
-                    *(++input_ptr) = ch;
+                    Append(input_ptr, ch);
                 }
                 // clear saved_state == UNICODE_ESCAPE_DIGIT_2 status
                 saved_state = CR;
@@ -1175,7 +1260,7 @@ void LexStream::ProcessInputUnicode(const char* buffer, long filesize)
                 }
                 else
                 {
-                    *(++input_ptr) = ch;
+                    Append(input_ptr, ch);
                 }
                 saved_state = RAW;
                 break;
@@ -1226,6 +1311,32 @@ void LexStream::ReportMessage(StreamError::StreamErrorKind kind,
     }
 }
 
+bool LexStream::HasMessage(StreamError::StreamErrorKind kind)
+{
+    for (unsigned i = 0; i < bad_tokens.Length(); i++)
+        if (bad_tokens[i].kind == kind)
+            return true;
+    return false;
+}
+
+//
+// Remove the first message of the given kind, keeping the others in order.
+//
+void LexStream::RemoveMessage(StreamError::StreamErrorKind kind)
+{
+    unsigned length = bad_tokens.Length();
+    for (unsigned i = 0; i < length; i++)
+    {
+        if (bad_tokens[i].kind == kind)
+        {
+            for ( ; i + 1 < length; i++)
+                bad_tokens[i] = bad_tokens[i + 1];
+            bad_tokens.Reset(length - 1);
+            return;
+        }
+    }
+}
+
 //
 // This procedure uses a  quick sort algorithm to sort the stream ERRORS
 // by their locations.
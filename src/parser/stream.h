@@ -98,13 +98,13 @@ public:
         input_buffer = NULL;
     }
 
-    inline const wchar_t* InputBuffer() { return input_buffer; }
+    inline const SourceChar* InputBuffer() { return input_buffer; }
     inline unsigned InputBufferLength() { return input_buffer_length; }
 
-    inline wchar_t* AllocateInputBuffer(unsigned size)
+    inline SourceChar* AllocateInputBuffer(unsigned size)
     {
         // +3 for leading \n, trailing \r\0
-        return input_buffer = new wchar_t[size + 3];
+        return input_buffer = new SourceChar[size + 3];
     }
 
 #if defined(HAVE_ENCODING)
@@ -114,7 +114,11 @@ public:
 
 protected:
 
-    wchar_t* input_buffer;
+    //
+    // The decoded file, in UTF-16 code units: half the size of wchar_t on
+    // most hosts, and the units that class files and Java strings use.
+    //
+    SourceChar* input_buffer;
     unsigned input_buffer_length;
 
     const char* source_ptr;    // Start of data buffer to decoded
@@ -342,9 +346,7 @@ public:
         return bad_tokens.Length() - NumBadTokens();
     }
 
-#ifdef JOPA_DEBUG
     bool file_read;
-#endif
 
     //
     // Constructors and Destructor.
@@ -360,6 +362,7 @@ public:
 
         delete [] comment_buffer;
         comment_buffer = NULL;
+        Account();
     }
 
     void ReportMessage(StreamError::StreamErrorKind,
@@ -386,10 +389,10 @@ public:
         wchar_t* ptr = comment_buffer;
         for (i = 1; i < comment_stream.Length(); i++)
         {
-            memcpy(ptr, &(input_buffer[comments[i].location]),
-                   comments[i].length * sizeof(wchar_t));
+            const SourceChar* text = &(input_buffer[comments[i].location]);
             comments[i].string = ptr;
-            ptr += comments[i].length;
+            for (unsigned k = 0; k < comments[i].length; k++)
+                *ptr++ = text[k];
             *ptr++ = U_NULL;
         }
     }
@@ -466,6 +469,12 @@ private:
         wchar_t* string;
     };
 
+    //
+    // A token is two words. The second holds the symbol of an identifier or
+    // a literal as its index in the symbol_pool of the table the kind of the
+    // token names, plus one, so that 0 is no symbol; a pointer would double
+    // the size of every token on a 64-bit host.
+    //
     class Token
     {
         //
@@ -488,8 +497,9 @@ private:
         unsigned info;
         union
         {
-            Symbol* symbol;
+            unsigned symbol;
             TokenIndex right_brace;
+            unsigned length; // until Scanner::Resolve supplies the symbol
         } additional_info;
 
         //
@@ -500,7 +510,7 @@ private:
         {
             assert(location <= 0x00FFFFFF);
             info = (location << 8);
-            additional_info.symbol = NULL;
+            additional_info.symbol = 0;
         }
 
         inline unsigned Location() { return info >> 8; }
@@ -514,14 +524,18 @@ private:
         inline void SetDeprecated() { info |= 0x00000080; }
         inline bool Deprecated() { return (info & 0x00000080) != 0; }
 
-        inline void SetSymbol(Symbol* symbol)
+        inline void SetSymbol(int index)
         {
-            additional_info.symbol = symbol;
+            additional_info.symbol = index + 1;
         }
         inline void SetRightBrace(TokenIndex rbrace)
         {
             additional_info.right_brace = rbrace;
         }
+        inline void SetLength(unsigned length)
+        {
+            additional_info.length = length;
+        }
     };
 
     TokenIndex GetNextToken(unsigned location = 0)
@@ -557,11 +571,16 @@ private:
     Tuple<TokenIndex> default_method_tokens;
 
     void CompressSpace();
+    bool HasMessage(StreamError::StreamErrorKind);
+    void RemoveMessage(StreamError::StreamErrorKind);
 
     bool initial_reading_of_input;
 
     wchar_t* comment_buffer;
 
+    size_t accounted; // bytes noted with MemoryAccount
+    void Account();
+
     Control& control;
 
     void ReadInput();
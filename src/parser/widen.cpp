@@ -0,0 +1,122 @@
+#include "widen.h"
+
+#ifdef JOPA_WIDEN_SIMD
+# include <immintrin.h>
+#endif
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+size_t Widen::PlainBytes(const char* source, size_t length,
+                         SourceChar* target)
+{
+#ifdef JOPA_WIDEN_SIMD
+    static const bool avx2 = HaveAvx2();
+    return avx2 ? PlainBytesAvx2(source, length, target)
+        : PlainBytesSse2(source, length, target);
+#else
+    return PlainBytesScalar(source, length, target);
+#endif
+}
+
+
+size_t Widen::PlainBytesScalar(const char* source, size_t length,
+                               SourceChar* target)
+{
+    size_t i;
+    for (i = 0; i < length; i++)
+    {
+        u1 ch = source[i];
+        if (ch >= 0x80 || ch == U_BACKSLASH || ch == U_CARRIAGE_RETURN)
+            break;
+        target[i] = ch;
+    }
+    return i;
+}
+
+
+#ifdef JOPA_WIDEN_SIMD
+
+//
+// A byte needs the scalar pass if it is a backslash or a carriage return,
+// or has its top bit set; movemask gathers the top bit of each byte, so the
+// bytes themselves can be or-ed into the comparisons.
+//
+size_t Widen::PlainBytesSse2(const char* source, size_t length,
+                             SourceChar* target)
+{
+    const __m128i backslash = _mm_set1_epi8(U_BACKSLASH);
+    const __m128i carriage_return = _mm_set1_epi8(U_CARRIAGE_RETURN);
+    const __m128i zero = _mm_setzero_si128();
+
+    size_t i = 0;
+    for ( ; i + 16 <= length; i += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i*) (source + i));
+        __m128i special =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, backslash),
+                                      _mm_cmpeq_epi8(bytes, carriage_return)),
+                         bytes);
+        if (_mm_movemask_epi8(special))
+            break; // the scalar loop copies up to the byte
+
+        __m128i* out = (__m128i*) (target + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi8(bytes, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(bytes, zero));
+    }
+    return i + PlainBytesScalar(source + i, length - i, target + i);
+}
+
+
+__attribute__((target("avx2")))
+size_t Widen::PlainBytesAvx2(const char* source, size_t length,
+                             SourceChar* target)
+{
+    const __m256i backslash = _mm256_set1_epi8(U_BACKSLASH);
+    const __m256i carriage_return = _mm256_set1_epi8(U_CARRIAGE_RETURN);
+
+    size_t i = 0;
+    for ( ; i + 32 <= length; i += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i*) (source + i));
+        __m256i special =
+            _mm256_or_si256(_mm256_or_si256(
+                                _mm256_cmpeq_epi8(bytes, backslash),
+                                _mm256_cmpeq_epi8(bytes, carriage_return)),
+                            bytes);
+        if (_mm256_movemask_epi8(special))
+            break; // the scalar loop copies up to the byte
+
+        __m256i* out = (__m256i*) (target + i);
+        _mm256_storeu_si256(out, _mm256_cvtepu8_epi16(
+                                _mm256_castsi256_si128(bytes)));
+        _mm256_storeu_si256(out + 1, _mm256_cvtepu8_epi16(
+                                _mm256_extracti128_si256(bytes, 1)));
+    }
+
+    //
+    // Not PlainBytesSse2: going from AVX to legacy SSE code costs more than
+    // the last few bytes are worth.
+    //
+    for ( ; i < length; i++)
+    {
+        u1 ch = source[i];
+        if (ch >= 0x80 || ch == U_BACKSLASH || ch == U_CARRIAGE_RETURN)
+            break;
+        target[i] = ch;
+    }
+    return i;
+}
+
+
+bool Widen::HaveAvx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // JOPA_WIDEN_SIMD
+
+
+} // Close namespace Jopa block
+
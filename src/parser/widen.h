@@ -0,0 +1,52 @@
+#pragma once
+
+#include "platform.h"
+
+
+//
+// The vector kernels want SSE2, which every x86-64 has; AVX2 is used as
+// well where the host has it.
+//
+#if defined(__SSE2__) && defined(__GNUC__)
+# define JOPA_WIDEN_SIMD
+#endif
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+//
+// The first pass over the input (LexStream::ProcessInput) only has work to
+// do at a backslash, which may start a unicode escape, and a carriage
+// return, which becomes a line feed; any other byte is copied to the input
+// buffer as it is. PlainBytes copies the run of such bytes at the head of
+// the source a vector at a time, and stops at the first byte that needs
+// the scalar pass. A byte outside ASCII stops it too, so that the run means
+// the same character with or without a decoder.
+//
+class Widen
+{
+public:
+    //
+    // Copy the bytes at the head of source, up to the first backslash,
+    // carriage return or non-ASCII byte, or the end, to target as code
+    // units. Returns how many bytes were copied.
+    //
+    static size_t PlainBytes(const char* source, size_t length,
+                             SourceChar* target);
+
+    //
+    // The kernels that PlainBytes picks from, the fastest this host has;
+    // they are exposed for bench/widen.cpp.
+    //
+    static size_t PlainBytesScalar(const char*, size_t, SourceChar*);
+#ifdef JOPA_WIDEN_SIMD
+    static size_t PlainBytesSse2(const char*, size_t, SourceChar*);
+    static size_t PlainBytesAvx2(const char*, size_t, SourceChar*);
+    static bool HaveAvx2();
+#endif
+};
+
+
+} // Close namespace Jopa block
+
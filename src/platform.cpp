@@ -1362,7 +1362,7 @@ const char StringConstant::U8S_help_header[] =
     "Licensed Materials. Program Property of IBM. All Rights Reserved.\n"
     "Dragons. Cluster lizards. Hippity Hoppity of 7mind. Sanity not preserved.\n";
 const char StringConstant::U8S_command_format[] =
-    "use: jopa [options] [@files] file.java...\n";
+    "use: jopa [options] [@files] {file.java | sources.jar}...\n";
 
 //
 // Constant pool entries.
@@ -185,6 +185,11 @@ typedef uint64_t u8;
 typedef int64_t i8;
 #endif // HAVE_64BIT_TYPES
 typedef u4 TokenIndex;
+//
+// A UTF-16 code unit, as a source file is held for the scanner. A character
+// outside the Basic Multilingual Plane takes a surrogate pair.
+//
+typedef u2 SourceChar;
 static const TokenIndex BAD_TOKEN = (TokenIndex) 0;
 
 // Rename for readability in double.h.
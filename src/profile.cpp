@@ -0,0 +1,352 @@
+#include "profile.h"
+#include "memacct.h"
+#include "symbol.h"
+
+#include <algorithm>
+#include <time.h>
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+Profiler::Profiler(bool trace_)
+    : main_thread(std::this_thread::get_id())
+    , wall_start(std::chrono::steady_clock::now())
+    , cpu_start(ProcessTime())
+    , wall_mark(wall_start)
+    , cpu_mark(ThreadTime())
+    , trace(trace_)
+{
+    threads[main_thread] = 1;
+}
+
+
+u8 Profiler::ThreadTime()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+        return 0;
+    return (u8) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+u8 Profiler::ProcessTime()
+{
+    struct timespec now;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now) != 0)
+        return 0;
+    return (u8) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+const char* Profiler::Name(PhaseKind kind)
+{
+    static const char* names[NUM_PHASES] =
+    {
+        "startup", "scan", "parse", "headers", "members", "bodies",
+        "codegen", "stackmap", "write", "read_class"
+    };
+    return names[kind];
+}
+
+
+//
+// Charge the time since the last mark to the innermost phase of the main
+// thread, and to the innermost unit.
+//
+void Profiler::Charge()
+{
+    std::chrono::steady_clock::time_point wall = std::chrono::steady_clock::now();
+    u8 cpu = ThreadTime();
+    if (! stack.empty())
+    {
+        u8 wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>
+            (wall - wall_mark).count();
+        u8 cpu_time = cpu - cpu_mark;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Time& phase = phases[stack.back() -> kind];
+        phase.wall += wall_time;
+        phase.cpu += cpu_time;
+        if (stack.back() -> unit)
+        {
+            Time& unit = units[stack.back() -> unit];
+            unit.wall += wall_time;
+            unit.cpu += cpu_time;
+        }
+    }
+    wall_mark = wall;
+    cpu_mark = cpu;
+}
+
+
+void Profiler::Start(Phase& phase, PhaseKind kind, FileSymbol* unit,
+                     const char* name)
+{
+    phase.kind = kind;
+    phase.name = name;
+    phase.nested = std::this_thread::get_id() == main_thread;
+    if (phase.nested)
+    {
+        Charge();
+        phase.unit = (unit || stack.empty() ? unit : stack.back() -> unit);
+        phase.wall_start = wall_mark;
+        stack.push_back(&phase);
+        MemoryAccount::SetPhase(kind);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        phases[kind].calls++;
+    }
+    else
+    {
+        phase.unit = unit;
+        phase.wall_start = std::chrono::steady_clock::now();
+        phase.cpu_start = ThreadTime();
+    }
+}
+
+
+void Profiler::Stop(Phase& phase)
+{
+    std::chrono::steady_clock::time_point wall;
+    u8 wall_time = 0;
+    u8 cpu_time = 0;
+    if (phase.nested)
+    {
+        assert(stack.back() == &phase);
+        Charge();
+        stack.pop_back();
+        MemoryAccount::SetPhase(stack.empty() ? NUM_PHASES
+                                : stack.back() -> kind);
+        if (! trace)
+            return;
+        wall = wall_mark;
+    }
+    else
+    {
+        wall = std::chrono::steady_clock::now();
+        wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>
+            (wall - phase.wall_start).count();
+        cpu_time = ThreadTime() - phase.cpu_start;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (trace)
+    {
+        Span span;
+        span.kind = phase.kind;
+        std::map<std::thread::id, unsigned>::iterator thread =
+            threads.insert(std::make_pair(std::this_thread::get_id(),
+                                          threads.size() + 1)).first;
+        span.thread = thread -> second;
+        span.start = std::chrono::duration_cast<std::chrono::nanoseconds>
+            (phase.wall_start - wall_start).count();
+        span.duration = std::chrono::duration_cast<std::chrono::nanoseconds>
+            (wall - phase.wall_start).count();
+        span.unit = phase.unit;
+        if (phase.name)
+            span.name = phase.name;
+        else if (phase.unit)
+            span.name = phase.unit -> FileName();
+        else span.name = Name(phase.kind);
+        spans.push_back(span);
+    }
+    if (phase.nested)
+        return;
+
+    Time& time = phases[phase.kind];
+    time.calls++;
+    time.wall += wall_time;
+    time.cpu += cpu_time;
+    if (phase.unit)
+    {
+        Time& unit = units[phase.unit];
+        unit.wall += wall_time;
+        unit.cpu += cpu_time;
+    }
+}
+
+
+static double Milliseconds(u8 nanoseconds)
+{
+    return nanoseconds / 1000000.0;
+}
+
+
+void Profiler::PrintJsonString(FILE* file, const char* value)
+{
+    putc('"', file);
+    for (const char* p = value; *p; p++)
+    {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else putc(c, file);
+    }
+    putc('"', file);
+}
+
+
+void Profiler::Report(const char* file_name, unsigned source_files,
+                      unsigned source_lines,
+                      unsigned directory_class_files_read,
+                      unsigned zip_class_files_read,
+                      unsigned class_files_written,
+                      unsigned class_files_unchanged)
+{
+    Charge();
+    u8 wall = std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now() - wall_start).count();
+    u8 cpu = ProcessTime() - cpu_start;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::pair<u8, FileSymbol*> > slowest;
+    std::map<FileSymbol*, Time>::iterator unit;
+    for (unit = units.begin(); unit != units.end(); unit++)
+        slowest.push_back(std::make_pair(unit -> second.wall, unit -> first));
+    std::sort(slowest.rbegin(), slowest.rend());
+
+    const struct
+    {
+        const char* name;
+        unsigned value;
+    } counters[] =
+    {
+        { "source_files", source_files },
+        { "source_lines", source_lines },
+        { "class_files_read_directory", directory_class_files_read },
+        { "class_files_read_zip", zip_class_files_read },
+        { "class_files_unchanged", class_files_unchanged },
+        { "class_files_written", class_files_written }
+    };
+    const unsigned num_counters = sizeof(counters) / sizeof(counters[0]);
+
+    char line[256];
+    snprintf(line, sizeof(line), "%-12s %8s %12s %12s %6s", "phase", "calls",
+             "wall ms", "cpu ms", "wall%");
+    Coutput << endl << line << endl;
+    for (unsigned i = 0; i < NUM_PHASES; i++)
+    {
+        snprintf(line, sizeof(line), "%-12s %8u %12.1f %12.1f %5.1f%%",
+                 Name((PhaseKind) i), phases[i].calls,
+                 Milliseconds(phases[i].wall), Milliseconds(phases[i].cpu),
+                 wall ? 100.0 * phases[i].wall / wall : 0.0);
+        Coutput << line << endl;
+    }
+    snprintf(line, sizeof(line), "%-12s %8s %12.1f %12.1f", "total", "",
+             Milliseconds(wall), Milliseconds(cpu));
+    Coutput << line << endl << endl;
+
+    for (unsigned i = 0; i < num_counters; i++)
+    {
+        snprintf(line, sizeof(line), "%-28s %10u", counters[i].name,
+                 counters[i].value);
+        Coutput << line << endl;
+    }
+    if (source_lines && wall)
+    {
+        snprintf(line, sizeof(line), "%-28s %10.0f", "source_lines_per_second",
+                 source_lines * 1e9 / wall);
+        Coutput << line << endl;
+    }
+
+    if (! slowest.empty())
+    {
+        snprintf(line, sizeof(line), "%12s %12s  %s", "wall ms", "cpu ms",
+                 "slowest compilation units");
+        Coutput << endl << line << endl;
+        for (unsigned i = 0; i < slowest.size() && i < 10; i++)
+        {
+            const Time& time = units[slowest[i].second];
+            snprintf(line, sizeof(line), "%12.1f %12.1f  ",
+                     Milliseconds(time.wall), Milliseconds(time.cpu));
+            Coutput << line << slowest[i].second -> FileName() << endl;
+        }
+    }
+    Coutput.flush();
+
+    if (! file_name)
+        return;
+    FILE* file = SystemFopen(file_name, "w");
+    if (! file)
+    {
+        Coutput << "*** Cannot open profile output file " << file_name
+                << endl;
+        return;
+    }
+    fprintf(file, "{\"wall_ms\":%.3f,\"cpu_ms\":%.3f,\"phases\":{",
+            Milliseconds(wall), Milliseconds(cpu));
+    for (unsigned i = 0; i < NUM_PHASES; i++)
+    {
+        fprintf(file, "%s\"%s\":{\"calls\":%u,\"wall_ms\":%.3f,"
+                "\"cpu_ms\":%.3f}", i ? "," : "", Name((PhaseKind) i),
+                phases[i].calls, Milliseconds(phases[i].wall),
+                Milliseconds(phases[i].cpu));
+    }
+    fprintf(file, "},\"counters\":{");
+    for (unsigned i = 0; i < num_counters; i++)
+    {
+        fprintf(file, "%s\"%s\":%u", i ? "," : "", counters[i].name,
+                counters[i].value);
+    }
+    fprintf(file, "},\"units\":[");
+    for (unsigned i = 0; i < slowest.size(); i++)
+    {
+        const Time& time = units[slowest[i].second];
+        fprintf(file, "%s{\"file\":", i ? "," : "");
+        PrintJsonString(file, slowest[i].second -> FileName());
+        fprintf(file, ",\"wall_ms\":%.3f,\"cpu_ms\":%.3f}",
+                Milliseconds(time.wall), Milliseconds(time.cpu));
+    }
+    fprintf(file, "]}\n");
+    fclose(file);
+}
+
+
+bool Profiler::WriteTrace(const char* file_name)
+{
+    FILE* file = SystemFopen(file_name, "w");
+    if (! file)
+        return false;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    std::map<std::thread::id, unsigned>::iterator thread;
+    for (thread = threads.begin(); thread != threads.end(); thread++)
+    {
+        char name[32];
+        if (thread -> first == main_thread)
+            strcpy(name, "main");
+        else snprintf(name, sizeof(name), "worker %u", thread -> second - 1);
+        fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}},\n",
+                thread -> second, name);
+    }
+    for (unsigned i = 0; i < spans.size(); i++)
+    {
+        const Span& span = spans[i];
+        fprintf(file, "{\"name\":");
+        PrintJsonString(file, span.name.c_str());
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                "\"dur\":%.3f,\"pid\":1,\"tid\":%u", Name(span.kind),
+                span.start / 1000.0, span.duration / 1000.0, span.thread);
+        if (span.unit && span.name != span.unit -> FileName())
+        {
+            fprintf(file, ",\"args\":{\"unit\":");
+            PrintJsonString(file, span.unit -> FileName());
+            putc('}', file);
+        }
+        fprintf(file, "},\n");
+    }
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"args\":{\"name\":\"jopa\"}}]}\n");
+
+    bool success = ! ferror(file);
+    return fclose(file) == 0 && success;
+}
+
+
+} // Close namespace Jopa block
+
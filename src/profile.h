@@ -0,0 +1,157 @@
+#pragma once
+
+#include "platform.h"
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class FileSymbol;
+
+
+//
+// The profile of -Xprofile: the wall and processor time spent in each phase
+// of a compilation, and for each compilation unit, along with the counters
+// kept by Control. It is printed as a table when the compilation is over,
+// and written to a file as JSON:
+//
+//   {"wall_ms":...,"cpu_ms":...,
+//    "phases":{"scan":{"calls":...,"wall_ms":...,"cpu_ms":...},...},
+//    "counters":{"source_files":...,...},
+//    "units":[{"file":"...","wall_ms":...,"cpu_ms":...},...]}
+//
+// where units are sorted from the slowest one down.
+//
+// A phase runs for the lifetime of a Profiler::Phase. On the main thread
+// phases nest, and time only counts for the innermost one: a class file
+// read while the members of a type are processed counts for read_class,
+// not for members. It also counts for the innermost compilation unit
+// given, so that a unit gets the time of the class files it pulled in.
+// On the threads of ClassFileWriter and Prescanner each phase is timed on
+// its own, so the phases may add up to more than the wall time.
+//
+// With --trace-out, every phase is also kept as a span, and the spans are
+// written as Chrome trace events (see WriteTrace) for a timeline viewer
+// such as Perfetto. A span is named after what it works on: the type for
+// codegen, write and read_class, and the compilation unit otherwise.
+//
+class Profiler
+{
+public:
+    enum PhaseKind
+    {
+        STARTUP,      // reading the class path
+        SCAN,
+        PARSE,        // header, initializer and body parse
+        TYPE_HEADERS, // type names, extends and implements clauses
+        MEMBERS,
+        BODIES,
+        CODEGEN,
+        STACKMAP,     // StackMapTable attributes
+        WRITE,
+        READ_CLASS,
+        NUM_PHASES
+    };
+
+    class Phase
+    {
+    public:
+        Phase(Profiler* profiler_, PhaseKind kind_, FileSymbol* unit_ = NULL,
+              const char* name_ = NULL)
+            : profiler(profiler_)
+        {
+            if (profiler)
+                profiler -> Start(*this, kind_, unit_, name_);
+        }
+        ~Phase()
+        {
+            if (profiler)
+                profiler -> Stop(*this);
+        }
+
+    private:
+        friend class Profiler;
+
+        Profiler* profiler;
+        PhaseKind kind;
+        FileSymbol* unit;
+        bool nested; // on the main thread
+        std::chrono::steady_clock::time_point wall_start;
+        u8 cpu_start;
+        const char* name; // for the trace
+    };
+
+    Profiler(bool trace_);
+
+    //
+    // Print the table with Coutput, and write the JSON to file_name (if not
+    // NULL). The counters are those of Control.
+    //
+    void Report(const char* file_name, unsigned source_files,
+                unsigned source_lines, unsigned directory_class_files_read,
+                unsigned zip_class_files_read, unsigned class_files_written,
+                unsigned class_files_unchanged);
+
+    //
+    // Write the spans to file_name in the JSON object format of the Chrome
+    // trace events: complete ("X") events, in microseconds since the
+    // Profiler was created, with one track per thread. Returns false if the
+    // file cannot be written.
+    //
+    bool WriteTrace(const char* file_name);
+
+    static const char* Name(PhaseKind);
+    static void PrintJsonString(FILE*, const char*);
+
+private:
+    struct Time
+    {
+        Time() : calls(0), wall(0), cpu(0) {}
+
+        unsigned calls;
+        u8 wall; // in nanoseconds
+        u8 cpu;
+    };
+
+    std::thread::id main_thread;
+    std::chrono::steady_clock::time_point wall_start;
+    u8 cpu_start;
+
+    std::vector<Phase*> stack; // of the main thread
+    std::chrono::steady_clock::time_point wall_mark;
+    u8 cpu_mark;
+
+    struct Span
+    {
+        PhaseKind kind;
+        unsigned thread;
+        u8 start; // in nanoseconds since wall_start
+        u8 duration;
+        std::string name;
+        FileSymbol* unit;
+    };
+
+    std::mutex mutex; // for the other threads
+    Time phases[NUM_PHASES];
+    std::map<FileSymbol*, Time> units;
+
+    bool trace;
+    std::vector<Span> spans;
+    std::map<std::thread::id, unsigned> threads; // numbered from 1, in order
+
+    void Start(Phase&, PhaseKind, FileSymbol*, const char*);
+    void Stop(Phase&);
+    void Charge();
+
+    static u8 ThreadTime();
+    static u8 ProcessTime();
+};
+
+
+} // Close namespace Jopa block
+
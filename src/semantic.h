@@ -815,6 +815,7 @@ public:
     }
 
     unsigned NumErrors() { return (error ? error -> num_errors : 0); }
+    unsigned NumWarnings() { return (error ? error -> num_warnings : 0); }
 
     //
     // If we had a bad compilation unit, print the parser messages.
@@ -882,6 +883,7 @@ private:
     void CheckForSerializationMistakes(AstClassBody*);
     void ProcessFieldMembers(AstClassBody*);
     void ProcessEnumConstantMembers(AstClassBody*);
+    void AddAnnotationDependences(AstClassBody*);
     void ProcessMembers(AstClassBody*);
     void CompleteSymbolTable(AstClassBody*);
 
@@ -0,0 +1,795 @@
+#include "server.h"
+#include "control.h"
+#include "option.h"
+
+#include <set>
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+//
+// A request is a list of strings: the working directory of the client, the
+// values of the environment variables that Option consults (each prefixed
+// by '=', or empty if unset), and the arguments, without the program name.
+// On the wire, it is the length of the strings, each NUL-terminated, and
+// then the strings. The client passes its standard streams along with the
+// length; the master adds the client connection in front of them when it
+// hands the request on to a zygote. The answer is the return code.
+//
+static const char* environment_names[] = {
+    "BOOTCLASSPATH", "EXTDIRS", "JIKESPATH", "CLASSPATH", "SOURCEPATH",
+    "JOPA_MEMORY_LOG"
+};
+static const unsigned NUM_ENVIRONMENT_NAMES =
+    sizeof(environment_names) / sizeof(environment_names[0]);
+static const unsigned MAX_ZYGOTES = 8;
+static const unsigned REQUEST_TIMEOUT = 5; // seconds to send a request in
+
+
+static bool WriteFully(int fd, const void* buffer, size_t length)
+{
+    const char* p = (const char*) buffer;
+    while (length > 0)
+    {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+
+static bool ReadFully(int fd, void* buffer, size_t length)
+{
+    char* p = (char*) buffer;
+    while (length > 0)
+    {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        length -= n;
+    }
+    return true;
+}
+
+
+static bool SendRequest(int fd, const std::vector<std::string>& request,
+                        const int* fds, unsigned num_fds)
+{
+    std::string data;
+    for (unsigned i = 0; i < request.size(); i++)
+    {
+        data += request[i];
+        data += '\0';
+    }
+    u4 length = data.size();
+
+    struct iovec iov;
+    iov.iov_base = &length;
+    iov.iov_len = sizeof(length);
+    char control[CMSG_SPACE(sizeof(int) * 4)];
+    memset(control, 0, sizeof(control));
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+    cmsg -> cmsg_level = SOL_SOCKET;
+    cmsg -> cmsg_type = SCM_RIGHTS;
+    cmsg -> cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
+
+    ssize_t n;
+    do
+        n = sendmsg(fd, &message, MSG_NOSIGNAL);
+    while (n < 0 && errno == EINTR);
+    return n == (ssize_t) sizeof(length) &&
+        WriteFully(fd, data.data(), data.size());
+}
+
+
+//
+// Receive a request with exactly num_fds descriptors attached. The
+// descriptors are close-on-exec.
+//
+static bool ReceiveRequest(int fd, std::vector<std::string>& request,
+                           int* fds, unsigned num_fds)
+{
+    u4 length;
+    struct iovec iov;
+    iov.iov_base = &length;
+    iov.iov_len = sizeof(length);
+    char control[CMSG_SPACE(sizeof(int) * 4)];
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    ssize_t n;
+    do
+        n = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    while (n < 0 && errno == EINTR);
+
+    unsigned received = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg;
+         cmsg = CMSG_NXTHDR(&message, cmsg))
+    {
+        if (cmsg -> cmsg_level != SOL_SOCKET ||
+            cmsg -> cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+        unsigned count = (cmsg -> cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        int* data = (int*) CMSG_DATA(cmsg);
+        for (unsigned i = 0; i < count; i++)
+        {
+            if (received < num_fds)
+                fds[received++] = data[i];
+            else close(data[i]);
+        }
+    }
+
+    bool success = n > 0 && received == num_fds &&
+        (n == (ssize_t) sizeof(length) ||
+         ReadFully(fd, (char*) &length + n, sizeof(length) - n));
+    std::vector<char> data;
+    if (success)
+    {
+        data.resize(length);
+        success = ReadFully(fd, data.data(), length) &&
+            (length == 0 || data[length - 1] == '\0');
+    }
+    if (! success)
+    {
+        for (unsigned i = 0; i < received; i++)
+            close(fds[i]);
+        return false;
+    }
+
+    request.clear();
+    for (unsigned start = 0; start < length; )
+    {
+        request.push_back(std::string(&data[start]));
+        start += request.back().size() + 1;
+    }
+    return request.size() >= 1 + NUM_ENVIRONMENT_NAMES;
+}
+
+
+//
+// Parse arguments the way main does. On return, options holds the option
+// arguments after @file expansion, in their order, and files the input
+// files. Returns NULL if there were bad options.
+//
+static Option* ParseArguments(const std::vector<std::string>& arguments,
+                              std::vector<std::string>& options,
+                              std::vector<std::string>& files)
+{
+    std::vector<char*> argv;
+    argv.push_back((char*) "jopa");
+    for (unsigned i = 0; i < arguments.size(); i++)
+        argv.push_back((char*) arguments[i].c_str());
+    argv.push_back(NULL);
+
+    Tuple<OptionError*> bad_options;
+    ArgumentExpander expander(arguments.size() + 1, argv.data(),
+                              bad_options);
+    // Option moves the files behind the options.
+    std::vector<char*> original(expander.argv,
+                                expander.argv + expander.argc);
+    Option* option = new Option(expander, bad_options);
+
+    std::set<char*> file_arguments(expander.argv + option -> first_file_index,
+                                   expander.argv + expander.argc);
+    options.clear();
+    for (unsigned i = 1; i < original.size(); i++)
+    {
+        if (! file_arguments.count(original[i]))
+            options.push_back(original[i]);
+    }
+    files.clear();
+    for (int i = option -> first_file_index; i < expander.argc; i++)
+        files.push_back(expander.argv[i]);
+
+    bool bad = bad_options.Length() > 0;
+    for (unsigned i = 0; i < bad_options.Length(); i++)
+        delete bad_options[i];
+    if (bad)
+    {
+        delete option;
+        return NULL;
+    }
+    return option;
+}
+
+
+//
+// Can the options be served from a set up Control? Anything but a plain
+// compilation is left to a fresh process.
+//
+static bool Compiles(Option& option, std::vector<std::string>& files)
+{
+    return files.size() > 0 && ! option.help && ! option.version &&
+        ! option.incremental && ! option.makefile && ! option.parse_only &&
+        ! option.server_socket && ! option.connect_socket;
+}
+
+
+//
+// Replace this process by a fresh jopa run with the arguments.
+//
+static void RunFresh(const std::string& program_name,
+                     const std::vector<std::string>& arguments)
+{
+    std::vector<char*> argv;
+    argv.push_back((char*) program_name.c_str());
+    for (unsigned i = 0; i < arguments.size(); i++)
+        argv.push_back((char*) arguments[i].c_str());
+    argv.push_back(NULL);
+
+    execv(argv[0], argv.data());
+    fprintf(stderr, "*** Cannot run %s: %s\n", argv[0], strerror(errno));
+    _exit(1);
+}
+
+
+//
+// The state of a zygote: the options it serves, and the Control set up
+// with them, unless they are not fit for that.
+//
+class WarmControl
+{
+public:
+    WarmControl(const std::vector<std::string>& arguments_,
+                const std::string& program_name_)
+        : arguments(arguments_)
+        , program_name(program_name_)
+        , option(NULL)
+        , control(NULL)
+    {
+        SetUp(true);
+    }
+
+    void Serve(int fd);
+
+private:
+    //
+    // What a path the Control was set up from looked like at the time. The
+    // contents of directories are reread for each compilation anyway, but
+    // the set of archives in an extension directory is not.
+    //
+    struct PathStatus
+    {
+        std::string name;
+        bool exists;
+        bool contents;
+        mode_t type;
+        dev_t dev;
+        ino_t ino;
+        off_t size;
+        time_t mtime;
+    };
+
+    std::vector<std::string> arguments;
+    std::string program_name;
+    std::vector<std::string> options;
+    Option* option;
+    Control* control;
+    std::vector<PathStatus> paths;
+
+    void SetUp(bool preload);
+    void TearDown();
+    void AddPath(const std::string& name, bool contents);
+    void AddPaths(const char* path, bool contents);
+    bool Current();
+    void Work(const std::vector<std::string>& request, int* fds);
+    void Compile(const std::vector<std::string>& arguments);
+};
+
+
+void WarmControl::SetUp(bool preload)
+{
+    std::vector<std::string> files;
+    option = ParseArguments(arguments, options, files);
+    if (! option || ! Compiles(*option, files))
+    {
+        delete option;
+        option = NULL;
+        return;
+    }
+
+    paths.clear();
+    AddPaths(option -> bootclasspath, false);
+    AddPaths(option -> extdirs, true);
+    AddPaths(option -> classpath, false);
+    AddPaths(option -> sourcepath, false);
+
+    control = new Control(*option);
+    if (preload && ! option -> verbose && ! control -> PreloadSystemTypes())
+    {
+        TearDown();
+        SetUp(false);
+        return;
+    }
+
+    for (unsigned k = 0; k < control -> classpath.Length(); k++)
+    {
+        PathSymbol* path_symbol = control -> classpath[k];
+        if (path_symbol -> IsZip())
+            AddPath(path_symbol -> Utf8Name(), true);
+    }
+}
+
+
+void WarmControl::TearDown()
+{
+    delete control;
+    control = NULL;
+    delete option;
+    option = NULL;
+}
+
+
+void WarmControl::AddPath(const std::string& name, bool contents)
+{
+    PathStatus status = PathStatus();
+    struct stat buffer;
+    status.name = name;
+    status.contents = contents;
+    status.exists = SystemStat(name.c_str(), &buffer) == 0;
+    if (status.exists)
+    {
+        status.type = buffer.st_mode & S_IFMT;
+        if (contents || status.type != S_IFDIR)
+        {
+            status.dev = buffer.st_dev;
+            status.ino = buffer.st_ino;
+            status.size = buffer.st_size;
+            status.mtime = buffer.st_mtime;
+        }
+    }
+    paths.push_back(status);
+}
+
+
+void WarmControl::AddPaths(const char* path, bool contents)
+{
+    if (! path)
+        return;
+    std::string name;
+    for (const char* p = path; ; p++)
+    {
+        if (*p && *p != PathSeparator())
+            name += *p;
+        else
+        {
+            if (! name.empty())
+                AddPath(name, contents);
+            name.clear();
+            if (! *p)
+                break;
+        }
+    }
+}
+
+
+//
+// Do the paths still look the way they did when the Control was set up?
+//
+bool WarmControl::Current()
+{
+    std::vector<PathStatus> old_paths;
+    old_paths.swap(paths);
+    for (unsigned i = 0; i < old_paths.size(); i++)
+        AddPath(old_paths[i].name, old_paths[i].contents);
+
+    bool current = true;
+    for (unsigned i = 0; i < paths.size() && current; i++)
+    {
+        PathStatus& now = paths[i];
+        PathStatus& then = old_paths[i];
+        current = now.exists == then.exists && now.type == then.type &&
+            now.dev == then.dev && now.ino == then.ino &&
+            now.size == then.size && now.mtime == then.mtime;
+    }
+    return current;
+}
+
+
+void WarmControl::Serve(int fd)
+{
+    signal(SIGCHLD, SIG_IGN); // let the workers go
+    for (;;)
+    {
+        std::vector<std::string> request;
+        int fds[4];
+        if (! ReceiveRequest(fd, request, fds, 4))
+            _exit(0); // the master is gone, or has dropped us
+
+        if (control && ! Current())
+        {
+            TearDown();
+            SetUp(true);
+        }
+
+        fflush(NULL);
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            close(fd);
+            Work(request, fds);
+        }
+        for (unsigned i = 0; i < 4; i++)
+            close(fds[i]);
+    }
+}
+
+
+//
+// In a worker: compile the request, and send back the return code.
+//
+void WarmControl::Work(const std::vector<std::string>& request, int* fds)
+{
+    int connection = fds[0];
+    for (unsigned i = 1; i < 4; i++)
+    {
+        dup2(fds[i], i - 1);
+        close(fds[i]);
+    }
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+
+    //
+    // The compilation runs in a process of its own, so that we get to
+    // report how it ended, even if it crashed.
+    //
+    std::vector<std::string> arguments(request.begin() + 1 +
+                                       NUM_ENVIRONMENT_NAMES,
+                                       request.end());
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(connection);
+        Compile(arguments);
+    }
+
+    int status;
+    u4 answer = 1;
+    if (pid > 0)
+    {
+        while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+            ;
+        answer = WIFEXITED(status) ? WEXITSTATUS(status)
+            : 128 + WTERMSIG(status);
+    }
+    WriteFully(connection, &answer, sizeof(answer));
+    _exit(0);
+}
+
+
+void WarmControl::Compile(const std::vector<std::string>& arguments)
+{
+    if (control)
+    {
+        std::vector<std::string> request_options,
+                                 files;
+        Option* request_option = ParseArguments(arguments, request_options,
+                                                files);
+        if (request_option && Compiles(*request_option, files) &&
+            request_options == options && control -> ReloadPackages())
+        {
+            std::vector<char*> file_names;
+            for (unsigned i = 0; i < files.size(); i++)
+                file_names.push_back((char*) files[i].c_str());
+            file_names.push_back(NULL);
+
+            control -> Compile(file_names.data());
+            Coutput.flush();
+            fflush(NULL);
+            if (control -> return_code == 0 && control -> StaleDependents())
+                RunFresh(program_name, arguments);
+            _exit(control -> return_code);
+        }
+    }
+    RunFresh(program_name, arguments);
+}
+
+
+CompileServer::CompileServer(const char* socket_name_,
+                             const char* program_name_)
+    : socket_name(socket_name_)
+    , listen_fd(-1)
+{
+    //
+    // Fresh processes are started from the executable itself, if we can
+    // tell where that is.
+    //
+    char buffer[PATH_MAX + 1];
+    ssize_t length = readlink("/proc/self/exe", buffer, PATH_MAX);
+    if (length > 0)
+        program_name.assign(buffer, length);
+    else program_name = program_name_;
+}
+
+
+CompileServer::~CompileServer()
+{
+    while (zygotes.size())
+        KillZygote(&zygotes[0]);
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        unlink(socket_name.c_str());
+    }
+}
+
+
+int CompileServer::Serve()
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_name.size() >= sizeof(address.sun_path))
+    {
+        Coutput << "*** Socket name " << socket_name.c_str()
+                << " is too long" << endl;
+        return 1;
+    }
+    strcpy(address.sun_path, socket_name.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+    {
+        Coutput << "*** Cannot create socket: " << strerror(errno) << endl;
+        return 1;
+    }
+    if (connect(listen_fd, (struct sockaddr*) &address, sizeof(address)) == 0)
+    {
+        Coutput << "*** A compile server is already running on "
+                << socket_name.c_str() << endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return 1;
+    }
+    unlink(socket_name.c_str()); // left behind by a server that was killed
+    if (bind(listen_fd, (struct sockaddr*) &address, sizeof(address)) < 0 ||
+        listen(listen_fd, 64) < 0)
+    {
+        Coutput << "*** Cannot listen on " << socket_name.c_str() << ": "
+                << strerror(errno) << endl;
+        close(listen_fd);
+        listen_fd = -1;
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGCHLD, SIG_IGN); // let the zygotes go
+    for (;;)
+    {
+        int connection = accept(listen_fd, NULL, NULL);
+        if (connection < 0)
+            continue;
+        fcntl(connection, F_SETFD, FD_CLOEXEC);
+
+        //
+        // Every client waits while this one is read, so give up on a
+        // client that connects and then stalls. The connection goes on to
+        // the zygote without the timeout.
+        //
+        struct timeval timeout;
+        timeout.tv_sec = REQUEST_TIMEOUT;
+        timeout.tv_usec = 0;
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout));
+        std::vector<std::string> request;
+        int fds[4];
+        fds[0] = connection;
+        if (! ReceiveRequest(connection, request, fds + 1, 3))
+        {
+            close(connection);
+            continue;
+        }
+        timeout.tv_sec = 0;
+        setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout,
+                   sizeof(timeout));
+
+        //
+        // The input files are whatever ends in .java; if that guess is
+        // wrong, the zygote notices, and runs the request afresh.
+        //
+        std::string key;
+        for (unsigned i = 0; i < request.size(); i++)
+        {
+            const std::string& argument = request[i];
+            if (i > NUM_ENVIRONMENT_NAMES && argument.size() > 5 &&
+                argument.compare(argument.size() - 5, 5, ".java") == 0)
+            {
+                continue;
+            }
+            key += argument;
+            key += '\0';
+        }
+
+        Zygote* zygote = FindZygote(key);
+        if (! zygote || ! SendRequest(zygote -> fd, request, fds, 4))
+        {
+            if (zygote)
+                KillZygote(zygote);
+            zygote = SpawnZygote(key, request, fds);
+            if (zygote && ! SendRequest(zygote -> fd, request, fds, 4))
+                KillZygote(zygote);
+        }
+        for (unsigned i = 0; i < 4; i++)
+            close(fds[i]);
+    }
+}
+
+
+CompileServer::Zygote* CompileServer::FindZygote(const std::string& key)
+{
+    for (unsigned i = 0; i < zygotes.size(); i++)
+    {
+        if (zygotes[i].key == key)
+        {
+            Zygote zygote = zygotes[i];
+            zygotes.erase(zygotes.begin() + i);
+            zygotes.push_back(zygote);
+            return &zygotes.back();
+        }
+    }
+    return NULL;
+}
+
+
+CompileServer::Zygote* CompileServer::SpawnZygote(const std::string& key,
+                                    const std::vector<std::string>& request,
+                                    const int* fds)
+{
+    if (zygotes.size() >= MAX_ZYGOTES)
+        KillZygote(&zygotes[0]);
+
+    int channel[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, channel) < 0)
+        return NULL;
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(channel[0]);
+        close(channel[1]);
+        return NULL;
+    }
+    if (pid == 0)
+    {
+        //
+        // The request at hand is passed on to us like any other; the
+        // descriptors of the master are no business of ours.
+        //
+        close(listen_fd);
+        for (unsigned i = 0; i < zygotes.size(); i++)
+            close(zygotes[i].fd);
+        for (unsigned i = 0; i < 4; i++)
+            close(fds[i]);
+        close(channel[0]);
+        signal(SIGPIPE, SIG_DFL);
+
+        if (chdir(request[0].c_str()) < 0)
+            _exit(1);
+        for (unsigned i = 0; i < NUM_ENVIRONMENT_NAMES; i++)
+        {
+            const std::string& value = request[i + 1];
+            if (value.empty())
+                unsetenv(environment_names[i]);
+            else setenv(environment_names[i], value.c_str() + 1, 1);
+        }
+
+        std::vector<std::string> arguments(request.begin() + 1 +
+                                           NUM_ENVIRONMENT_NAMES,
+                                           request.end());
+        WarmControl warm_control(arguments, program_name);
+        warm_control.Serve(channel[1]);
+        _exit(0);
+    }
+
+    close(channel[1]);
+    Zygote zygote;
+    zygote.key = key;
+    zygote.pid = pid;
+    zygote.fd = channel[0];
+    zygotes.push_back(zygote);
+    return &zygotes.back();
+}
+
+
+void CompileServer::KillZygote(Zygote* zygote)
+{
+    close(zygote -> fd); // it exits as soon as it notices
+    zygotes.erase(zygotes.begin() + (zygote - &zygotes[0]));
+}
+
+
+int CompileServer::Request(const char* socket_name, int argc, char** argv)
+{
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_name) >= sizeof(address.sun_path))
+        return -1;
+    strcpy(address.sun_path, socket_name);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (struct sockaddr*) &address, sizeof(address)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    std::vector<std::string> request;
+    char* cwd = getcwd(NULL, 0);
+    request.push_back(cwd ? cwd : ".");
+    free(cwd);
+    for (unsigned i = 0; i < NUM_ENVIRONMENT_NAMES; i++)
+    {
+        const char* value = getenv(environment_names[i]);
+        request.push_back(value ? std::string("=") + value : std::string());
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--connect", 9) == 0)
+        {
+            if (! argv[i][9])
+                i++; // the socket name came separately
+            continue;
+        }
+        request.push_back(argv[i]);
+    }
+
+    int fds[3] = { 0, 1, 2 };
+    if (! SendRequest(fd, request, fds, 3))
+    {
+        close(fd);
+        return -1;
+    }
+
+    //
+    // From here on, the compilation may well be under way, so running it
+    // again locally is no longer an option.
+    //
+    u4 answer;
+    bool answered = ReadFully(fd, &answer, sizeof(answer));
+    close(fd);
+    if (! answered)
+    {
+        Coutput << "*** The compile server on " << socket_name
+                << " failed to answer" << endl;
+        return 1;
+    }
+    return answer;
+}
+
+
+} // Close namespace Jopa block
+
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "platform.h"
+
+#include <string>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class Control;
+class Option;
+
+
+//
+// The compile server (option --server=SOCKET), and its client (option
+// --connect=SOCKET).
+//
+// Most of the time of a small compilation goes into setting up: reading
+// the directories of the zip files on the class path, and the class files
+// of java.lang and friends. The server does that once per set of options,
+// and then compiles each request in a process forked from the result, so a
+// request pays for its own source files only.
+//
+// The server proper (the master) never parses options, since that has
+// global side effects. It hands each request to a "zygote" process that
+// serves one combination of working directory, environment and options:
+// the zygote parsed the options and set up a Control with them, and forks
+// a worker per request. The worker takes over the standard streams of the
+// client, which were passed along with the request, compiles the files on
+// its copy of the Control, and sends back the return code. A request the
+// zygote is not fit for (other options after all, an option such as ++ or
+// -help that does not compile as such, a class path that now shadows a
+// type it has read) is run by a fresh jopa process instead, so a request
+// always behaves exactly as if it had been run without the server.
+//
+class CompileServer
+{
+public:
+    CompileServer(const char* socket_name, const char* program_name);
+    ~CompileServer();
+
+    //
+    // Serve requests until killed. Returns only if the socket could not be
+    // set up, with the return code for jopa.
+    //
+    int Serve();
+
+    //
+    // Run the compilation of argv, as given to jopa, through the server at
+    // socket_name, and return its return code; or return -1 if no server
+    // could be reached, and the compilation should be run locally instead.
+    //
+    static int Request(const char* socket_name, int argc, char** argv);
+
+private:
+    struct Zygote
+    {
+        std::string key;
+        pid_t pid;
+        int fd; // our end of the channel to the zygote
+    };
+
+    std::string socket_name;
+    std::string program_name; // the jopa executable, for fresh processes
+    int listen_fd;
+    std::vector<Zygote> zygotes; // most recently used last
+
+    Zygote* FindZygote(const std::string& key);
+    Zygote* SpawnZygote(const std::string& key,
+                        const std::vector<std::string>& request,
+                        const int* fds);
+    void KillZygote(Zygote*);
+};
+
+
+} // Close namespace Jopa block
+
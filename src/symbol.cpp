@@ -552,6 +552,7 @@ unsigned SymbolTable::primes[] = {DEFAULT_HASH_SIZE, 101, 401, MAX_HASH_SIZE};
 
 void SymbolTable::Rehash()
 {
+    Account((long) (primes[prime_index + 1] - hash_size) * sizeof(Symbol*));
     hash_size = primes[++prime_index];
 
     delete [] base;
@@ -606,6 +607,7 @@ SymbolTable::SymbolTable(unsigned hash_size_)
     , method_symbol_pool(NULL)
     , variable_symbol_pool(NULL)
     , other_symbol_pool(NULL)
+    , bytes(0)
 {
     hash_size = (hash_size_ <= 0 ? 1 : hash_size_);
 
@@ -619,6 +621,7 @@ SymbolTable::SymbolTable(unsigned hash_size_)
 
     base = (Symbol**) memset(new Symbol*[hash_size], 0,
                              hash_size * sizeof(Symbol*));
+    Account(hash_size * sizeof(Symbol*));
 }
 
 SymbolTable::~SymbolTable()
@@ -640,6 +643,7 @@ SymbolTable::~SymbolTable()
         delete OtherSym(i);
     delete other_symbol_pool;
     delete [] base;
+    MemoryAccount::Free(MemoryAccount::SYMBOLS, bytes);
 }
 
 
@@ -681,6 +685,7 @@ TypeSymbol::TypeSymbol(const NameSymbol* name_symbol_)
     index(TypeCycleChecker::OMEGA),
     unit_index(TypeCycleChecker::OMEGA),
     incremental_index(TypeCycleChecker::OMEGA),
+    abi_fingerprint(0),
     local(NULL),
     non_local(NULL),
     supertypes_closure(NULL),
@@ -1003,6 +1008,42 @@ void DirectorySymbol::ResetDirectory()
 }
 
 
+#ifdef UNIX_FILE_SYSTEM
+//
+// What entry of the open directory is. Most file systems record the type
+// of an entry in the directory itself; it takes a stat only for those that
+// do not, and for symbolic links, which are followed. NO_ENTRY is for a
+// link to nothing, or an entry that is gone by now.
+//
+DirectorySymbol::EntryKind DirectorySymbol::KindOf(DIR* directory,
+                                                   dirent* entry)
+{
+#ifdef HAVE_STRUCT_DIRENT_D_TYPE
+    if (entry -> d_type == DT_DIR)
+        return DIRECTORY_ENTRY;
+    if (entry -> d_type == DT_REG)
+        return FILE_ENTRY;
+#endif
+
+    struct stat status;
+#ifdef HAVE_FSTATAT
+    if (fstatat(dirfd(directory), entry -> d_name, &status, 0) != 0)
+        return NO_ENTRY;
+#else
+    (void) directory;
+    int len = DirectoryNameLength() + strlen(entry -> d_name);
+    char* filename = new char[len + 2]; // +2 for '/', NUL
+    snprintf(filename, len + 2, "%s/%s", DirectoryName(), entry -> d_name);
+    int result = JopaAPI::getInstance() -> stat(filename, &status);
+    delete [] filename;
+    if (result != 0)
+        return NO_ENTRY;
+#endif
+    return S_ISDIR(status.st_mode) ? DIRECTORY_ENTRY : FILE_ENTRY;
+}
+#endif // UNIX_FILE_SYSTEM
+
+
 void DirectorySymbol::ReadDirectory()
 {
     assert(! IsZip());
@@ -1028,21 +1069,19 @@ void DirectorySymbol::ReadDirectory()
                 // directory "." and its parent ".."
                 //
                 // Don't add the class file if the source_dir_only flag is set.
-                if ((length > FileSymbol::java_suffix_length &&
+                //
+                bool source_or_class =
+                    (length > FileSymbol::java_suffix_length &&
                      FileSymbol::IsJavaSuffix(&entry -> d_name[length - FileSymbol::java_suffix_length])) ||
                     (! source_dir_only && length > FileSymbol::class_suffix_length &&
-                     FileSymbol::IsClassSuffix(&entry -> d_name[length - FileSymbol::class_suffix_length])) ||
-                    (Case::Index(entry -> d_name, U_DOT) < 0 &&
-                     SystemIsDirectory(entry -> d_name)))
+                     FileSymbol::IsClassSuffix(&entry -> d_name[length - FileSymbol::class_suffix_length]));
+                if (! source_or_class && Case::Index(entry -> d_name, U_DOT) >= 0)
+                    continue;
+                EntryKind kind = KindOf(directory, entry);
+                if (source_or_class ? kind != NO_ENTRY
+                    : kind == DIRECTORY_ENTRY)
                 {
-                    int len = DirectoryNameLength() + strlen(entry -> d_name);
-                    char* filename = new char[len + 2]; // +2 for '/', NUL
-                    snprintf(filename, len + 2, "%s/%s", DirectoryName(),
-                             entry -> d_name);
-                    struct stat status;
-                    if(JopaAPI::getInstance() -> stat(filename, &status) == 0)
-                        entries -> InsertEntry(this, entry -> d_name, length);
-                    delete [] filename;
+                    entries -> InsertEntry(this, entry -> d_name, length);
                 }
             }
             closedir(directory);
@@ -1053,6 +1092,29 @@ void DirectorySymbol::ReadDirectory()
 }
 
 
+//
+// The subdirectory with the given name, if there is one. On disk, this
+// looks in the entries of this directory, which are read once, instead of
+// at the subdirectory's path; so asking every directory on the classpath
+// for a package costs a hash probe each, not a stat.
+//
+DirectorySymbol* DirectorySymbol::FindOrReadSubdirectory(const NameSymbol* name_symbol)
+{
+    DirectorySymbol* subdirectory_symbol = FindDirectorySymbol(name_symbol);
+    if (subdirectory_symbol || IsZip())
+        return subdirectory_symbol;
+
+    ReadDirectory();
+    if (FindEntry((char*) name_symbol -> Utf8Name(),
+                  name_symbol -> Utf8NameLength()))
+    {
+        subdirectory_symbol =
+            InsertDirectorySymbol(name_symbol, source_dir_only);
+    }
+    return subdirectory_symbol;
+}
+
+
 DirectorySymbol* FileSymbol::OutputDirectory()
 {
     return output_directory ? output_directory
@@ -1067,6 +1129,19 @@ FileSymbol::~FileSymbol()
 }
 
 
+time_t FileSymbol::Mtime()
+{
+    if (mtime_pending)
+    {
+        struct stat status;
+        mtime = JopaAPI::getInstance() -> stat(FileName(), &status) == 0
+            ? status.st_mtime : 0;
+        mtime_pending = false;
+    }
+    return mtime;
+}
+
+
 void FileSymbol::SetFileName()
 {
     PathSymbol* path_symbol = PathSym();
@@ -1114,7 +1189,22 @@ bool FileSymbol::IsJavaSuffix(char* suffix)
 
 void FileSymbol::SetFileNameLiteral(Control* control)
 {
-    if (! file_name_literal)
+    if (! file_name_literal && IsZip())
+    {
+        //
+        // The FileName of a source in a zip file is that of the zip file,
+        // followed by "/package(Name.java)"; the name of the source itself
+        // is that of the symbol.
+        //
+        int length = Utf8NameLength() + java_suffix_length;
+        char* file_name = new char[length + 1];
+        strcpy(file_name, Utf8Name());
+        strcat(file_name, java_suffix);
+        file_name_literal =
+            control -> Utf8_pool.FindOrInsert(file_name, length);
+        delete [] file_name;
+    }
+    else if (! file_name_literal)
     {
         char* file_name = FileName();
 
@@ -1174,7 +1264,14 @@ void TypeSymbol::SetClassName()
 {
     size_t length;
 
-    if (semantic_environment -> sem -> control.option.directory)
+    //
+    // Without -d, the classes of a source in a zip file are written under
+    // the current directory, as if it had been given with -d .; see
+    // Control::GetOutputDirectory.
+    //
+    if (semantic_environment -> sem -> control.option.directory ||
+        (! semantic_environment -> sem -> control.option.jar_name &&
+         file_symbol -> IsZip()))
     {
         DirectorySymbol* output_directory = file_symbol -> OutputDirectory();
         int directory_length = output_directory -> DirectoryNameLength();
@@ -1188,6 +1285,20 @@ void TypeSymbol::SetClassName()
         if (directory_name[directory_length - 1] != U_SLASH)
             strcat(class_name, StringConstant::U8S_SL);
     }
+    else if (semantic_environment -> sem -> control.option.jar_name)
+    {
+        //
+        // With -d out.jar, the name of the archive entry: the fully
+        // qualified name, with slashes.
+        //
+        int package_length =
+            fully_qualified_name -> length - ExternalUtf8NameLength();
+        length = package_length + ExternalUtf8NameLength() +
+            FileSymbol::class_suffix_length;
+        class_name = new char[length + 1]; // +1 for '\0'
+        strncpy(class_name, fully_qualified_name -> value, package_length);
+        class_name[package_length] = U_NULL;
+    }
     else
     {
         char* file_name =
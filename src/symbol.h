@@ -4,6 +4,7 @@
 #include "lookup.h"
 #include "access.h"
 #include "tuple.h"
+#include "memacct.h"
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -126,10 +127,15 @@ public:
 
     inline DirectorySymbol* InsertDirectorySymbol(const NameSymbol*, bool);
     inline DirectorySymbol* FindDirectorySymbol(const NameSymbol*);
+    DirectorySymbol* FindOrReadSubdirectory(const NameSymbol*);
 
     inline FileSymbol* InsertFileSymbol(const NameSymbol*);
     inline FileSymbol* FindFileSymbol(const NameSymbol*);
 
+    // The files and subdirectories inserted so far, in insertion order.
+    inline unsigned NumOtherSymbols();
+    inline Symbol* OtherSym(unsigned);
+
     void ResetDirectory();
 
     void ReadDirectory();
@@ -138,6 +144,11 @@ private:
     SymbolTable* table;
     inline SymbolTable* Table();
 
+#ifdef UNIX_FILE_SYSTEM
+    enum EntryKind { NO_ENTRY, FILE_ENTRY, DIRECTORY_ENTRY };
+    EntryKind KindOf(DIR*, dirent*);
+#endif
+
     DirectoryTable* entries;
     char* directory_name;
     unsigned directory_name_length;
@@ -161,6 +172,9 @@ private:
     unsigned file_name_length;
     Utf8LiteralValue* file_name_literal;
 
+    time_t mtime;
+    bool mtime_pending; // mtime is to be looked up when asked for
+
 public:
     const NameSymbol* name_symbol;
     DirectorySymbol* directory_symbol;
@@ -168,17 +182,15 @@ public:
     FileKind kind;
 
     //
-    // These fields are used for files in zip packages.
+    // These fields are used for files in zip packages: they come from the
+    // central directory, and offset is that of the entry's local header.
     //
     u4 uncompressed_size;
-    u4 date_time;
+    u4 compressed_size;
+    u4 date_time; // DOS date and time
+    u2 compression_method;
     long offset;
 
-    //
-    // This field holds the time of last data modification for a non-zip file
-    //
-    time_t mtime;
-
     LexStream* lex_stream;
     AstCompilationUnit* compilation_unit;
     Semantic* semantic;
@@ -189,10 +201,11 @@ public:
         : output_directory(NULL)
         , file_name(NULL)
         , file_name_literal(NULL)
+        , mtime(0)
+        , mtime_pending(false)
         , name_symbol(name_symbol_)
         , directory_symbol(NULL)
         , package(NULL)
-        , mtime(0)
         , lex_stream(NULL)
         , compilation_unit(NULL)
         , semantic(NULL)
@@ -210,9 +223,24 @@ public:
         clone -> kind = kind;
         clone -> directory_symbol = directory_symbol;
         clone -> mtime = mtime;
+        clone -> mtime_pending = mtime_pending;
         return clone;
     }
 
+    //
+    // The time of last data modification of a non-zip file. It is only
+    // needed to choose between a source and a class file, and to find the
+    // files changed since an incremental compilation; so when a file is
+    // found, DeferMtime puts off the stat until Mtime is called, if ever.
+    //
+    time_t Mtime();
+    void SetMtime(time_t mtime_)
+    {
+        mtime = mtime_;
+        mtime_pending = false;
+    }
+    void DeferMtime() { mtime_pending = true; }
+
     virtual const wchar_t* Name() const { return name_symbol -> Name(); }
     virtual unsigned NameLength() const { return name_symbol -> NameLength(); }
     virtual const NameSymbol* Identity() const { return name_symbol; }
@@ -323,9 +351,16 @@ public:
     Tuple<DirectorySymbol*> directory;
     PackageSymbol* owner;
 
+    //
+    // How many of the source roots (the directories of the unnamed package)
+    // have been searched for this package's directory.
+    //
+    unsigned source_roots_searched;
+
     PackageSymbol(const NameSymbol* name_symbol_, PackageSymbol* owner_)
         : directory(4)
         , owner(owner_)
+        , source_roots_searched(0)
         , name_symbol(name_symbol_)
         , table(NULL)
         , package_name(NULL)
@@ -374,6 +409,10 @@ public:
     inline TypeSymbol* InsertOuterTypeSymbol(NameSymbol*);
     inline void DeleteTypeSymbol(TypeSymbol*);
 
+    inline unsigned NumTypeSymbols();
+    inline unsigned NumSubpackages();
+    inline PackageSymbol* Subpackage(unsigned);
+
     void MarkDeprecated() { status |= DEPRECATED; }
     bool IsDeprecated() { return (status & DEPRECATED) != 0; }
 
@@ -825,6 +864,10 @@ public:
     // (files) need to be recompiled based on the "dependent" relationship.
     int incremental_index;
 
+    // With --incremental-db, the sum of ClassFile::AbiFingerprint over the
+    // class files of this type and its member types (for an outermost type).
+    u8 abi_fingerprint;
+
     unsigned NumLocalConstructorCallEnvironments()
     {
         return local_constructor_call_environments
@@ -1935,6 +1978,7 @@ public:
         if (! anonymous_symbol_pool)
             anonymous_symbol_pool = new ConvertibleArray<TypeSymbol*>(256);
         anonymous_symbol_pool -> Next() = symbol;
+        Account(sizeof(TypeSymbol));
         // not hashed, because anonymous types have no name
     }
 
@@ -1952,6 +1996,7 @@ public:
         if (! type_symbol_pool)
             type_symbol_pool = new Tuple<TypeSymbol*>(256);
         type_symbol_pool -> Next() = symbol;
+        Account(sizeof(TypeSymbol));
         Hash(symbol);
     }
 
@@ -1969,6 +2014,7 @@ public:
         if (! method_symbol_pool)
             method_symbol_pool = new ConvertibleArray<MethodSymbol*>(256);
         method_symbol_pool -> Next() = symbol;
+        Account(sizeof(MethodSymbol));
         // not hashed, because of method overloading
     }
 
@@ -1986,6 +2032,7 @@ public:
         if (! variable_symbol_pool)
             variable_symbol_pool = new ConvertibleArray<VariableSymbol*>(256);
         variable_symbol_pool -> Next() = symbol;
+        Account(sizeof(VariableSymbol));
         Hash(symbol);
     }
 
@@ -1997,11 +2044,13 @@ public:
     {
         return (*other_symbol_pool)[i];
     }
-    void AddOtherSymbol(Symbol* symbol)
+    template <typename SymbolKind>
+    void AddOtherSymbol(SymbolKind* symbol)
     {
         if (! other_symbol_pool)
             other_symbol_pool = new ConvertibleArray<Symbol*>(256);
         other_symbol_pool -> Next() = symbol;
+        Account(sizeof(SymbolKind));
         // not hashed, because not all symbols have names
     }
 
@@ -2036,6 +2085,15 @@ private:
     static unsigned primes[];
     int prime_index;
 
+    size_t bytes; // of the symbols and base, for MemoryAccount
+    void Account(long delta)
+    {
+        bytes += delta;
+        if (delta < 0)
+            MemoryAccount::Free(MemoryAccount::SYMBOLS, - delta);
+        else MemoryAccount::Allocate(MemoryAccount::SYMBOLS, delta);
+    }
+
     unsigned Size()
     {
         return NumAnonymousSymbols() + NumTypeSymbols() + NumMethodSymbols() +
@@ -2347,6 +2405,7 @@ inline void SymbolTable::DeleteTypeSymbol(TypeSymbol* type)
 
     type_symbol_pool -> Reset(last_index); // remove last slot in symbol_pool
     delete type;
+    Account(- (long) sizeof(TypeSymbol));
 }
 
 
@@ -2367,6 +2426,7 @@ inline void SymbolTable::DeleteAnonymousTypes()
         // Now unlink this symbol from its parents
         symbol -> UnlinkFromParents();
         delete symbol;
+        Account(- (long) sizeof(TypeSymbol));
     }
     delete anonymous_symbol_pool;
     anonymous_symbol_pool = NULL;
@@ -2401,6 +2461,36 @@ inline TypeSymbol* PackageSymbol::FindTypeSymbol(const NameSymbol* name_symbol)
 }
 
 
+inline unsigned PackageSymbol::NumTypeSymbols()
+{
+    return table ? table -> NumTypeSymbols() : 0;
+}
+
+
+inline unsigned PackageSymbol::NumSubpackages()
+{
+    return table ? table -> NumOtherSymbols() : 0;
+}
+
+
+inline PackageSymbol* PackageSymbol::Subpackage(unsigned i)
+{
+    return (PackageSymbol*) table -> OtherSym(i);
+}
+
+
+inline unsigned DirectorySymbol::NumOtherSymbols()
+{
+    return table ? table -> NumOtherSymbols() : 0;
+}
+
+
+inline Symbol* DirectorySymbol::OtherSym(unsigned i)
+{
+    return table -> OtherSym(i);
+}
+
+
 inline TypeSymbol* TypeSymbol::FindTypeSymbol(const NameSymbol* name_symbol)
 {
     return table ? table -> FindTypeSymbol(name_symbol)
@@ -1,6 +1,7 @@
 #include "platform.h"
 #include "control.h"
 #include "semantic.h"
+#include "scanner.h"
 #include "zipfile.h"
 #include "option.h"
 #include "case.h"
@@ -199,39 +200,15 @@ void Control::FindPathsToDirectory(PackageSymbol* package)
         {
             for (unsigned i = 0; i < owner_package -> directory.Length(); i++)
             {
-                DirectorySymbol* owner_directory_symbol =
-                    owner_package -> directory[i];
                 DirectorySymbol* subdirectory_symbol =
-                    owner_directory_symbol -> FindDirectorySymbol(package -> Identity());
-                if (! owner_directory_symbol -> IsZip())
+                    owner_package -> directory[i] ->
+                    FindOrReadSubdirectory(package -> Identity());
+                if (subdirectory_symbol)
                 {
-                    if (! subdirectory_symbol)
-                    {
-                        int length =
-                            owner_directory_symbol -> DirectoryNameLength() +
-                            package -> Utf8NameLength() + 1; // +1 for '/'
-                        char* directory_name = new char[length + 1];
-
-                        strcpy(directory_name,
-                               owner_directory_symbol -> DirectoryName());
-                        if (owner_directory_symbol -> DirectoryName()[owner_directory_symbol -> DirectoryNameLength() - 1] != U_SLASH)
-                            strcat(directory_name, StringConstant::U8S_SL);
-                        strcat(directory_name, package -> Utf8Name());
-
-                        if (SystemIsDirectory(directory_name))
-                            subdirectory_symbol = owner_directory_symbol ->
-                                InsertDirectorySymbol(package -> Identity(),
-                                                      owner_directory_symbol -> IsSourceDirectory());
-
-                        delete [] directory_name;
-                    }
-
-                    if (subdirectory_symbol)
+                    if (! subdirectory_symbol -> IsZip())
                         subdirectory_symbol -> ReadDirectory();
-                }
-
-                if (subdirectory_symbol)
                     package -> directory.Next() = subdirectory_symbol;
+                }
             }
         }
         else
@@ -242,35 +219,15 @@ void Control::FindPathsToDirectory(PackageSymbol* package)
             //
             for (unsigned k = 1; k < classpath.Length(); k++)
             {
-                PathSymbol* path_symbol = classpath[k];
                 DirectorySymbol* directory_symbol =
-                    path_symbol -> RootDirectory() -> FindDirectorySymbol(package -> Identity());
-                if (! path_symbol -> IsZip())
+                    classpath[k] -> RootDirectory() ->
+                    FindOrReadSubdirectory(package -> Identity());
+                if (directory_symbol)
                 {
-                    if (! directory_symbol)
-                    {
-                        int length = path_symbol -> Utf8NameLength() +
-                            package -> Utf8NameLength() + 1; // +1 for '/'
-                        char* directory_name = new char[length + 1];
-                        strcpy(directory_name, path_symbol -> Utf8Name());
-                        char tail = path_symbol -> Utf8Name()[path_symbol -> Utf8NameLength() - 1];
-                        if (tail != U_SLASH && tail != U_BACKSLASH)
-                            strcat(directory_name, StringConstant::U8S_SL);
-                        strcat(directory_name, package -> Utf8Name());
-
-                        if (SystemIsDirectory(directory_name))
-                            directory_symbol = path_symbol -> RootDirectory() ->
-                                InsertDirectorySymbol(package -> Identity(),
-                                                      path_symbol -> RootDirectory() -> IsSourceDirectory());
-                        delete [] directory_name;
-                    }
-
-                    if (directory_symbol)
+                    if (! directory_symbol -> IsZip())
                         directory_symbol -> ReadDirectory();
-                }
-
-                if (directory_symbol)
                     package -> directory.Next() = directory_symbol;
+                }
             }
         }
     }
@@ -279,76 +236,54 @@ void Control::FindPathsToDirectory(PackageSymbol* package)
     // Always check unnamed_package directories for source files.
     // These may have been registered by ProcessPackageDeclaration for source
     // files passed on the command line. We do this outside the directory.Length() == 0
-    // check because source root registration may happen after initial package lookup.
+    // check because source root registration may happen after initial package lookup;
+    // only the roots registered since the last call are searched.
     // For subpackages, we walk up the package hierarchy to find the full path.
     //
+    for (; package -> source_roots_searched < unnamed_package -> directory.Length();
+         package -> source_roots_searched++)
     {
-        for (unsigned i = 0; i < unnamed_package -> directory.Length(); i++)
+        DirectorySymbol* root_dir =
+            unnamed_package -> directory[package -> source_roots_searched];
+        if (root_dir -> IsZip())
+            continue;
+
+        // Walk down the directory hierarchy, one package name at a time.
+        // PackageName() returns slashes (e.g., "gnu/classpath/tools")
+        int pkg_path_len = package -> PackageNameLength();
+        const wchar_t* pkg_path = package -> PackageName();
+        DirectorySymbol* dir = root_dir;
+        const wchar_t* p = pkg_path;
+        while (dir && p < pkg_path + pkg_path_len)
         {
-            DirectorySymbol* root_dir = unnamed_package -> directory[i];
-            if (root_dir -> IsZip())
-                continue;
-
-            // Build the full directory path: root_dir + "/" + package_path
-            // PackageName() returns slashes (e.g., "gnu/classpath/tools")
-            int pkg_path_len = package -> PackageNameLength();
-            int length = root_dir -> DirectoryNameLength() + pkg_path_len + 1;
-            char* directory_name = new char[length + 1];
-            strcpy(directory_name, root_dir -> DirectoryName());
-            if (root_dir -> DirectoryName()[root_dir -> DirectoryNameLength() - 1] != U_SLASH)
-                strcat(directory_name, StringConstant::U8S_SL);
+            // Find next component
+            const wchar_t* start = p;
+            while (p < pkg_path + pkg_path_len && *p != U_SLASH)
+                p++;
+            unsigned comp_len = p - start;
+            if (comp_len > 0)
+                dir = dir -> FindOrReadSubdirectory(FindOrInsertName(start,
+                                                                     comp_len));
+            if (p < pkg_path + pkg_path_len)
+                p++; // skip slash
+        }
 
-            // Append package path (converting wchar_t to char)
-            const wchar_t* pkg_path = package -> PackageName();
-            char* ptr = directory_name + strlen(directory_name);
-            for (int j = 0; j < pkg_path_len; j++)
-                *ptr++ = (char) pkg_path[j];
-            *ptr = '\0';
+        if (dir && dir != root_dir)
+        {
+            dir -> ReadDirectory();
 
-            if (SystemIsDirectory(directory_name))
+            // Check if already added
+            bool found = false;
+            for (unsigned j = 0; j < package -> directory.Length(); j++)
             {
-                // Walk down the directory hierarchy creating DirectorySymbols
-                DirectorySymbol* dir = root_dir;
-                const wchar_t* p = pkg_path;
-                while (p < pkg_path + pkg_path_len)
-                {
-                    // Find next component
-                    const wchar_t* start = p;
-                    while (p < pkg_path + pkg_path_len && *p != U_SLASH)
-                        p++;
-                    unsigned comp_len = p - start;
-                    if (comp_len > 0)
-                    {
-                        NameSymbol* name_sym = FindOrInsertName(start, comp_len);
-                        DirectorySymbol* subdir = dir -> FindDirectorySymbol(name_sym);
-                        if (! subdir)
-                            subdir = dir -> InsertDirectorySymbol(name_sym,
-                                                                  root_dir -> IsSourceDirectory());
-                        dir = subdir;
-                    }
-                    if (p < pkg_path + pkg_path_len)
-                        p++; // skip slash
-                }
-
-                if (dir && dir != root_dir)
+                if (package -> directory[j] == dir)
                 {
-                    dir -> ReadDirectory();
-
-                    // Check if already added
-                    bool found = false;
-                    for (unsigned j = 0; j < package -> directory.Length(); j++)
-                    {
-                        if (package -> directory[j] == dir)
-                        {
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (! found)
-                        package -> directory.Next() = dir;
+                    found = true;
+                    break;
                 }
             }
-            delete [] directory_name;
+            if (! found)
+                package -> directory.Next() = dir;
         }
     }
 }
@@ -486,10 +421,13 @@ void Control::ProcessPath()
     //
     //
 
+    PrefetchArchives();
     ProcessBootClassPath();
     ProcessExtDirs();
     ProcessClassPath();
     ProcessSourcePath();
+    delete zip_prefetcher;
+    zip_prefetcher = NULL;
 
     //
     // TODO: If the user did not specify "." in the class path we assume it.
@@ -499,6 +437,103 @@ void Control::ProcessPath()
         unnamed_package -> directory.Next() = classpath[0] -> RootDirectory();
 }
 
+//
+// With more than one thread (-j), start reading the archives on the paths
+// on worker threads, for the Process...Path functions below to take over
+// as they come to them (see OpenZip). Only the opening of the archives and
+// the parsing of their central directories is done ahead of time; the
+// symbols are entered on this thread, in path order, as without.
+//
+void Control::PrefetchArchives()
+{
+    unsigned num_threads = option.Threads(1);
+    if (num_threads <= 1)
+        return;
+
+    //
+    // Every name on the paths, except for those of extension directories,
+    // which are replaced by the zip and jar files in them. There is no
+    // telling a directory from an archive without a stat, which is left to
+    // the worker: a directory is read as no archive, and never taken.
+    //
+    Tuple<char*> file_names(8);
+    const char* path_lists[] = {
+        option.bootclasspath, option.extdirs, option.classpath,
+        option.sourcepath
+    };
+    for (unsigned i = 0; i < sizeof(path_lists) / sizeof(path_lists[0]); i++)
+    {
+        const char* path_list = path_lists[i];
+        if (! path_list)
+            continue;
+        for (const char* head = path_list; *head; )
+        {
+            const char* tail = head;
+            while (*tail && *tail != PathSeparator())
+                tail++;
+            int length = tail - head;
+            if (length > 0 && path_list != option.extdirs)
+            {
+                char* file_name = new char[length + 1];
+                strncpy(file_name, head, length);
+                file_name[length] = U_NULL;
+                file_names.Next() = file_name;
+            }
+#ifdef UNIX_FILE_SYSTEM
+            else if (length > 0)
+            {
+                // The same names that ProcessExtDirs makes.
+                char* directory_name = new char[length + 1];
+                strncpy(directory_name, head, length);
+                directory_name[length] = U_NULL;
+                DIR* extdir = opendir(directory_name);
+                for (dirent* entry = extdir ? readdir(extdir) : NULL; entry;
+                     entry = readdir(extdir))
+                {
+                    int entry_length = strlen(entry -> d_name);
+                    if (entry_length < 3 ||
+                        (strcasecmp(&entry -> d_name[entry_length - 3], "zip") &&
+                         strcasecmp(&entry -> d_name[entry_length - 3], "jar")))
+                    {
+                        continue;
+                    }
+                    char* file_name = new char[length + entry_length + 2];
+                    strcpy(file_name, directory_name);
+                    if (directory_name[length - 1] != U_SLASH)
+                        strcat(file_name, U8S_SL);
+                    strcat(file_name, entry -> d_name);
+                    file_names.Next() = file_name;
+                }
+                if (extdir)
+                    closedir(extdir);
+                delete [] directory_name;
+            }
+#endif
+            head = *tail ? tail + 1 : tail;
+        }
+    }
+
+    if (file_names.Length() > 1)
+        zip_prefetcher = new ZipPrefetcher(file_names, num_threads);
+    else
+    {
+        for (unsigned i = 0; i < file_names.Length(); i++)
+            delete [] file_names[i];
+    }
+}
+
+
+//
+// The Zip of the named archive, read ahead of time if it was.
+//
+Zip* Control::OpenZip(char* file_name, bool source_only)
+{
+    ZipArchive* archive =
+        zip_prefetcher ? zip_prefetcher -> Take(file_name) : NULL;
+    return new Zip(*this, file_name, source_only, archive);
+}
+
+
 void Control::ProcessBootClassPath()
 {
     if (option.bootclasspath)
@@ -506,10 +541,12 @@ void Control::ProcessBootClassPath()
         // The longest possible path name we can encounter
         int max_path_name_length = strlen(option.bootclasspath) + 1;
         wchar_t* path_name = new wchar_t[max_path_name_length + 1];
+        char* path_list = new char[max_path_name_length]; // split in place
+        strcpy(path_list, option.bootclasspath);
 
         wchar_t* input_name = NULL;
 
-        for (char* path = option.bootclasspath,
+        for (char* path = path_list,
                  * path_tail = &path[strlen(path)];
              path < path_tail; path++)
         {
@@ -576,7 +613,7 @@ void Control::ProcessBootClassPath()
                 else
                 {
                     errno = 0;
-                    Zip* zipinfo = new Zip(*this, head);
+                    Zip* zipinfo = OpenZip(head);
                     if (! zipinfo -> IsValid())
                     {
                         // If the zipfile is all screwed up, give up here !!!
@@ -621,6 +658,7 @@ void Control::ProcessBootClassPath()
         }
 
         delete [] path_name;
+        delete [] path_list;
     }
 }
 
@@ -632,10 +670,12 @@ void Control::ProcessExtDirs()
         // The longest possible path name we can encounter
         int max_path_name_length = strlen(option.extdirs) + 1;
         wchar_t* path_name = new wchar_t[max_path_name_length + 1];
+        char* path_list = new char[max_path_name_length]; // split in place
+        strcpy(path_list, option.extdirs);
 
         wchar_t* input_name = NULL;
 
-        for (char* path = option.extdirs, *path_tail = &path[strlen(path)];
+        for (char* path = path_list, *path_tail = &path[strlen(path)];
              path < path_tail; path++)
         {
             char* head;
@@ -720,7 +760,7 @@ void Control::ProcessExtDirs()
                                 extdir_entry_name[i] = extdir_entry[i];
 
                             errno = 0;
-                            Zip* zipinfo = new Zip(*this, extdir_entry);
+                            Zip* zipinfo = OpenZip(extdir_entry);
                             if (! zipinfo -> IsValid())
                             {
                                 wchar_t* name =
@@ -773,6 +813,7 @@ void Control::ProcessExtDirs()
 
 
         delete [] path_name;
+        delete [] path_list;
     }
 }
 
@@ -783,10 +824,12 @@ void Control::ProcessClassPath()
         // The longest possible path name we can encounter.
         int max_path_name_length = strlen(option.classpath) + 1;
         wchar_t* path_name = new wchar_t[max_path_name_length + 1];
+        char* path_list = new char[max_path_name_length]; // split in place
+        strcpy(path_list, option.classpath);
 
         wchar_t* input_name = NULL;
 
-        for (char* path = option.classpath, *path_tail = &path[strlen(path)];
+        for (char* path = path_list, *path_tail = &path[strlen(path)];
              path < path_tail; path++)
         {
             char* head;
@@ -851,7 +894,7 @@ void Control::ProcessClassPath()
                 else
                 {
                     errno = 0;
-                    Zip* zipinfo = new Zip(*this, head);
+                    Zip* zipinfo = OpenZip(head);
                     // If the zipfile is all screwed up, give up here !!!
                     if (! zipinfo -> IsValid())
                     {
@@ -897,6 +940,7 @@ void Control::ProcessClassPath()
 
 
         delete [] path_name;
+        delete [] path_list;
     }
 }
 
@@ -907,10 +951,12 @@ void Control::ProcessSourcePath()
         // The longest possible path name we can encounter.
         int max_path_name_length = strlen(option.sourcepath) + 1;
         wchar_t* path_name = new wchar_t[max_path_name_length + 1];
+        char* path_list = new char[max_path_name_length]; // split in place
+        strcpy(path_list, option.sourcepath);
 
         wchar_t* input_name = NULL;
 
-        for (char* path = option.sourcepath, *path_tail = &path[strlen(path)];
+        for (char* path = path_list, *path_tail = &path[strlen(path)];
              path < path_tail; path++)
         {
             char* head;
@@ -969,18 +1015,49 @@ void Control::ProcessSourcePath()
                 }
                 else
                 {
-                    // We don't process zip files as source directories
-                    wchar_t* name = new wchar_t[input_name_length + 1];
-                    for (int i = 0; i < input_name_length; i++)
-                        name[i] = input_name[i];
-                    name[input_name_length] = U_NULL;
-                    bad_dirnames.Next() = name;
+                    // A source zip or jar: only its .java files count
+                    errno = 0;
+                    Zip* zipinfo = OpenZip(head, true);
+                    if (! zipinfo -> IsValid())
+                    {
+                        wchar_t* name = new wchar_t[input_name_length + 1];
+                        for (int i = 0; i < input_name_length; i++)
+                            name[i] = input_name[i];
+                        name[input_name_length] = U_NULL;
+                        if (errno)
+                        {
+                            const char* std_err = strerror(errno);
+                            ErrorString err_str;
+                            err_str << '"' << std_err << '"'
+                                    << " while trying to open " << name;
+                            general_io_warnings.Next() = err_str.SafeArray();
+                        }
+                        else
+                        {
+                            wchar_t* tail = &name[input_name_length - 3];
+                            if (Case::StringSegmentEqual(tail, US_zip, 3) ||
+                                Case::StringSegmentEqual(tail, US_jar, 3))
+                            {
+                                bad_zip_filenames.Next() = name;
+                            }
+                            else bad_dirnames.Next() = name;
+                        }
+                    }
+
+                    unnamed_package -> directory.Next() =
+                        zipinfo -> RootDirectory();
+                    PathSymbol* path_symbol =
+                        classpath_table.InsertPathSymbol(name_symbol,
+                                                         zipinfo -> RootDirectory());
+                    path_symbol -> zipfile = zipinfo;
+                    classpath.Next() = path_symbol;
                 }
             }
         }
 
 
         delete [] path_name;
+        delete [] path_list;
     }
 }
 
@@ -1044,6 +1121,89 @@ TypeSymbol* Control::ProcessSystemType(PackageSymbol* package,
 }
 
 
+//
+// Read the types of the system packages that nearly every compilation
+// uses, into a Control that is going to be reused (see server.h). Only the
+// packages found in archives alone are read, as those cannot change behind
+// our back. The result is only fit for reuse if nothing else was dragged
+// in along the way: no source files, no class files from directories, and
+// no diagnostics. Returns false otherwise, and the Control should then be
+// discarded.
+//
+bool Control::PreloadSystemTypes()
+{
+    assert(! system_semantic);
+
+    FileSymbol* file_symbol = new FileSymbol(dot_name_symbol);
+    file_symbol -> directory_symbol =
+        classpath[dot_classpath_index] -> RootDirectory();
+    file_symbol -> SetJava();
+    file_symbol -> semantic = new Semantic(*this, file_symbol);
+    system_semantic = file_symbol -> semantic;
+    scanner -> SetUp(file_symbol);
+
+    PackageSymbol* packages[] = {
+        LangPackage(), UtilPackage(), IoPackage(), AnnotationPackage()
+    };
+    for (unsigned p = 0; p < sizeof(packages) / sizeof(packages[0]); p++)
+    {
+        PackageSymbol* package = packages[p];
+        bool archived = package -> directory.Length() > 0;
+        unsigned k;
+        for (k = 0; k < package -> directory.Length(); k++)
+        {
+            if (! package -> directory[k] -> IsZip())
+                archived = false;
+        }
+        if (! archived)
+            continue;
+
+        for (k = 0; k < package -> directory.Length(); k++)
+        {
+            DirectorySymbol* directory_symbol = package -> directory[k];
+            for (unsigned i = 0; i < directory_symbol -> NumOtherSymbols(); i++)
+            {
+                FileSymbol* entry = directory_symbol -> OtherSym(i) ->
+                    FileCast();
+                // Nested types are read along with their outermost type.
+                if (! entry || ! entry -> IsClass() ||
+                    wcschr(entry -> Name(), U_DOLLAR))
+                {
+                    continue;
+                }
+
+                NameSymbol* name_symbol =
+                    FindOrInsertName(entry -> Name(), entry -> NameLength());
+                if (package -> FindTypeSymbol(name_symbol))
+                    continue;
+                Control& control = *this;
+                FileSymbol* class_file = GetFile(control, package,
+                                                 name_symbol);
+                if (class_file && class_file -> IsClass())
+                    system_semantic -> ReadType(class_file, package,
+                                                name_symbol, 0);
+            }
+        }
+    }
+
+    bool reusable = system_semantic -> NumErrors() == 0 &&
+        system_semantic -> NumWarnings() == 0 &&
+        input_java_file_set.Size() == 0 &&
+        type_trash_bin.Length() == 0;
+    for (FileSymbol* class_file = (FileSymbol*) input_class_file_set.FirstElement();
+         class_file && reusable;
+         class_file = (FileSymbol*) input_class_file_set.NextElement())
+    {
+        reusable = class_file -> IsZip();
+    }
+
+    delete system_semantic;
+    system_semantic = NULL;
+    delete file_symbol;
+    return reusable && ReloadPackages();
+}
+
+
 //
 // Find the given system method.
 //
@@ -1127,15 +1287,19 @@ DirectorySymbol* Control::GetOutputDirectory(FileSymbol* file_symbol)
 {
     DirectorySymbol* directory_symbol;
 
-    // A FileSymbol for a .class file has a NULL semantic.
+    // A FileSymbol for a .class file has a NULL semantic. Without -d, the
+    // classes of a source in a zip file go to the current directory.
     if (file_symbol -> semantic == NULL ||
-        (file_symbol -> semantic -> control).option.directory == NULL) {
+        ((file_symbol -> semantic -> control).option.directory == NULL &&
+         ! file_symbol -> IsZip())) {
         directory_symbol = file_symbol -> directory_symbol;
     }
     else
     {
         Control& control = file_symbol -> semantic -> control;
-        char* directory_prefix = control.option.directory;
+        const char* directory_prefix = control.option.directory
+            ? control.option.directory
+            : control.dot_name_symbol -> Utf8Name();
         int directory_prefix_length = strlen(directory_prefix);
         int utf8_name_length =
             file_symbol -> package -> PackageNameLength() * 3;
@@ -1233,7 +1397,7 @@ FileSymbol* Control::GetJavaFile(PackageSymbol* package,
 
             file_symbol -> directory_symbol = directory_symbol;
             file_symbol -> SetJava();
-            file_symbol -> mtime = entry -> Mtime();
+            file_symbol -> DeferMtime();
         }
     }
 
@@ -1303,14 +1467,18 @@ FileSymbol* Control::GetFileBoth(Control& control, PackageSymbol* package,
                          class_entry -> Mtime() < java_entry -> Mtime()))
                     {
                         file_symbol -> SetJava();
-                        file_symbol -> mtime = java_entry -> Mtime();
+                        if (class_entry)
+                            file_symbol -> SetMtime(java_entry -> Mtime());
+                        else file_symbol -> DeferMtime();
                     }
                     else
                     {
                         if (java_entry)
                             file_symbol -> SetClass();
                         else file_symbol -> SetClassOnly();
-                        file_symbol -> mtime = class_entry -> Mtime();
+                        if (java_entry)
+                            file_symbol -> SetMtime(class_entry -> Mtime());
+                        else file_symbol -> DeferMtime();
                     }
                 }
 
@@ -1349,7 +1517,7 @@ FileSymbol* Control::GetFileBoth(Control& control, PackageSymbol* package,
     //
     if (java_file_symbol &&
         (! class_file_symbol ||
-         class_file_symbol -> mtime < java_file_symbol -> mtime))
+         class_file_symbol -> Mtime() < java_file_symbol -> Mtime()))
     {
         return java_file_symbol;
     }
@@ -1406,14 +1574,18 @@ FileSymbol* Control::GetFileFirst(Control& control, PackageSymbol* package,
                      class_entry -> Mtime() < java_entry -> Mtime()))
                 {
                     file_symbol -> SetJava();
-                    file_symbol -> mtime = java_entry -> Mtime();
+                    if (class_entry)
+                        file_symbol -> SetMtime(java_entry -> Mtime());
+                    else file_symbol -> DeferMtime();
                 }
                 else
                 {
                     if (java_entry)
                          file_symbol -> SetClass();
                     else file_symbol -> SetClassOnly();
-                    file_symbol -> mtime = class_entry -> Mtime();
+                    if (java_entry)
+                        file_symbol -> SetMtime(class_entry -> Mtime());
+                    else file_symbol -> DeferMtime();
                 }
                 break;
             }
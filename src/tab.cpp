@@ -5,10 +5,10 @@ namespace Jopa { // Open namespace Jopa block
 int Tab::tab_size = Tab::DEFAULT_TAB_SIZE;
 
 //
-// Compute the length of a wide character string segment after expanding tabs,
+// Compute the length of a segment of the input buffer after expanding tabs,
 // and any non-printable ASCII characters in unicode expansion mode.
 //
-int Tab::Wcslen(wchar_t *line, int start, int end)
+int Tab::Wcslen(const SourceChar* line, int start, int end)
 {
     bool expand = Coutput.ExpandWchar();
     for (int i = start--; i <= end; i++)
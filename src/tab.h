@@ -12,7 +12,7 @@ public:
     inline static int TabSize() { return tab_size; }
     inline static void SetTabSize(int value) { tab_size = value; }
 
-    static int Wcslen(wchar_t *line, int start, int end);
+    static int Wcslen(const SourceChar* line, int start, int end);
 
 private:
     static int tab_size;
@@ -505,6 +505,55 @@ public:
             buffer.Next() = *u++;
     }
 
+    inline unsigned Length() const { return buffer.top; }
+
+    //
+    // Copy the Length() bytes of the buffer to dest.
+    //
+    inline void CopyTo(u1* dest) const
+    {
+        if (buffer.top == 0)
+            return;
+        unsigned size = 0;
+        unsigned n = (buffer.top - 1) >> buffer.log_blksize;
+        for (unsigned i = 0; i < n; i++)
+        {
+            memcpy(dest + size, buffer.base[i] + size, buffer.Blksize());
+            size += buffer.Blksize();
+        }
+        memcpy(dest + size, buffer.base[n] + size, buffer.top - size);
+    }
+
+    //
+    // Whether file_name already holds exactly what is in the buffer. The
+    // sizes are compared first, so that a file that changed in size is
+    // not even read.
+    //
+    inline bool SameAsFile(const char* file_name)
+    {
+        JopaAPI* api = JopaAPI::getInstance();
+        struct stat status;
+        if (api -> stat(file_name, &status) != 0 ||
+            (size_t) status.st_size != buffer.top || buffer.top == 0)
+        {
+            return false;
+        }
+
+        JopaAPI::FileReader* file = api -> read(file_name);
+        const char* data = file ? file -> getBuffer() : NULL;
+        bool same = data && file -> getBufferSize() == buffer.top;
+        unsigned size = 0;
+        unsigned n = (buffer.top - 1) >> buffer.log_blksize;
+        for (unsigned i = 0; same && i <= n; i++)
+        {
+            unsigned length = (i < n ? buffer.Blksize() : buffer.top - size);
+            same = memcmp(data + size, buffer.base[i] + size, length) == 0;
+            size += length;
+        }
+        delete file;
+        return same;
+    }
+
     inline bool WriteToFile(const char* file_name)
     {
         JopaAPI::FileWriter* file =
@@ -0,0 +1,241 @@
+#include "watch.h"
+#include "symbol.h"
+
+#ifdef HAVE_SYS_INOTIFY_H
+# include <poll.h>
+# include <sys/inotify.h>
+#endif
+
+
+namespace Jopa { // Open namespace Jopa block
+
+
+SourceWatcher::SourceWatcher()
+    : fd(-1)
+    , cycle(0)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    fd = inotify_init1(IN_CLOEXEC);
+#endif
+}
+
+
+SourceWatcher::~SourceWatcher()
+{
+    if (fd >= 0)
+        close(fd);
+}
+
+
+void SourceWatcher::Watch(DirectorySymbol* directory)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    if (fd < 0 || directory -> IsZip())
+        return;
+
+    int wd = inotify_add_watch(fd, directory -> DirectoryName(),
+                               IN_ONLYDIR | IN_EXCL_UNLINK | IN_CLOSE_WRITE |
+                               IN_ATTRIB | IN_CREATE | IN_DELETE |
+                               IN_MOVED_FROM | IN_MOVED_TO);
+    if (wd >= 0)
+        directories[wd] = directory;
+#else
+    (void) directory;
+#endif
+}
+
+
+//
+// Take in the events that are pending, and return whether any of them may
+// have changed a source file.
+//
+bool SourceWatcher::ReadEvents()
+{
+    bool changed = false;
+#ifdef HAVE_SYS_INOTIFY_H
+    alignas(struct inotify_event) char buffer[16 * 1024];
+    ssize_t length = read(fd, buffer, sizeof(buffer));
+    if (length < 0)
+        return false;
+
+    for (char* p = buffer; p < buffer + length;
+         p += sizeof(struct inotify_event) + ((struct inotify_event*) p) -> len)
+    {
+        struct inotify_event* event = (struct inotify_event*) p;
+        if (event -> mask & IN_Q_OVERFLOW)
+        {
+            // Events were lost; the time stamps will have to tell.
+            changed = true;
+            continue;
+        }
+        if (event -> mask & IN_IGNORED)
+        {
+            directories.erase(event -> wd);
+            continue;
+        }
+
+        std::map<int, DirectorySymbol*>::iterator directory =
+            directories.find(event -> wd);
+        if (directory == directories.end() || event -> len == 0 ||
+            (event -> mask & IN_ISDIR))
+        {
+            continue;
+        }
+
+        //
+        // Only source files count: class files (and the output of this very
+        // compiler, when -d is on the class path) do not call for a
+        // recompilation.
+        //
+        std::string name(event -> name);
+        size_t suffix_length = FileSymbol::java_suffix_length;
+        if (name.length() <= suffix_length ||
+            name.compare(name.length() - suffix_length, suffix_length,
+                         FileSymbol::java_suffix) != 0)
+        {
+            continue;
+        }
+
+        std::pair<DirectorySymbol*, std::string> change(directory -> second,
+                                                        name);
+        unsigned i;
+        for (i = 0; i < changes.size() && changes[i] != change; i++)
+            ;
+        if (i == changes.size())
+            changes.push_back(change);
+        changed = true;
+    }
+#endif
+    return changed;
+}
+
+
+bool SourceWatcher::WaitForChanges(int delay)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+    struct pollfd poll_fd;
+    poll_fd.fd = fd;
+    poll_fd.events = POLLIN;
+
+    bool changed = false;
+    while (! changed)
+    {
+        if (fd < 0 || directories.empty())
+            return false;
+        int ready = poll(&poll_fd, 1, -1);
+        if (ready < 0 && errno != EINTR)
+            return false;
+        if (ready > 0)
+            changed = ReadEvents();
+    }
+
+    for (;;)
+    {
+        int ready = poll(&poll_fd, 1, delay);
+        if (ready < 0 && errno != EINTR)
+            return false;
+        if (ready == 0)
+            break;
+        if (ready > 0)
+            ReadEvents();
+    }
+    return true;
+#else
+    (void) delay;
+    return false;
+#endif
+}
+
+
+void SourceWatcher::StartCycle()
+{
+    cycle_start = std::chrono::steady_clock::now();
+}
+
+
+void SourceWatcher::Removed(FileSymbol* file_symbol)
+{
+    removed.push_back(file_symbol -> FileName());
+}
+
+
+static void AppendJsonString(std::string& out, const char* value)
+{
+    out += '"';
+    for (const char* p = value; *p; p++)
+    {
+        unsigned char c = *p;
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else out += c;
+    }
+    out += '"';
+}
+
+
+static void AppendJsonArray(std::string& out, const char* key,
+                            const std::vector<std::string>& values)
+{
+    out += ",\"";
+    out += key;
+    out += "\":[";
+    for (unsigned i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+            out += ',';
+        AppendJsonString(out, values[i].c_str());
+    }
+    out += ']';
+}
+
+
+void SourceWatcher::Report(FileSymbol** recompiled, unsigned num_recompiled,
+                           int return_code)
+{
+    long time = std::chrono::duration_cast<std::chrono::milliseconds>
+        (std::chrono::steady_clock::now() - cycle_start).count();
+
+    std::vector<std::string> changed_files;
+    for (unsigned i = 0; i < changes.size(); i++)
+    {
+        std::string path(changes[i].first -> DirectoryName());
+        if (path == ".")
+            path = changes[i].second; // as the input files are named
+        else path += '/' + changes[i].second;
+        changed_files.push_back(path);
+    }
+    std::vector<std::string> recompiled_files;
+    for (unsigned i = 0; i < num_recompiled; i++)
+        recompiled_files.push_back(recompiled[i] -> FileName());
+
+    std::string summary("{\"cycle\":");
+    summary += std::to_string(cycle);
+    AppendJsonArray(summary, "changed", changed_files);
+    AppendJsonArray(summary, "recompiled", recompiled_files);
+    AppendJsonArray(summary, "removed", removed);
+    summary += ",\"return_code\":" + std::to_string(return_code);
+    summary += ",\"time_ms\":" + std::to_string(time) + "}";
+
+    //
+    // Always on standard output, whatever -Xstdout says of the diagnostics.
+    //
+    printf("%s\n", summary.c_str());
+    fflush(stdout);
+
+    changes.clear();
+    removed.clear();
+    cycle++;
+}
+
+
+} // Close namespace Jopa block
+
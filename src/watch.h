@@ -0,0 +1,80 @@
+#pragma once
+
+#include "platform.h"
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+
+namespace Jopa { // Open namespace Jopa block
+class DirectorySymbol;
+class FileSymbol;
+
+
+//
+// The source watcher of --watch, which replaces the prompt between the
+// compilations of ++: it blocks until a source file changes in one of the
+// directories it was told to watch, and then until no further change has
+// come in for a while, so that a burst of changes (a save of several files,
+// a checkout) makes for a single recompilation. It also keeps the record of
+// each cycle, and prints it as a single line of JSON on standard output when
+// the cycle is over:
+//
+//   {"cycle":1,"changed":[...],"recompiled":[...],"removed":[...],
+//    "return_code":0,"time_ms":35}
+//
+// where changed lists the source files reported by the system, and
+// recompiled and removed what the dependence analysis of ++ made of them.
+//
+class SourceWatcher
+{
+public:
+    SourceWatcher();
+    ~SourceWatcher();
+
+    bool Valid() { return fd >= 0; }
+
+    //
+    // Watch directory (again, as it may have been recreated since); a
+    // directory in a zip file is skipped.
+    //
+    void Watch(DirectorySymbol* directory);
+
+    //
+    // Wait for a change in the watched directories, and for delay
+    // milliseconds without one. Returns false if the changes cannot be
+    // watched (any more).
+    //
+    bool WaitForChanges(int delay);
+
+    //
+    // A cycle runs from StartCycle to Report, which prints its summary. The
+    // first cycle, number 0, is the initial compilation.
+    //
+    void StartCycle();
+
+    unsigned NumChanges() { return changes.size(); }
+    DirectorySymbol* ChangedDirectory(unsigned i) { return changes[i].first; }
+    const std::string& ChangedFile(unsigned i) { return changes[i].second; }
+
+    void Removed(FileSymbol*);
+    void Report(FileSymbol** recompiled, unsigned num_recompiled,
+                int return_code);
+
+private:
+    int fd; // the inotify instance, or -1
+    std::map<int, DirectorySymbol*> directories; // by watch descriptor
+    std::vector<std::pair<DirectorySymbol*, std::string> > changes; // as seen
+    std::vector<std::string> removed;
+
+    unsigned cycle;
+    std::chrono::steady_clock::time_point cycle_start;
+
+    bool ReadEvents();
+};
+
+
+} // Close namespace Jopa block
+
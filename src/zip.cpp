@@ -3,6 +3,11 @@
 #include "symbol.h"
 #include <cstring>
 #include <cstdio>
+#include <fcntl.h>
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
+#include <zlib.h>
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -12,85 +17,93 @@ namespace Jopa { // Open namespace Jopa block
 //
 //************************************************************
 
-ZipFile::ZipFile(FileSymbol *file_symbol) : buffer(NULL)
+//
+// The scratch buffer of a thread, and whether a ZipFile is using it.
+//
+struct InflateScratch
 {
-    Zip *zip = file_symbol -> Zipfile();
+    char *buffer;
+    u4 size;
+    bool busy;
 
-    assert(zip -> IsValid());
+    InflateScratch() : buffer(NULL), size(0), busy(false) {}
+    ~InflateScratch() { delete [] buffer; }
+};
 
-    // Build the full path within the ZIP: directory/name.class or directory/name.java
-    DirectorySymbol *dir = file_symbol -> directory_symbol;
-    int path_length = 0;
+static thread_local InflateScratch inflate_scratch;
 
-    // Calculate total path length
-    for (DirectorySymbol *d = dir; d && d -> Identity() != d -> owner -> Identity(); d = (DirectorySymbol*) d -> owner)
-    {
-        path_length += d -> Utf8NameLength() + 1; // +1 for '/'
-    }
-    path_length += file_symbol -> Utf8NameLength();
-    path_length += (file_symbol -> IsJava() ? FileSymbol::java_suffix_length : FileSymbol::class_suffix_length);
 
-    char *zip_path = new char[path_length + 1];
-    zip_path[0] = '\0';
+ZipFile::ZipFile(FileSymbol *file_symbol) : buffer(NULL),
+                                            own_buffer(NULL),
+                                            scratch(false)
+{
+    Zip *zip = file_symbol -> Zipfile();
+
+    assert(zip -> IsValid());
+
+    const u1 *data = zip -> EntryData(file_symbol);
+    if (! data)
+        return;
 
-    // Build path from root to file
-    DirectorySymbol **dir_stack = new DirectorySymbol*[100]; // reasonable max depth
-    int depth = 0;
-    for (DirectorySymbol *d = dir; d && d -> Identity() != d -> owner -> Identity(); d = (DirectorySymbol*) d -> owner)
+    u4 size = file_symbol -> uncompressed_size;
+    if (file_symbol -> compression_method == Zip::STORED)
     {
-        dir_stack[depth++] = d;
+        if (file_symbol -> compressed_size == size)
+            buffer = (const char *) data;
     }
-
-    for (int i = depth - 1; i >= 0; i--)
+    else if (file_symbol -> compression_method == Zip::DEFLATED)
     {
-        const char* dir_name = dir_stack[i] -> Utf8Name();
-        // Skip the root "." directory
-        if (strcmp(dir_name, ".") != 0)
-        {
-            strcat(zip_path, dir_name);
-            strcat(zip_path, "/");
-        }
+        char *output = InflateBuffer(size);
+
+        z_stream stream;
+        memset(&stream, 0, sizeof(stream));
+        stream.next_in = const_cast<u1 *>(data);
+        stream.avail_in = file_symbol -> compressed_size;
+        stream.next_out = (Bytef *) output;
+        stream.avail_out = size;
+
+        // Negative window bits: raw deflate data, without a zlib header.
+        bool inflated = inflateInit2(&stream, -MAX_WBITS) == Z_OK &&
+                        inflate(&stream, Z_FINISH) == Z_STREAM_END &&
+                        stream.total_out == size;
+        inflateEnd(&stream);
+        if (inflated)
+            buffer = output;
     }
+}
 
-    strcat(zip_path, file_symbol -> Utf8Name());
-    strcat(zip_path, file_symbol -> IsJava() ? FileSymbol::java_suffix : FileSymbol::class_suffix);
-
-    delete [] dir_stack;
+ZipFile::~ZipFile()
+{
+    if (scratch)
+        inflate_scratch.busy = false;
+    delete [] own_buffer;
+}
 
-    // Open and read the file from the ZIP
-    // Try without "./" prefix first, then with it for compatibility
-    zip_file_t *zf = zip_fopen(zip->zip_archive, zip_path, 0);
 
-    if (!zf && zip_path[0] != '.' && zip_path[0] != '/')
+//
+// Return a buffer of the given size to inflate into: the scratch buffer of
+// the thread (grown as needed) if it is free, or else one of our own.
+//
+char *ZipFile::InflateBuffer(u4 size)
+{
+    if (inflate_scratch.busy)
     {
-        // Try with "./" prefix
-        char *alt_path = new char[path_length + 3];
-        strcpy(alt_path, "./");
-        strcat(alt_path, zip_path);
-        zf = zip_fopen(zip->zip_archive, alt_path, 0);
-        delete [] alt_path;
+        own_buffer = new char[size];
+        return own_buffer;
     }
 
-    if (zf)
+    if (inflate_scratch.size < size || ! inflate_scratch.buffer)
     {
-        buffer = new char[file_symbol->uncompressed_size];
-        zip_int64_t bytes_read = zip_fread(zf, buffer, file_symbol->uncompressed_size);
-
-        if (bytes_read != (zip_int64_t)file_symbol->uncompressed_size)
-        {
-            delete [] buffer;
-            buffer = NULL;
-        }
-
-        zip_fclose(zf);
+        u4 new_size = inflate_scratch.size * 2;
+        if (new_size < size)
+            new_size = size;
+        delete [] inflate_scratch.buffer;
+        inflate_scratch.buffer = new char[new_size ? new_size : 1];
+        inflate_scratch.size = new_size;
     }
-
-    delete [] zip_path;
-}
-
-ZipFile::~ZipFile()
-{
-    delete [] buffer;
+    inflate_scratch.busy = true;
+    scratch = true;
+    return inflate_scratch.buffer;
 }
 
 
@@ -135,19 +148,14 @@ NameSymbol *Zip::ProcessFilename(const char *name, int name_length)
 }
 
 
-void Zip::ProcessDirectoryEntry(zip_int64_t index)
+void Zip::ProcessDirectoryEntry(const ZipArchive::Entry &entry)
 {
-    struct zip_stat st;
-    zip_stat_init(&st);
-
-    if (zip_stat_index(zip_archive, index, 0, &st) != 0)
+    const char *name = entry.name;
+    int file_name_length = entry.name_length;
+    u4 date_time = entry.date_time;
+    if (file_name_length == 0)
         return;
 
-    const char *name = st.name;
-    int file_name_length = strlen(name);
-    u4 uncompressed_size = st.size;
-    u4 date_time = st.mtime; // Use modification time from stat
-
     //
     // Note that we need to process all subdirectory entries
     // that appear in the zip file, and not just the ones that
@@ -172,15 +180,29 @@ void Zip::ProcessDirectoryEntry(zip_int64_t index)
              class_file = (static_cast<unsigned>(file_name_length) >= FileSymbol::class_suffix_length &&
                            FileSymbol::IsClassSuffix(const_cast<char*>(&name[file_name_length - FileSymbol::class_suffix_length])));
 
-        if (java_file || class_file)
+        if (java_file || (class_file && ! source_only))
         {
             int name_length = file_name_length - (java_file ? FileSymbol::java_suffix_length : FileSymbol::class_suffix_length);
             int i;
             for (i = name_length - 1; i >= 0 && name[i] != U_SLASH; i--)
                 ;
-            if (i > 0) // directory specified?
+            //
+            // The entries of a directory usually come one after the other,
+            // so the directory of the last one is kept at hand.
+            //
+            if (i > 0 && i == last_directory_name_length &&
+                memcmp(name, last_directory_name, i) == 0)
+            {
+                directory_symbol = last_directory;
+            }
+            else if (i > 0) // directory specified?
+            {
                 directory_symbol = ProcessSubdirectoryEntries(directory_symbol,
                                                               name, i);
+                last_directory_name = name;
+                last_directory_name_length = i;
+                last_directory = directory_symbol;
+            }
             NameSymbol *name_symbol = ProcessFilename(&name[i + 1],
                                                       name_length - (i + 1));
 
@@ -203,71 +225,382 @@ void Zip::ProcessDirectoryEntry(zip_int64_t index)
                 if (java_file)
                      file_symbol -> SetJava();
                 else file_symbol -> SetClassOnly();
-
-                file_symbol -> uncompressed_size = uncompressed_size;
-                file_symbol -> date_time = date_time;
             }
             else if (file_symbol -> date_time < date_time)
             {
                 if (java_file)
                      file_symbol -> SetJava();
                 else file_symbol -> SetClass();
-
-                file_symbol -> uncompressed_size = uncompressed_size;
-                file_symbol -> date_time = date_time;
             }
+            else return;
+
+            file_symbol -> uncompressed_size = entry.uncompressed_size;
+            file_symbol -> compressed_size = entry.compressed_size;
+            file_symbol -> date_time = date_time;
+            file_symbol -> compression_method = entry.compression_method;
+            file_symbol -> offset = entry.offset;
         }
     }
 }
 
 
-Zip::Zip(Control &control_, char *zipfile_name) : control(control_),
-                                                  root_directory(NULL),
-                                                  zip_archive(NULL),
-                                                  zip_filename(NULL)
+//
+// The little-endian integers of the zip format.
+//
+static inline u2 GetU2(const u1 *p) { return p[0] | (p[1] << 8); }
+static inline u4 GetU4(const u1 *p)
 {
-    int err = 0;
-    zip_archive = zip_open(zipfile_name, ZIP_RDONLY, &err);
-
-    if (zip_archive)
-    {
-        // Store filename for later use by ZipFile
-        int len = strlen(zipfile_name);
-        zip_filename = new char[len + 1];
-        strcpy(zip_filename, zipfile_name);
-    }
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((u4) p[3] << 24);
+}
+static inline u8 GetU8(const u1 *p)
+{
+    return GetU4(p) | ((u8) GetU4(p + 4) << 32);
+}
 
+//
+// The signatures and fixed sizes of the zip records we read.
+//
+static const u4 LOCAL_HEADER_SIGNATURE = 0x04034b50;
+static const u4 CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+static const u4 END_SIGNATURE = 0x06054b50;
+static const u4 END64_SIGNATURE = 0x06064b50;
+static const u4 END64_LOCATOR_SIGNATURE = 0x07064b50;
+static const unsigned LOCAL_HEADER_SIZE = 30;
+static const unsigned CENTRAL_HEADER_SIZE = 46;
+static const unsigned END_SIZE = 22;
+static const unsigned END64_SIZE = 56;
+static const unsigned END64_LOCATOR_SIZE = 20;
+static const unsigned MAX_COMMENT_SIZE = 0xFFFF;
+
+
+Zip::Zip(Control &control_, char *zipfile_name, bool source_only_,
+         ZipArchive *archive_)
+    : control(control_),
+      root_directory(NULL),
+      archive(archive_ ? archive_ : new ZipArchive(zipfile_name)),
+      source_only(source_only_)
+{
+    errno = archive -> error;
     ReadDirectory();
 }
 
 
 Zip::~Zip()
 {
-    if (zip_archive)
-        zip_close(zip_archive);
-
-    delete [] zip_filename;
+    delete archive;
     delete root_directory;
 }
 
 
 //
-// Upon successful termination of this function, IsValid() should yield true.
+// Return the data of the entry of the file symbol, found through its local
+// header, or NULL if the header is not where the central directory said.
+//
+const u1 *Zip::EntryData(FileSymbol *file_symbol)
+{
+    u8 offset = file_symbol -> offset;
+    if (offset + LOCAL_HEADER_SIZE > archive -> size ||
+        GetU4(archive -> data + offset) != LOCAL_HEADER_SIGNATURE)
+    {
+        return NULL;
+    }
+    const u1 *header = archive -> data + offset;
+    u8 start = offset + LOCAL_HEADER_SIZE + GetU2(header + 26) +
+        GetU2(header + 28);
+    if (start + file_symbol -> compressed_size > archive -> size)
+        return NULL;
+    return archive -> data + start;
+}
+
+
+//
+// Enter the entries of the central directory into the symbol tables; they
+// are not needed after that.
 //
 void Zip::ReadDirectory()
 {
-    // Not a sourcepath (since we don't read java files from zip files)
-    root_directory = new DirectorySymbol(control.dot_name_symbol, NULL, false);
+    root_directory = new DirectorySymbol(control.dot_name_symbol, NULL,
+                                         source_only);
+
+    last_directory_name = NULL;
+    last_directory_name_length = 0;
+    last_directory = NULL;
+    for (unsigned i = 0; i < archive -> entries.Length(); i++)
+        ProcessDirectoryEntry(archive -> entries[i]);
+    archive -> entries.Reset();
+}
+
+
+//************************************************************************
+//
+// The ZipArchive methods follow:
+//
+//************************************************************************
+
+ZipArchive::ZipArchive(const char *zipfile_name)
+    : data(NULL),
+      size(0),
+      error(0),
+      entries(8, 4),
+      mapped(false)
+{
+    errno = 0;
+    int fd = open(zipfile_name, O_RDONLY);
+    struct stat status;
+    if (fd >= 0 && fstat(fd, &status) == 0 && S_ISREG(status.st_mode) &&
+        status.st_size > 0)
+    {
+        size = status.st_size;
+#ifdef HAVE_SYS_MMAN_H
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            data = (const u1 *) map;
+            mapped = true;
+        }
+#endif
+        if (! data)
+        {
+            u1 *copy = new u1[size];
+            size_t total = 0;
+            for (ssize_t count = 1; total < size && count > 0;
+                 total += count)
+            {
+                count = read(fd, copy + total, size - total);
+                if (count < 0)
+                    count = 0;
+            }
+            if (total == size)
+                data = copy;
+            else delete [] copy;
+        }
+    }
+    error = errno;
+    if (fd >= 0)
+        close(fd);
 
     if (IsValid())
+        ReadCentralDirectory();
+}
+
+
+ZipArchive::~ZipArchive()
+{
+    Close();
+}
+
+
+void ZipArchive::Close()
+{
+#ifdef HAVE_SYS_MMAN_H
+    if (mapped)
+        munmap((void *) data, size);
+    else
+#endif
+        delete [] data;
+    data = NULL;
+    mapped = false;
+}
+
+
+//
+// Upon successful termination of this function, IsValid() should yield true.
+//
+void ZipArchive::ReadCentralDirectory()
+{
+    //
+    // The end of central directory record is followed by a comment of up to
+    // 64K, so search back for its signature.
+    //
+    const u1 *end = NULL;
+    if (size >= END_SIZE)
+    {
+        size_t limit = size > END_SIZE + MAX_COMMENT_SIZE
+            ? size - END_SIZE - MAX_COMMENT_SIZE : 0;
+        for (size_t i = size - END_SIZE + 1; i-- > limit; )
+        {
+            if (GetU4(data + i) == END_SIGNATURE)
+            {
+                end = data + i;
+                break;
+            }
+        }
+    }
+    if (! end)
+    {
+        error = 0; // not an I/O problem, just not a zip file
+        Close();
+        return;
+    }
+
+    u8 num_entries = GetU2(end + 10);
+    u8 directory_size = GetU4(end + 12);
+    u8 directory_offset = GetU4(end + 16);
+
+    //
+    // A zip64 archive has its counts in a second end record, which a locator
+    // just before the first one points to.
+    //
+    size_t end_offset = end - data;
+    if (end_offset >= END64_LOCATOR_SIZE &&
+        GetU4(end - END64_LOCATOR_SIZE) == END64_LOCATOR_SIGNATURE)
+    {
+        u8 end64_offset = GetU8(end - END64_LOCATOR_SIZE + 8);
+        if (end64_offset + END64_SIZE <= size &&
+            GetU4(data + end64_offset) == END64_SIGNATURE)
+        {
+            const u1 *end64 = data + end64_offset;
+            num_entries = GetU8(end64 + 32);
+            directory_size = GetU8(end64 + 40);
+            directory_offset = GetU8(end64 + 48);
+        }
+    }
+    if (directory_offset + directory_size > size)
+    {
+        error = 0;
+        Close();
+        return;
+    }
+
+    const u1 *entry = data + directory_offset;
+    const u1 *directory_end = entry + directory_size;
+    for (u8 i = 0; i < num_entries; i++)
     {
-        zip_int64_t num_entries = zip_get_num_entries(zip_archive, 0);
+        if (entry + CENTRAL_HEADER_SIZE > directory_end ||
+            GetU4(entry) != CENTRAL_HEADER_SIGNATURE)
+        {
+            break;
+        }
 
-        for (zip_int64_t i = 0; i < num_entries; i++)
+        u2 compression_method = GetU2(entry + 10);
+        // The DOS date and time, which compare as a single number.
+        u4 date_time = (GetU2(entry + 14) << 16) | GetU2(entry + 12);
+        u4 compressed_size = GetU4(entry + 20);
+        u4 uncompressed_size = GetU4(entry + 24);
+        u2 name_length = GetU2(entry + 28);
+        u2 extra_length = GetU2(entry + 30);
+        u2 comment_length = GetU2(entry + 32);
+        u8 offset = GetU4(entry + 42);
+        const char *name = (const char *) entry + CENTRAL_HEADER_SIZE;
+        const u1 *extra = entry + CENTRAL_HEADER_SIZE + name_length;
+        entry = extra + extra_length + comment_length;
+        if (entry > directory_end)
+            break;
+
+        //
+        // The local header of an entry beyond 4G is in the zip64 extra
+        // field, after the sizes that overflowed (files that big are of no
+        // interest to us anyway). The walk stops at a field that does not
+        // fit in the extra area.
+        //
+        if (offset == 0xFFFFFFFF)
         {
-            ProcessDirectoryEntry(i);
+            const u1 *extra_end = extra + extra_length;
+            for (const u1 *field = extra;
+                 field + 4 <= extra_end &&
+                     field + 4 + GetU2(field + 2) <= extra_end;
+                 field += 4 + GetU2(field + 2))
+            {
+                if (GetU2(field) != 0x0001)
+                    continue;
+                unsigned skip = (uncompressed_size == 0xFFFFFFFF ? 8 : 0) +
+                    (compressed_size == 0xFFFFFFFF ? 8 : 0);
+                if (skip + 8 <= GetU2(field + 2))
+                    offset = GetU8(field + 4 + skip);
+                break;
+            }
         }
+        if (uncompressed_size == 0xFFFFFFFF || compressed_size == 0xFFFFFFFF)
+            continue;
+
+        Entry &directory_entry = entries.Next();
+        directory_entry.name = name;
+        directory_entry.name_length = name_length;
+        directory_entry.compression_method = compression_method;
+        directory_entry.date_time = date_time;
+        directory_entry.compressed_size = compressed_size;
+        directory_entry.uncompressed_size = uncompressed_size;
+        directory_entry.offset = offset;
+    }
+}
+
+
+//************************************************************************
+//
+// The ZipPrefetcher methods follow:
+//
+//************************************************************************
+
+ZipPrefetcher::ZipPrefetcher(Tuple<char *> &file_names, unsigned num_threads)
+    : next_slot(0)
+{
+    for (unsigned i = 0; i < file_names.Length(); i++)
+    {
+        Slot slot = { file_names[i], NULL, false, false };
+        slots.push_back(slot);
+    }
+    if (num_threads > slots.size())
+        num_threads = slots.size();
+    for (unsigned i = 0; i < num_threads; i++)
+        workers.push_back(std::thread(&ZipPrefetcher::Run, this));
+}
+
+
+ZipPrefetcher::~ZipPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        next_slot = slots.size(); // read no more
+    }
+    for (unsigned i = 0; i < workers.size(); i++)
+        workers[i].join();
+    for (unsigned i = 0; i < slots.size(); i++)
+    {
+        if (! slots[i].taken)
+            delete slots[i].archive;
+        delete [] slots[i].file_name;
+    }
+}
+
+
+void ZipPrefetcher::Run()
+{
+    for (;;)
+    {
+        unsigned i;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (next_slot == slots.size())
+                return;
+            i = next_slot++;
+        }
+
+        ZipArchive *archive = new ZipArchive(slots[i].file_name);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slots[i].archive = archive;
+            slots[i].done = true;
+        }
+        slot_done.notify_all();
+    }
+}
+
+
+ZipArchive *ZipPrefetcher::Take(const char *file_name)
+{
+    for (unsigned i = 0; i < slots.size(); i++)
+    {
+        Slot &slot = slots[i];
+        if (slot.taken || strcmp(slot.file_name, file_name) != 0)
+            continue;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        slot_done.wait(lock, [&slot] { return slot.done; });
+        slot.taken = true;
+        return slot.archive;
     }
+    return NULL;
 }
 
 
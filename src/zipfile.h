@@ -2,14 +2,11 @@
 
 #include "platform.h"
 #include "tuple.h"
-#if defined(__clang__)
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wnullability-extension"
-#endif
-#include <zip.h>
-#if defined(__clang__)
-#pragma clang diagnostic pop
-#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
 namespace Jopa { // Open namespace Jopa block
@@ -20,43 +17,159 @@ class FileSymbol;
 class NameSymbol;
 
 
+//
+// The contents of a zip entry, for as long as the ZipFile lives. A STORED
+// entry is not copied: Buffer() points into the mapped archive. A DEFLATED
+// one is inflated into a scratch buffer that is reused by the ZipFiles of
+// the thread, one after the other; only a ZipFile constructed while another
+// holds the scratch buffer gets one of its own.
+//
 class ZipFile
 {
 public:
     ZipFile(FileSymbol *);
     ~ZipFile();
 
-    inline char *Buffer() { return buffer; }
+    inline const char *Buffer() { return buffer; }
 
 private:
-    char *buffer;
+    const char *buffer;
+    char *own_buffer; // the buffer, if neither mapped nor scratch
+    bool scratch; // the buffer is the scratch buffer of the thread
+
+    char *InflateBuffer(u4);
 };
 
 
+//
+// The raw contents of a zip (or jar) file: the archive, mapped into memory
+// (or read, where it cannot be), and the entries of its central directory.
+// Reading them touches no symbol table, so it can be done on a worker
+// thread; see ZipPrefetcher. error is the errno of a failure to open the
+// file, or 0 if it was opened but is no zip file.
+//
+class ZipArchive
+{
+public:
+    struct Entry
+    {
+        const char *name; // in the central directory, not terminated
+        u2 name_length;
+        u2 compression_method;
+        u4 date_time; // DOS date and time, which compare as a single number
+        u4 compressed_size;
+        u4 uncompressed_size;
+        u8 offset; // of the local header
+    };
+
+    ZipArchive(const char *);
+    ~ZipArchive();
+
+    bool IsValid() { return data != NULL; }
+
+    const u1 *data;
+    size_t size;
+    int error;
+    Tuple<Entry> entries;
+
+private:
+    bool mapped; // data is a mapping of the file, not a heap copy
+
+    void ReadCentralDirectory();
+    void Close();
+};
+
+
+//
+// A zip (or jar) file on the classpath. Each .java and .class entry of its
+// central directory becomes a FileSymbol, when the Zip is constructed, that
+// records where the entry's local header is and how the entry is compressed,
+// so that a ZipFile can go straight to its data. The Zip of a -sourcepath
+// entry (or of a zip or jar given as input) is source_only: its .class
+// entries are left out, as those of a source directory are.
+//
 class Zip
 {
 public:
-    Zip(Control &, char *);
+    //
+    // The archive, if given, is one read ahead of time for the named file;
+    // the Zip takes it over.
+    //
+    Zip(Control &, char *, bool source_only = false,
+        ZipArchive *archive = NULL);
     ~Zip();
 
-    bool IsValid() { return zip_archive != NULL; }
+    bool IsValid() { return archive -> IsValid(); }
 
     DirectorySymbol *RootDirectory() { return root_directory; }
 
+    //
+    // The compression methods we can read.
+    //
+    enum
+    {
+        STORED = 0,
+        DEFLATED = 8
+    };
+
 private:
     friend class ZipFile;
 
     Control &control;
     DirectorySymbol *root_directory;
 
-    zip_t *zip_archive;
-    char *zip_filename;
+    ZipArchive *archive;
+    bool source_only;
 
     void ReadDirectory();
 
+    const char *last_directory_name; // of the last .java or .class entry
+    int last_directory_name_length;
+    DirectorySymbol *last_directory;
+
+    const u1 *EntryData(FileSymbol *);
+
     NameSymbol *ProcessFilename(const char *, int);
     DirectorySymbol *ProcessSubdirectoryEntries(DirectorySymbol *, const char *, int);
-    void ProcessDirectoryEntry(zip_int64_t index);
+    void ProcessDirectoryEntry(const ZipArchive::Entry &);
+};
+
+
+//
+// The archives on the paths, read on worker threads while the main thread
+// goes through the paths in order, making a Zip of each archive with the
+// ZipArchive that Take hands it. So the Zips, and the symbols they enter,
+// come out just as if the archives had been read one after the other.
+//
+class ZipPrefetcher
+{
+public:
+    ZipPrefetcher(Tuple<char *> &file_names, unsigned num_threads);
+    ~ZipPrefetcher();
+
+    //
+    // The archive read for the named file, once it has been; or NULL if the
+    // file is not one of those given to the constructor, or it was taken
+    // already.
+    //
+    ZipArchive *Take(const char *);
+
+private:
+    struct Slot
+    {
+        char *file_name;
+        ZipArchive *archive;
+        bool done;
+        bool taken;
+    };
+
+    std::vector<Slot> slots;
+    unsigned next_slot; // the next one for a worker to read
+    std::mutex mutex;
+    std::condition_variable slot_done;
+    std::vector<std::thread> workers;
+
+    void Run();
 };
 
 
@@ -0,0 +1,38 @@
+// Characters outside the Basic Multilingual Plane in a UTF-8 source, compiled
+// with -encoding UTF-8: each takes a surrogate pair, in a string literal as
+// in an identifier
+
+public class SupplementaryTest {
+    static int passed = 0;
+    static int failed = 0;
+
+    static int 𝑥 = 2; // MATHEMATICAL ITALIC SMALL X, a letter
+
+    static void test(String name, boolean condition) {
+        if (condition) {
+            passed++;
+            System.out.println("PASS: " + name);
+        } else {
+            failed++;
+            System.out.println("FAIL: " + name);
+        }
+    }
+
+    public static void main(String[] args) {
+        System.out.println("=== Supplementary Characters Test ===");
+
+        String face = "😀"; // GRINNING FACE
+        test("1.1 String length", face.length() == 2);
+        test("1.2 High surrogate", face.charAt(0) == '\uD83D');
+        test("1.3 Low surrogate", face.charAt(1) == '\uDE00');
+        test("1.4 Identifier", 𝑥 == 2);
+
+        System.out.println("\n=== RESULTS ===");
+        System.out.println("Passed: " + passed);
+        System.out.println("Failed: " + failed);
+
+        if (failed > 0) {
+            System.exit(1);
+        }
+    }
+}
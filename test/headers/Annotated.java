@@ -0,0 +1,11 @@
+// A class literal in an annotation on a secondary top-level type
+
+public class Annotated { }
+
+@interface Uses {
+    Class<?> value();
+}
+
+class Helper { }
+
+@Uses(Helper.class) class Helped extends Helper { }
@@ -0,0 +1,12 @@
+// Braces and quotes in character literals, before a secondary interface
+
+public class Chars {
+    static final char BRACE = '{';
+    static final char QUOTE = '\'';
+    static final char BACKSLASH = '\\';
+}
+
+interface SecondaryApi {
+    char BRACE_CODE = '\175';
+    int VALUE = '}' == BRACE_CODE ? 2 : 0;
+}
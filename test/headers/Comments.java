@@ -0,0 +1,19 @@
+// Braces and type keywords in comments, and nested braces, before a
+// secondary enum
+
+public class Comments {
+    static int depth(int n) {
+        if (n > 0) {
+            for (int i = 0; i < n; i++) {
+                { n--; }
+            }
+        }
+        return n; // { class NotAType
+    }
+
+    /* { interface NotAType */
+    static class Nested { interface Inner { } }
+}
+
+/** class NotAType { */
+enum SecondaryKind { ONE, TWO { } }
@@ -0,0 +1,37 @@
+// Top-level types registered from a scan that is then discarded, with
+// --lazy-scan: secondary types after nested braces, literals and comments
+// that hold braces, quotes and type keywords
+
+public class HeadersTest {
+    static int passed = 0;
+    static int failed = 0;
+
+    static void test(String name, boolean condition) {
+        if (condition) {
+            passed++;
+            System.out.println("PASS: " + name);
+        } else {
+            failed++;
+            System.out.println("FAIL: " + name);
+        }
+    }
+
+    public static void main(String[] args) {
+        System.out.println("=== Headers Test ===");
+
+        test("1.1 Literals", Strings.TEXT.length() == 15 && Chars.BRACE == '{');
+        test("1.2 Secondary class", new Secondary().value() == 1);
+        test("1.3 Secondary interface", SecondaryApi.VALUE == 2);
+        test("1.4 Secondary enum", SecondaryKind.values().length == 2);
+        test("1.5 Class literal in annotation", new Helped() != null);
+        test("1.6 Annotation type", Helped.class.getSuperclass() == Helper.class);
+
+        System.out.println("\n=== RESULTS ===");
+        System.out.println("Passed: " + passed);
+        System.out.println("Failed: " + failed);
+
+        if (failed > 0) {
+            System.exit(1);
+        }
+    }
+}
@@ -0,0 +1,9 @@
+// Braces and escaped quotes in string literals, before a secondary class
+
+public class Strings {
+    static final String TEXT = "{ \"{ class Fake";
+}
+
+class Secondary {
+    int value() { return "{".length(); }
+}
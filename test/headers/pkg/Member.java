@@ -0,0 +1,5 @@
+package pkg;
+
+@Tags("member") public class Member { }
+
+@Tags({"other"}) class Other extends Member { }
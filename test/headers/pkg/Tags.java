@@ -0,0 +1,5 @@
+package pkg;
+
+public @interface Tags {
+    String[] value();
+}
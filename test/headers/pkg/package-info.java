@@ -0,0 +1,3 @@
+/** The package of { Member } */
+@Tags({"headers", "lazy"})
+package pkg;